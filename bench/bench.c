@@ -0,0 +1,912 @@
+/*
+	prnf benchmarks
+
+	Type 'make' then './bench' to run.
+	Each benchmark prints the same messages through different output paths and reports the message rate.
+*/
+
+	#include <stdint.h>
+	#include <stdbool.h>
+	#include <stddef.h>
+	#include <stdio.h>
+	#include <stdlib.h>
+	#include <string.h>
+	#include <time.h>
+	#include <unistd.h>
+	#include <sys/stat.h>
+	#include <pthread.h>
+	#include <sys/socket.h>
+	#include <sys/un.h>
+	#include <inttypes.h>
+
+	#include "prnf.h"
+	#include "prnf_posix.h"
+	#include "prnf_sink.h"
+	#include "prnf_log.h"
+	#include "prext.h"
+
+//********************************************************************************************************
+// Configurable defines
+//********************************************************************************************************
+
+//	Number of messages printed by each benchmark
+	#define MESSAGES	1000000
+
+//********************************************************************************************************
+// Local defines
+//********************************************************************************************************
+
+//	A typical log line
+	#define BENCH_FMT	"%s:%.4i(%s) value=%u level=%f\n"
+	#define BENCH_ARGS(_i)	"bench.c", 100+(int)((_i)%900), "bench_fn", (unsigned)(_i), (_i)*0.001
+
+//	A hand written per character wrapper, passing characters on to the next
+	struct wrap_struct
+	{
+		void(*next)(void*, char);
+		void* next_vars;
+		uint16_t crc;
+	};
+
+//********************************************************************************************************
+// Private variables
+//********************************************************************************************************
+
+//	Output of bench_filter(), overwritten when full
+	static char mem_out[64*1024];
+	static size_t mem_pos;
+
+//********************************************************************************************************
+// Private prototypes
+//********************************************************************************************************
+
+	static void bench_fd_write(void);
+	static void bench_uring(void);
+	static void bench_mmap(void);
+	static void bench_flight(void);
+	static void bench_lz(void);
+	static void bench_filter(void);
+	static void bench_tee(void);
+	static void bench_log(void);
+	static void bench_log_prefix(void);
+	static void bench_ext(void);
+	static void bench_now(void);
+	static void bench_json(void);
+	static void bench_esc(void);
+	static void bench_hex(void);
+	static void bench_base64(void);
+	static void bench_array(void);
+	static void bench_table(void);
+	static void bench_dgram_send(void);
+	static void bench_dgram(void);
+
+	static void write_blk(void* fd, const char* blk, size_t len);
+	static void discard_blk(void* vars, const char* blk, size_t len);
+	static void mem_blk(void* vars, const char* blk, size_t len);
+	static int* period_heap(uint32_t seconds);
+	static void mem_putch(void* vars, char c);
+	static void wrap_crc16_putch(void* wrap, char c);
+	static void wrap_crlf_putch(void* wrap, char c);
+	static void send_blk(void* fd, const char* blk, size_t len);
+	static int dgram_daemon_start(pthread_t* thread, char* path);
+	static long dgram_daemon_stop(pthread_t thread, const char* path);
+	static void* dgram_daemon(void* fd);
+	static int temp_file(void);
+	static double now(void);
+	static void report(const char* name, double start, size_t bytes);
+
+//********************************************************************************************************
+// Public functions
+//********************************************************************************************************
+
+int main(int argc, const char* argv[])
+{
+	(void)argc;
+	(void)argv;
+
+	printf("%u messages per benchmark\n\n", MESSAGES);
+
+	bench_fd_write();
+	bench_uring();
+	bench_mmap();
+	bench_flight();
+	bench_lz();
+	bench_filter();
+	bench_tee();
+	bench_log();
+	bench_log_prefix();
+	bench_ext();
+	bench_now();
+	bench_json();
+	bench_esc();
+	bench_hex();
+	bench_base64();
+	bench_array();
+	bench_table();
+	bench_dgram_send();
+	bench_dgram();
+
+	return 0;
+}
+
+//********************************************************************************************************
+// Private functions
+//********************************************************************************************************
+
+// One write() per message
+static void bench_fd_write(void)
+{
+	int fd = temp_file();
+	size_t bytes = 0;
+	double start = now();
+	int i;
+
+	for(i=0; i<MESSAGES; i++)
+		bytes += blkprnf(write_blk, &fd, BENCH_FMT, BENCH_ARGS(i));
+
+	report("blkprnf -> write() per message", start, bytes);
+	close(fd);
+}
+
+// Batched asynchronous writes through io_uring
+static void bench_uring(void)
+{
+	struct prnf_uring_struct uring;
+	int fd = temp_file();
+	size_t bytes = 0;
+	double start = now();
+	bool is_async;
+	int i;
+
+	prnf_uring_open(&uring, fd, 8, 64*1024);
+	is_async = prnf_uring_is_async(&uring);
+	for(i=0; i<MESSAGES; i++)
+		bytes += blkprnf(prnf_uring_blk, &uring, BENCH_FMT, BENCH_ARGS(i));
+	prnf_uring_close(&uring);
+
+	report(is_async? "blkprnf -> io_uring 8x64k" : "blkprnf -> io_uring 8x64k (unavailable, blocking fallback)", start, bytes);
+	close(fd);
+}
+
+// Appending to memory mapped segments
+static void bench_mmap(void)
+{
+	struct prnf_mmap_struct mm;
+	struct prnf_mmap_stats_struct stats;
+	char base[64];
+	char name[80];
+	size_t bytes = 0;
+	double start;
+	unsigned i;
+
+	snprintf(base, sizeof(base), "/tmp/prnf_bench_%i", (int)getpid());
+	if(prnf_mmap_open(&mm, base, 16*1024*1024))
+	{
+		perror("prnf_mmap_open");
+		exit(1);
+	};
+
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+		bytes += blkprnf(prnf_mmap_blk, &mm, BENCH_FMT, BENCH_ARGS(i));
+	stats = prnf_mmap_stats(&mm);
+	prnf_mmap_close(&mm);
+
+	report("blkprnf -> prnf_mmap 16M segments", start, bytes);
+	for(i=0; i<stats.segments; i++)
+	{
+		snprintf(name, sizeof(name), "%s.%06u", base, i);
+		unlink(name);
+	};
+}
+
+// Flight recorder in RAM, formatting directly into the ring
+static void bench_flight(void)
+{
+	static char region[1024*1024];
+	struct prnf_flight_struct flight;
+	size_t bytes = 0;
+	double start;
+	int i;
+
+	prnf_flight_init(&flight, region, sizeof(region), false);
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+		bytes += fptrprnf(prnf_flight_putch, &flight, BENCH_FMT, BENCH_ARGS(i));
+	report("fptrprnf -> prnf_flight_putch 1M ring", start, bytes);
+
+	start = now();
+	bytes = 0;
+	for(i=0; i<MESSAGES; i++)
+		bytes += blkprnf(prnf_flight_blk, &flight, BENCH_FMT, BENCH_ARGS(i));
+	report("blkprnf -> prnf_flight_blk 1M ring", start, bytes);
+}
+
+// Bytes written and CPU time per message, raw and compressed, then the decompression rate
+static void bench_lz(void)
+{
+	static uint32_t lz_work[PRNF_LZ_WORK_SIZE(16384)/4];
+	static uint32_t unlz_work[PRNF_UNLZ_WORK_SIZE(16384)/4];
+	static char buf[64*1024];
+	struct prnf_lz_struct lz;
+	struct prnf_unlz_struct unlz;
+	struct stat st;
+	int fd = temp_file();
+	size_t bytes = 0;
+	double start;
+	clock_t cpu;
+	ssize_t len;
+	int i;
+
+	cpu = clock();
+	for(i=0; i<MESSAGES; i++)
+		bytes += blkprnf(write_blk, &fd, BENCH_FMT, BENCH_ARGS(i));
+	fstat(fd, &st);
+	printf("%-60s %10lu bytes written %8.3fus CPU/msg\n", "blkprnf -> write() per message", (unsigned long)st.st_size, (clock()-cpu)*1E6/CLOCKS_PER_SEC/MESSAGES);
+	close(fd);
+
+	fd = temp_file();
+	prnf_lz_init(&lz, lz_work, sizeof(lz_work), write_blk, &fd);
+	cpu = clock();
+	for(i=0; i<MESSAGES; i++)
+		bytes += blkprnf(prnf_lz_blk, &lz, BENCH_FMT, BENCH_ARGS(i));
+	prnf_lz_flush(&lz);
+	fstat(fd, &st);
+	printf("%-60s %10lu bytes written %8.3fus CPU/msg\n", "blkprnf -> prnf_lz 16k blocks -> write()", (unsigned long)st.st_size, (clock()-cpu)*1E6/CLOCKS_PER_SEC/MESSAGES);
+
+	lseek(fd, 0, SEEK_SET);
+	prnf_unlz_init(&unlz, unlz_work, sizeof(unlz_work), discard_blk, NULL);
+	start = now();
+	while((len = read(fd, buf, sizeof(buf))) > 0)
+		prnf_unlz_blk(&unlz, buf, len);
+	report(prnf_unlz_error(&unlz)? "prnf_unlz (corrupt!)" : "prnf_unlz", start, lz.bytes_in);
+	close(fd);
+}
+
+// CRC-16 per line then CRLF, as nested per character wrappers and as a filter chain
+static void bench_filter(void)
+{
+	struct wrap_struct crlf = {.next = mem_putch};
+	struct wrap_struct crc16 = {.next = wrap_crlf_putch, .next_vars = &crlf, .crc = 0xFFFF};
+	struct prnf_filter_struct check, line_end;
+	size_t bytes = 0;
+	double start;
+	int i;
+
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+		bytes += fptrprnf(wrap_crc16_putch, &crc16, BENCH_FMT, BENCH_ARGS(i));
+	report("fptrprnf -> crc16 -> crlf per character wrappers", start, bytes);
+
+	prnf_filter_check(&check, PRNF_CHECK_CRC16);
+	prnf_filter_crlf(&line_end);
+	prnf_filter_chain(mem_blk, NULL, &check, &line_end, NULL);
+	bytes = 0;
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+		bytes += blkprnf(prnf_filter_blk, &check, BENCH_FMT, BENCH_ARGS(i));
+	report("blkprnf -> prnf_filter crc16 -> crlf", start, bytes);
+}
+
+// The same line to a console, memory and a flight recorder, printed three times or once through a tee
+static void bench_tee(void)
+{
+	static char region[64*1024];
+	struct prnf_flight_struct flight;
+	struct prnf_tee_sink_struct sinks[3];
+	struct prnf_tee_struct tee;
+	size_t bytes = 0;
+	double start;
+	int i;
+
+	prnf_flight_init(&flight, region, sizeof(region), false);
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+	{
+		bytes += fptrprnf(mem_putch, NULL, BENCH_FMT, BENCH_ARGS(i));
+		bytes += blkprnf(mem_blk, NULL, BENCH_FMT, BENCH_ARGS(i));
+		bytes += fptrprnf(prnf_flight_putch, &flight, BENCH_FMT, BENCH_ARGS(i));
+	};
+	report("3 sinks, printed to each", start, bytes);
+
+	prnf_tee_init(&tee, sinks, 3);
+	prnf_tee_add_char(&tee, mem_putch, NULL, PRNF_TEE_ALL);
+	prnf_tee_add(&tee, mem_blk, NULL, PRNF_TEE_ALL);
+	prnf_tee_add(&tee, prnf_flight_blk, &flight, PRNF_TEE_ALL);
+	bytes = 0;
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+		bytes += 3*prnf_tee(&tee, 1, BENCH_FMT, BENCH_ARGS(i));
+	report("3 sinks, prnf_tee", start, bytes);
+}
+
+// Registered log sites, disabled then enabled, and with limits
+static void bench_log(void)
+{
+	double start;
+	int i;
+
+	prnf_log_sink(mem_blk, NULL);
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+		prnf_DEBUG(BENCH_FMT, BENCH_ARGS(i));
+	report("prnf_DEBUG disabled", start, 0);
+
+	prnf_log_enable_level(PRNF_LOG_TRACE);
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+		prnf_DEBUG(BENCH_FMT, BENCH_ARGS(i));
+	report("prnf_DEBUG enabled -> memory", start, 0);
+	prnf_log_enable_level(PRNF_LOG_DEFAULT_LEVEL);
+
+	// an error storm, the same message repeated
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+		prnf_ERROR(BENCH_FMT, BENCH_ARGS(0));
+	report("prnf_ERROR repeated message", start, 0);
+
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+		prnf_LOG_DEDUP(PRNF_LOG_ERROR, 1000, BENCH_FMT, BENCH_ARGS(0));
+	report("prnf_LOG_DEDUP repeated message", start, 0);
+
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+		prnf_LOG_RATE(PRNF_LOG_ERROR, 100, 100, BENCH_FMT, BENCH_ARGS(i));
+	report("prnf_LOG_RATE 100/s", start, 0);
+}
+
+// Timestamp and site rendered for every line, or taken from the prefix caches
+static void bench_log_prefix(void)
+{
+	char tstamp[32];
+	struct tm tm;
+	time_t t;
+	double start;
+	int i;
+
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+	{
+		t = time(NULL);
+		strftime(tstamp, sizeof(tstamp), "%Y-%m-%dT%H:%M:%S%z ", localtime_r(&t, &tm));
+		blkprnf(mem_blk, NULL, "%s%s:%.4i(%s)\v55 : value=%u level=%f\n", tstamp, __FILE__, __LINE__, __func__, (unsigned)i, i*0.001);
+	};
+	report("strftime + site formatted per line", start, 0);
+
+	prnf_log_sink(mem_blk, NULL);
+	prnf_log_prefix("%Y-%m-%dT%H:%M:%S%z ", "%s:%.4i(%s)\v55 : ");
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+		prnf_INFO("value=%u level=%f\n", (unsigned)i, i*0.001);
+	report("prnf_INFO with cached prefix", start, 0);
+	prnf_log_prefix(NULL, NULL);
+}
+
+// %n extensions (malloc, copy, free) against %p callback extensions writing to the output
+static void bench_ext(void)
+{
+	double start;
+	int i;
+
+	// (timestamps are not compared here, their cost is dominated by localtime())
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+		blkprnf(mem_blk, NULL, "up %n\n", period_heap(i));
+	report("%n period string from malloc()", start, 0);
+
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+		blkprnf(mem_blk, NULL, "up %n\n", prext_period(i));
+	report("%n prext_period from the arena", start, 0);
+
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+		blkprnf(mem_blk, NULL, "up %p\n", PREXT_PERIOD(i));
+	report("%p PREXT_PERIOD", start, 0);
+
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+		blkprnf(mem_blk, NULL, "%n\n", prext_cplex_rec(i + 2.5f*I));
+	report("%n prext_cplex_rec", start, 0);
+
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+		blkprnf(mem_blk, NULL, "%p\n", PREXT_CPLEX_REC(i + 2.5f*I));
+	report("%p PREXT_CPLEX_REC", start, 0);
+}
+
+// Timestamps with fractional seconds, from localtime() and strftime() each time or from the cached prext_now()
+static void bench_now(void)
+{
+	char tstamp[PREXT_NOW_SIZE];
+	struct timespec ts;
+	struct tm tm;
+	double start;
+	int i;
+
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+	{
+		clock_gettime(CLOCK_REALTIME, &ts);
+		strftime(tstamp, sizeof(tstamp), "%Y-%m-%dT%H:%M:%S", localtime_r(&ts.tv_sec, &tm));
+		snprnf(&tstamp[19], sizeof(tstamp)-19, ".%03li", ts.tv_nsec/1000000);
+		strftime(&tstamp[23], sizeof(tstamp)-23, "%z", &tm);
+	};
+	report("timestamp from localtime_r + strftime", start, 0);
+
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+		prext_now(tstamp, 3);
+	report("timestamp from prext_now", start, 0);
+
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+		blkprnf(mem_blk, NULL, "%n value=%u\n", prext_tstamp(PREXT_ISO8601, time(NULL)), (unsigned)i);
+	report("%n prext_tstamp per line", start, 0);
+
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+		blkprnf(mem_blk, NULL, "%p value=%u\n", PREXT_NOW(3), (unsigned)i);
+	report("%p PREXT_NOW per line", start, 0);
+}
+
+// JSON lines, escaping a string into a temporary buffer for snprnf() or escaping while printing with blkprnf_json()
+static void bench_json(void)
+{
+	static const char* names[] = {"pump A", "valve \"B\"", "C:\\tank\\level", "line\nbreak"};
+	const char* name;
+	char escaped[64];
+	double start;
+	size_t j;
+	int i;
+
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+	{
+		name = names[i&3];
+		for(j=0; *name && j<sizeof(escaped)-2; name++)
+		{
+			if(*name == '"' || *name == '\\')
+				escaped[j++] = '\\';
+			else if(*name == '\n')
+			{
+				escaped[j++] = '\\';
+				escaped[j++] = 'n';
+				continue;
+			};
+			escaped[j++] = *name;
+		};
+		escaped[j] = 0;
+		blkprnf(mem_blk, NULL, "{\"t\":%u,\"v\":%.2f,\"name\":\"%s\"}\n", (unsigned)i, i*0.001, escaped);
+	};
+	report("blkprnf with the string escaped to a buffer first", start, 0);
+
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+		blkprnf_json(mem_blk, NULL, "{\"t\":%u,\"v\":%.2f,\"name\":%s}\n", (unsigned)i, i*0.001, names[i&3]);
+	report("blkprnf_json", start, 0);
+}
+
+// A 100 character message with one character to escape, escaped to a temporary buffer for %s, or by %s{json} and %s{c}
+static void bench_esc(void)
+{
+	static const char msg[] = "Connection from 192.168.1.20 refused by the remote host after 3 attempts, \"retry\" in 30 seconds.";
+	const char* src;
+	char escaped[2*sizeof(msg)];
+	char* dst;
+	double start;
+	int i;
+
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+	{
+		for(src=msg, dst=escaped; *src; src++)
+		{
+			if(*src == '"' || *src == '\\')
+				*dst++ = '\\';
+			*dst++ = *src;
+		};
+		*dst = 0;
+		blkprnf(mem_blk, NULL, "msg=\"%s\"\n", escaped);
+	};
+	report("%s escaped to a buffer first", start, 0);
+
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+		blkprnf(mem_blk, NULL, "msg=\"%s{json}\"\n", msg);
+	report("%s{json}", start, 0);
+
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+		blkprnf(mem_blk, NULL, "msg=%s{c}\n", msg);
+	report("%s{c}", start, 0);
+
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+		blkprnf(mem_blk, NULL, "msg=%s\n", msg);
+	report("%s unescaped", start, 0);
+}
+
+// A 64 byte payload in hex, with %02X per byte or PRNF_HEX(), and in the xxd layout
+static void bench_hex(void)
+{
+	uint8_t payload[64];
+	char txt[sizeof(payload)*2+2];
+	double start;
+	size_t j;
+	int i;
+
+	for(j=0; j<sizeof(payload); j++)
+		payload[j] = j*37;
+
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+	{
+		txt[0] = 0;
+		for(j=0; j<sizeof(payload); j++)
+			snappf(txt, sizeof(txt), "%02X", payload[j]);
+		blkprnf(mem_blk, NULL, "%s\n", txt);
+	};
+	report("snappf %02X per byte", start, 0);
+
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+		blkprnf(mem_blk, NULL, "%p\n", PRNF_HEX(payload, sizeof(payload)));
+	report("%p PRNF_HEX", start, 0);
+
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+		blkprnf(mem_blk, NULL, "%p", PRNF_XXD(payload, sizeof(payload)));
+	report("%p PRNF_XXD (4 lines)", start, 0);
+}
+
+// A 256 byte blob in base64, encoded to a temporary buffer for %s or streamed by PRNF_BASE64()
+static void bench_base64(void)
+{
+	static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	uint8_t blob[256];
+	char* txt = malloc((sizeof(blob)+2)/3*4+1);
+	char* ptr;
+	uint32_t group;
+	double start;
+	size_t j;
+	int i;
+
+	for(j=0; j<sizeof(blob); j++)
+		blob[j] = j*37;
+
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+	{
+		ptr = txt;
+		for(j=0; j+3<=sizeof(blob); j+=3)
+		{
+			group = (uint32_t)blob[j] << 16 | (uint32_t)blob[j+1] << 8 | blob[j+2];
+			*ptr++ = digits[group >> 18];
+			*ptr++ = digits[(group >> 12) & 0x3F];
+			*ptr++ = digits[(group >> 6) & 0x3F];
+			*ptr++ = digits[group & 0x3F];
+		};
+		group = (uint32_t)blob[j] << 16;
+		*ptr++ = digits[group >> 18];
+		*ptr++ = digits[(group >> 12) & 0x3F];
+		*ptr++ = '=';
+		*ptr++ = '=';
+		*ptr = 0;
+		blkprnf(mem_blk, NULL, "blob=%s\n", txt);
+	};
+	report("base64 to a buffer, then %s", start, 0);
+	free(txt);
+
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+		blkprnf(mem_blk, NULL, "blob=%p\n", PRNF_BASE64(blob, sizeof(blob)));
+	report("%p PRNF_BASE64", start, 0);
+
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+		blkprnf(mem_blk, NULL, "blob=%p\n", PRNF_BASE32(blob, sizeof(blob)));
+	report("%p PRNF_BASE32", start, 0);
+}
+
+// 32 int16 samples and 16 floats, with snappf() per element or one PRNF_ARRAY_x
+static void bench_array(void)
+{
+	int16_t samples[32];
+	float temps[16];
+	char txt[400];
+	double start;
+	size_t j;
+	int i;
+
+	for(j=0; j<32; j++)
+		samples[j] = j*1237 - 20000;
+	for(j=0; j<16; j++)
+		temps[j] = j*1.37f - 10.0f;
+
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+	{
+		txt[0] = 0;
+		for(j=0; j<32; j++)
+			snappf(txt, sizeof(txt), j? ",%6i":"%6i", samples[j]);
+		blkprnf(mem_blk, NULL, "%s\n", txt);
+	};
+	report("32 x int16 snappf per element", start, 0);
+
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+		blkprnf(mem_blk, NULL, "%p\n", PRNF_ARRAY_INT16(samples, 32, "%6i", ","));
+	report("32 x int16 PRNF_ARRAY_INT16", start, 0);
+
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+	{
+		txt[0] = 0;
+		for(j=0; j<16; j++)
+			snappf(txt, sizeof(txt), j? " %.2f":"%.2f", temps[j]);
+		blkprnf(mem_blk, NULL, "%s\n", txt);
+	};
+	report("16 x float snappf per element", start, 0);
+
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+		blkprnf(mem_blk, NULL, "%p\n", PRNF_ARRAY_FLOAT(temps, 16, "%.2f", " "));
+	report("16 x float PRNF_ARRAY_FLOAT", start, 0);
+}
+
+// MESSAGES rows of a struct as CSV, a blkprnf() per row vs blkprnf_table() in batches of TABLE_ROWS
+static void bench_table(void)
+{
+	#define TABLE_ROWS	1000
+	struct row_struct {uint32_t id; int16_t level; int32_t count; float volts; const char* site;};
+	static struct row_struct rows[TABLE_ROWS];
+	static const struct prnf_field_struct fields[] =
+	{
+		PRNF_FIELD(struct row_struct, id, PRNF_FIELD_U32, NULL),
+		PRNF_FIELD(struct row_struct, level, PRNF_FIELD_I16, NULL),
+		PRNF_FIELD(struct row_struct, count, PRNF_FIELD_I32, NULL),
+		PRNF_FIELD(struct row_struct, volts, PRNF_FIELD_FLOAT, "%.3f"),
+		PRNF_FIELD(struct row_struct, site, PRNF_FIELD_STR, NULL),
+	};
+	static const struct prnf_table_struct table = {fields, 5, PRNF_TABLE_CSV, 0};
+	static const char* sites[4] = {"north", "south", "east", "west"};
+	size_t bytes = 0;
+	double start;
+	int i, j;
+
+	for(j=0; j<TABLE_ROWS; j++)
+		rows[j] = (struct row_struct){j*7919, j-500, j*104729, j*0.37f, sites[j&3]};
+
+	start = now();
+	for(i=0; i<MESSAGES/TABLE_ROWS; i++)
+	{
+		for(j=0; j<TABLE_ROWS; j++)
+			bytes += blkprnf(mem_blk, NULL, "%u,%i,%li,%.3f,%s{csv}\n", rows[j].id, rows[j].level, (long)rows[j].count, rows[j].volts, rows[j].site);
+	};
+	report("CSV row blkprnf per row", start, bytes);
+
+	bytes = 0;
+	start = now();
+	for(i=0; i<MESSAGES/TABLE_ROWS; i++)
+		bytes += blkprnf_table(mem_blk, NULL, &table, rows, sizeof(rows[0]), TABLE_ROWS);
+	report("CSV row blkprnf_table", start, bytes);
+}
+
+// One send() per message to a unix datagram socket
+static void bench_dgram_send(void)
+{
+	struct sockaddr_un addr = {.sun_family = AF_UNIX};
+	pthread_t daemon;
+	size_t bytes = 0;
+	double start;
+	int fd;
+	int i;
+
+	if(dgram_daemon_start(&daemon, addr.sun_path))
+		return;
+	fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+	if(fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)))
+	{
+		perror("connect");
+		exit(1);
+	};
+
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+		bytes += blkprnf(send_blk, &fd, BENCH_FMT, BENCH_ARGS(i));
+	dgram_daemon_stop(daemon, addr.sun_path);
+
+	report("blkprnf -> send() per message", start, bytes);
+	close(fd);
+	unlink(addr.sun_path);
+}
+
+// Batches of 32 messages per sendmmsg()
+static void bench_dgram(void)
+{
+	struct prnf_dgram_struct dgram;
+	char path[sizeof(((struct sockaddr_un*)0)->sun_path)];
+	pthread_t daemon;
+	size_t bytes = 0;
+	double start;
+	long received;
+	int i;
+
+	if(dgram_daemon_start(&daemon, path))
+		return;
+	if(prnf_dgram_open(&dgram, path, 32, 256, 10))
+	{
+		perror("prnf_dgram_open");
+		exit(1);
+	};
+
+	start = now();
+	for(i=0; i<MESSAGES; i++)
+		bytes += blkprnf(prnf_dgram_blk, &dgram, BENCH_FMT, BENCH_ARGS(i));
+	prnf_dgram_close(&dgram);
+	received = dgram_daemon_stop(daemon, path);
+
+	report("blkprnf -> prnf_dgram 32 per sendmmsg()", start, bytes);
+	if((uint64_t)received != dgram.stats.messages || dgram.stats.dropped)
+		printf("%-60s %" PRIu64 " sent, %li received, %" PRIu64 " dropped\n", "", dgram.stats.messages, received, dgram.stats.dropped);
+	unlink(path);
+}
+
+static void write_blk(void* fd, const char* blk, size_t len)
+{
+	if(write(*(int*)fd, blk, len) != (ssize_t)len)
+		fprintf(stderr, "write failed\n");
+}
+
+static void discard_blk(void* vars, const char* blk, size_t len)
+{
+	(void)vars;
+	(void)blk;
+	(void)len;
+}
+
+// prext_period() without the arena
+static int* period_heap(uint32_t seconds)
+{
+	char* txt = malloc(24);
+	snprnf(txt, 24, "%p", PREXT_PERIOD(seconds));
+	return (int*)txt;
+}
+
+static void mem_blk(void* vars, const char* blk, size_t len)
+{
+	(void)vars;
+	if(mem_pos + len > sizeof(mem_out))
+		mem_pos = 0;
+	memcpy(&mem_out[mem_pos], blk, len);
+	mem_pos += len;
+}
+
+static void mem_putch(void* vars, char c)
+{
+	(void)vars;
+	if(mem_pos == sizeof(mem_out))
+		mem_pos = 0;
+	mem_out[mem_pos++] = c;
+}
+
+// Same nibble table CRC as prnf_filter_check()
+static void wrap_crc16_putch(void* wrap_vp, char c)
+{
+	static const uint16_t table[16] = {0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7, 0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF};
+	struct wrap_struct* wrap = wrap_vp;
+	int i;
+
+	if(c == '\n')
+	{
+		wrap->next(wrap->next_vars, '*');
+		for(i=12; i>=0; i-=4)
+			wrap->next(wrap->next_vars, "0123456789ABCDEF"[(wrap->crc >> i) & 15]);
+		wrap->crc = 0xFFFF;
+	}
+	else
+	{
+		wrap->crc = (wrap->crc << 4) ^ table[((wrap->crc >> 12) ^ ((uint8_t)c >> 4)) & 15];
+		wrap->crc = (wrap->crc << 4) ^ table[((wrap->crc >> 12) ^ (uint8_t)c) & 15];
+	};
+	wrap->next(wrap->next_vars, c);
+}
+
+static void wrap_crlf_putch(void* wrap_vp, char c)
+{
+	struct wrap_struct* wrap = wrap_vp;
+
+	if(c == '\n')
+		wrap->next(wrap->next_vars, '\r');
+	wrap->next(wrap->next_vars, c);
+}
+
+// Send a line as a datagram, without the '\n'
+static void send_blk(void* fd, const char* blk, size_t len)
+{
+	if(len && blk[len-1] == '\n')
+		len--;
+	if(send(*(int*)fd, blk, len, 0) != (ssize_t)len)
+		fprintf(stderr, "send failed\n");
+}
+
+// Start a thread receiving datagrams on a new socket until an empty one, the path of which is written to path
+static int dgram_daemon_start(pthread_t* thread, char* path)
+{
+	struct sockaddr_un addr = {.sun_family = AF_UNIX};
+	static int fd;
+
+	snprintf(addr.sun_path, sizeof(addr.sun_path), "/tmp/prnf_bench_%i.sock", (int)getpid());
+	unlink(addr.sun_path);
+	fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+	if(fd < 0 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) || pthread_create(thread, NULL, dgram_daemon, &fd))
+	{
+		perror("unix datagram socket");
+		return -1;
+	};
+	strcpy(path, addr.sun_path);
+	return 0;
+}
+
+// Send the empty datagram ending the daemon, returns the number of datagrams it received before it
+static long dgram_daemon_stop(pthread_t thread, const char* path)
+{
+	struct sockaddr_un addr = {.sun_family = AF_UNIX};
+	void* count;
+	int fd;
+
+	strcpy(addr.sun_path, path);
+	fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+	if(fd < 0 || sendto(fd, "", 0, 0, (struct sockaddr*)&addr, sizeof(addr)))
+	{
+		perror("dgram daemon stop");
+		exit(1);
+	};
+	close(fd);
+	pthread_join(thread, &count);
+	return (long)(intptr_t)count;
+}
+
+static void* dgram_daemon(void* fd)
+{
+	char msg[256];
+	long count = 0;
+
+	while(recv(*(int*)fd, msg, sizeof(msg), 0) > 0)
+		count++;
+	close(*(int*)fd);
+	return (void*)(intptr_t)count;
+}
+
+// An unlinked temporary file
+static int temp_file(void)
+{
+	char path[] = "/tmp/prnf_bench_XXXXXX";
+	int fd = mkstemp(path);
+
+	if(fd < 0)
+	{
+		perror("mkstemp");
+		exit(1);
+	};
+	unlink(path);
+	return fd;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1E-9;
+}
+
+static void report(const char* name, double start, size_t bytes)
+{
+	double elapsed = now() - start;
+	if(bytes)
+		printf("%-60s %8.3fs %10.0f msg/s %8.1f MB/s\n", name, elapsed, MESSAGES/elapsed, bytes/elapsed/1E6);
+	else
+		printf("%-60s %8.3fs %10.0f msg/s\n", name, elapsed, MESSAGES/elapsed);
+}
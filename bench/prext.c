@@ -0,0 +1,231 @@
+/*
+	prnf() extensions
+
+	This source file is an example only.
+	It is expected to be extended with various prext_mything(mything_t mything) functions specific to your application.
+
+*/
+
+	#include <stdbool.h>
+	#include <stddef.h>
+	#include <stdarg.h>
+	#include <string.h>
+	#include <inttypes.h>
+	#include <time.h>
+	#include <complex.h>
+
+	#include "prnf.h"
+	#include "prext.h"
+
+	#include <stdlib.h>
+	#include <assert.h>
+	#define prext_malloc(arg) 	prext_alloc(arg)
+	#define PREXT_ASSERT(arg) 	assert(arg)
+
+//********************************************************************************************************
+// Private variables
+//********************************************************************************************************
+
+//	Date and time for prext_now(), rendered when the second changes
+	struct now_cache_struct
+	{
+		time_t sec;
+		char date[sizeof("YYYY-MM-DDTHH:MM:SS")];
+		char zone[sizeof("+hhmm")];
+		uint_least8_t zone_len;
+	};
+
+	static _Thread_local struct now_cache_struct now_cache = {.sec = -1};
+
+//********************************************************************************************************
+// Private prototypes
+//********************************************************************************************************
+
+	static void* prext_alloc(size_t size);
+	static void prext_ip_out(struct prnf_out_struct* out, const void* ctx);
+	static void prext_mac_out(struct prnf_out_struct* out, const void* ctx);
+	static void prext_uuid_out(struct prnf_out_struct* out, const void* ctx);
+
+//********************************************************************************************************
+// Public functions
+//********************************************************************************************************
+
+void prext_register(void)
+{
+	prnf_conv_register("ip", prext_ip_out);
+	prnf_conv_register("mac", prext_mac_out);
+	prnf_conv_register("uuid", prext_uuid_out);
+}
+
+int* prext_cplex_rec(complex float c)
+{
+	#define TXT_SIZE sizeof("(1234567890.1234567890, 1234567890.1234567890)")
+
+	char* txt = prext_malloc(TXT_SIZE);
+	snprnf(txt, TXT_SIZE, "(%f, %f)", creal(c), cimag(c));
+
+	#undef TXT_SIZE
+	return (int*)txt;
+}
+
+int* prext_cplex_pol(complex float c)
+{
+	#define TXT_SIZE sizeof("(1234567890.1234567890 @1234567890.1234567890)")
+	
+	char* txt = prext_malloc(TXT_SIZE);
+	snprnf(txt, TXT_SIZE, "(%f @%f)", cabsf(c), cargf(c));
+
+	#undef TXT_SIZE
+	return (int*)txt;
+}
+
+int* prext_tstamp(const char* fmt, time_t t)
+{
+	struct tm tm;
+	#define TXT_SIZE 100
+
+	char* txt = prext_malloc(TXT_SIZE);
+	PREXT_ASSERT(txt);
+	txt[0] = 0;
+	strftime(txt, TXT_SIZE, fmt, localtime_r(&t, &tm));
+
+	#undef TXT_SIZE
+	return (int*)txt;
+}
+
+int* prext_period(uint32_t seconds)
+{
+	#define TXT_SIZE (sizeof("XXy XXXd XXh XXm XXs"))
+
+	char* txt = prext_malloc(TXT_SIZE);
+	PREXT_ASSERT(txt);
+	snprnf(txt, TXT_SIZE, "%p", PREXT_PERIOD(seconds));
+
+	#undef TXT_SIZE
+	return (int*)txt;
+}
+
+size_t prext_now(char* dst, int frac_digits)
+{
+	static const uint32_t divisor[10] = {1000000000, 100000000, 10000000, 1000000, 100000, 10000, 1000, 100, 10, 1};
+	struct now_cache_struct* cache = &now_cache;
+	struct timespec ts;
+	struct tm tm;
+	uint32_t frac;
+	char* ptr;
+	int i;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+
+	// the UTC offset can only change with the second (or the TZ environment variable)
+	if(ts.tv_sec != cache->sec)
+	{
+		localtime_r(&ts.tv_sec, &tm);
+		strftime(cache->date, sizeof(cache->date), "%Y-%m-%dT%H:%M:%S", &tm);
+		cache->zone_len = strftime(cache->zone, sizeof(cache->zone), "%z", &tm);
+		cache->sec = ts.tv_sec;
+	};
+
+	memcpy(dst, cache->date, sizeof(cache->date)-1);
+	ptr = dst + sizeof(cache->date)-1;
+
+	if(frac_digits > 9)
+		frac_digits = 9;
+	if(frac_digits > 0)
+	{
+		*ptr = '.';
+		frac = (uint32_t)ts.tv_nsec / divisor[frac_digits];
+		for(i=frac_digits; i; i--)
+		{
+			ptr[i] = '0' + frac%10;
+			frac /= 10;
+		};
+		ptr += frac_digits+1;
+	};
+
+	memcpy(ptr, cache->zone, cache->zone_len);
+	ptr += cache->zone_len;
+	*ptr = 0;
+
+	return ptr - dst;
+}
+
+void prext_now_out(struct prnf_out_struct* out, const void* ctx)
+{
+	char txt[PREXT_NOW_SIZE];
+	prnf_out_blk(out, txt, prext_now(txt, *(const int*)ctx));
+}
+
+void prext_tstamp_out(struct prnf_out_struct* out, const void* ctx)
+{
+	const struct prext_tstamp_struct* tstamp = ctx;
+	char txt[100];
+	struct tm tm;
+
+	txt[0] = 0;
+	strftime(txt, sizeof(txt), tstamp->fmt, localtime_r(&tstamp->t, &tm));
+	prnf_out(out, "%s", txt);
+}
+
+void prext_period_out(struct prnf_out_struct* out, const void* ctx)
+{
+	static const uint32_t unit_seconds[] = {31536000, 86400, 3600, 60, 1};
+	static const char unit_names[] = "ydhms";
+	uint32_t seconds = *(const uint32_t*)ctx;
+	const char* sep = "";
+	int i;
+
+	for(i=0; i<5; i++)
+	{
+		if(seconds >= unit_seconds[i] || (i == 4 && !*sep))
+		{
+			prnf_out(out, "%s%"PRIu32"%c", sep, seconds/unit_seconds[i], unit_names[i]);
+			seconds %= unit_seconds[i];
+			sep = " ";
+		};
+	};
+}
+
+void prext_cplex_rec_out(struct prnf_out_struct* out, const void* ctx)
+{
+	complex float c = *(const complex float*)ctx;
+	prnf_out(out, "(%f, %f)", crealf(c), cimagf(c));
+}
+
+void prext_cplex_pol_out(struct prnf_out_struct* out, const void* ctx)
+{
+	complex float c = *(const complex float*)ctx;
+	prnf_out(out, "(%f @%f)", cabsf(c), cargf(c));
+}
+
+//********************************************************************************************************
+// Private functions
+//********************************************************************************************************
+
+// From prnf's arena if it is enabled and has room, otherwise the heap
+static void* prext_alloc(size_t size)
+{
+	void* ptr = prnf_arena_alloc(size);
+	return ptr? ptr : malloc(size);
+}
+
+static void prext_ip_out(struct prnf_out_struct* out, const void* ctx)
+{
+	const uint8_t* ip = ctx;
+	prnf_out(out, "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+}
+
+static void prext_mac_out(struct prnf_out_struct* out, const void* ctx)
+{
+	const uint8_t* mac = ctx;
+	prnf_out(out, "%02X:%02X:%02X:%02X:%02X:%02X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+}
+
+static void prext_uuid_out(struct prnf_out_struct* out, const void* ctx)
+{
+	const uint8_t* uuid = ctx;
+	int i;
+
+	for(i=0; i<16; i++)
+		prnf_out(out, (i == 4 || i == 6 || i == 8 || i == 10)? "-%02X" : "%02X", uuid[i]);
+}
@@ -20,9 +20,10 @@
 //********************************************************************************************************
 
 	void prnf_putch(void* dst, char c);
+	void prnf_putblk(void* dst, const char* blk, size_t len);
 
-	#define DBG(_fmtarg, ...)		prnf("\e[32m%n %s:%.4i(%s)\v55 : "_fmtarg"\e[m\n", prext_tstamp(PREXT_ISO8601,time(NULL)), __FILE__, __LINE__ , __func__,##__VA_ARGS__)
-	#define DBG_ERR(_fmtarg, ...)	fptrprnf(prnf_putch, (void*)stderr, "\e[31m%n %s:%.4i(%s) **ERROR**\v55 : "_fmtarg"\e[m\n", prext_tstamp(PREXT_ISO8601,time(NULL)), __FILE__, __LINE__, __func__,##__VA_ARGS__)
+	#define DBG(_fmtarg, ...)		prnf("\e[32m%p %s:%.4i(%s)\v60 : "_fmtarg"\e[m\n", PREXT_NOW(3), __FILE__, __LINE__ , __func__,##__VA_ARGS__)
+	#define DBG_ERR(_fmtarg, ...)	fptrprnf(prnf_putch, (void*)stderr, "\e[31m%p %s:%.4i(%s) **ERROR**\v60 : "_fmtarg"\e[m\n", PREXT_NOW(3), __FILE__, __LINE__, __func__,##__VA_ARGS__)
 
 //********************************************************************************************************
 // Public variables
@@ -47,6 +48,10 @@ int main(int argc, const char* argv[])
 	complex float cb = -18.19 + 9.473*I;
 	complex float cc = ca * cb;
 	time_t t = time(NULL);
+	uint8_t ip[4] = {192, 168, 1, 20};
+	uint8_t mac[6] = {0x00, 0x1A, 0x2B, 0x3C, 0x4D, 0x5E};
+
+	prext_register();
 
 	printf("Hello from regular printf()\n");
 	prnf("Hello from prnf()\n\n");
@@ -66,12 +71,21 @@ int main(int argc, const char* argv[])
 
 	prnf("The current time is %n, which is around %n after the unix epoc\n\n", prext_tstamp(PREXT_ISO8601, t), prext_period((uint32_t)t));
 
+	prnf("The same without the heap, right aligned to 30 [%30p]\n\n", PREXT_PERIOD((uint32_t)t));
+
+	prnf("Registered conversions, host %p{ip} has MAC address %p{mac}\n\n", ip, mac);
+
+	prnf("MAC address %p, and a hex dump of the same:\n%p\n", PRNF_HEX_SEP(mac, 6, '-'), PRNF_XXD(mac, 6));
+
+	prnf("JSON output, with strings escaped as they are printed:\n");
+	prnf_json("{\"host\":%p{ip},\"up\":%u,\"note\":%s,\"mains\":%.1f}\n\n", ip, (unsigned)t, "say \"hi\"\tbye", 230.0);
+
 	prnf("\v10-Column 10\n\v20*Column 20\n\v30~Column 30\n\n\n");
 
 	prnf("\v40*\n Example banner\n\v40*\n\n");
 
-	prnf("Complex multiplication in rectangular form:\n%n * %n = %n\n\n", prext_cplex_rec(ca), prext_cplex_rec(cb), prext_cplex_rec(cc));
-	prnf("Complex multiplication in polar form:\n%n * %n = %n\n\n", prext_cplex_pol(ca), prext_cplex_pol(cb), prext_cplex_pol(cc));
+	prnf("Complex multiplication in rectangular form:\n%p * %p = %p\n\n", PREXT_CPLEX_REC(ca), PREXT_CPLEX_REC(cb), PREXT_CPLEX_REC(cc));
+	prnf("Complex multiplication in polar form:\n%p * %p = %p\n\n", PREXT_CPLEX_POL(ca), PREXT_CPLEX_POL(cb), PREXT_CPLEX_POL(cc));
 
 	return 0;
 }
@@ -84,6 +98,14 @@ void prnf_putch(void* dst, char c)
 	fprintf((FILE*)dst, "%c",c);
 }
 
+// With PRNF_PUTBLK defined in prnf.c, prnf() passes each call to this in one block, so lines from different threads do not interleave.
+void prnf_putblk(void* dst, const char* blk, size_t len)
+{
+	if(dst == NULL)
+		dst = stdout;
+	fwrite(blk, 1, len, (FILE*)dst);
+}
+
 //********************************************************************************************************
 // Private functions
 //********************************************************************************************************
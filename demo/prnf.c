@@ -38,6 +38,11 @@ See the below example.
 	#define PRNF_ASSERT(arg) assert(arg)
 
 
+/*	prnf() is used from multiple threads on desktop applications, so pass whole lines to prnf_putblk() rather than characters to prnf_putch().
+ *****************************************************************************************/
+	#define PRNF_PUTBLK
+
+
 /*	Finally, include the prnf impementation.
  *****************************************************************************************/
     #define PRNF_IMPLEMENTATION
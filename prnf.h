@@ -21,6 +21,15 @@ Default precision for %f (floats)
 Provide column alignment using \v (see README.md)
 	-DPRNF_COL_ALIGNMENT
 
+prnf_SL() and fptrprnf_SL() produce tokenized output (see _TOK macros)
+	-DPRNF_TOKENIZE
+
+Size of the stack buffer used to stage output for block handlers (see blkprnf)
+	-DPRNF_BLK_SIZE=128
+
+prnf(), vprnf() and prnf_TOK() pass output in blocks to prnf_putblk() instead of characters to prnf_putch()
+	-DPRNF_PUTBLK
+
 
 Alternatively, may may define a selection of the above symbols in the .c file containing #define PRNF_IMPLEMENTATION before including prnf.h
 
@@ -30,6 +39,8 @@ Alternatively, may may define a selection of the above symbols in the .c file co
 	#define PRNF_ENG_PREC_DEFAULT 	0
 	#define PRNF_FLOAT_PREC_DEFAULT 3
 	#define PRNF_COL_ALIGNMENT
+	#define PRNF_BLK_SIZE 128
+	#define PRNF_PUTBLK
 
 
 -------------------------------------------------------------------------------------
@@ -40,7 +51,7 @@ Alternatively, may may define a selection of the above symbols in the .c file co
  
  * Thread and re-entrant safe.
  * Single header (stb style).
- * Low stack & ram usage, zero heap usage (unless extensions are used).
+ * Low stack & ram usage, zero heap usage (unless %n extensions are used).
  * Full support for AVR's PROGMEM requirements, with almost no cost to non-AVR targets.
  * Compatible enough to make use of GCC's format and argument checking (even for AVR).
  
@@ -115,6 +126,9 @@ Alternatively, may may define a selection of the above symbols in the .c file co
   	o		NOT Octal. Actually binary, .precision defaults to argument size [length]
   	s		null-terminated string in ram, or NULL. Outputs nothing for NULL.
 	S		For AVR targets, read string from PROGMEM, otherwise same as %s
+	s{json}	String escaped for JSON (\" \\ \n \u001B etc.), also %S{json} %n{json}
+	s{csv}	String as a CSV field, quoted if it contains a comma, quote or control character (width padding is inside the quotes)
+	s{c}	String with " \\ and control characters escaped as \ooo (octal)
   	c		character 
 
 	f,F		Floating point. NAN & INF are always uppercase.
@@ -126,13 +140,15 @@ Alternatively, may may define a selection of the above symbols in the .c file co
 
 	e		NOT exponential. Floating point with engineering notation (y z a f p n u m - k M G T P E Z Y).
 			Number is postpended with the SI prefix. Default precision is 0.
+
+	p		NOT a pointer. A callback extension created with PRNF_EXT(), which writes directly to the output (see below).
+	p{name}	A registered conversion, given a pointer argument (see below).
  
 
  Unsupported types:
 
 	g,G 	Adaptive floats not available
 	a,A		Double in hex notation not available
-	p		Pointer not available
 	n		classic %n is not available, but %n may be repurposed for extensions if enabled (see below)
 
 Another approach is to use GCC's --wrap feature in the compiler flags, which is probably better.
@@ -187,6 +203,9 @@ See README.md for more info.
 //	size_t
 	#include <stddef.h>
 
+//	uint32_t, uint64_t for tokenized output
+	#include <stdint.h>
+
 //	AVR's PSTR
 	#ifdef __AVR__
 	#include <avr/pgmspace.h>
@@ -217,33 +236,330 @@ AVR targets.
 		prnf_SL("%50S\n", PRNF_ARG_SL("RIGHT"));
 */
 
-#ifdef __AVR__
 //	Compiler will first test argument types based on format string, then remove the empty function during optimization.
 	static inline void fmttst_optout(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
 	static inline void fmttst_optout(const char* fmt, ...)
 	{
+		(void)fmt;
 	}
 
+/*
+Callback extensions.
+
+	The argument for %p is a descriptor {fn, ctx}. fn() is called during printing, and writes to the output with prnf_out().
+	Unlike %n extensions there is no heap allocation and no copy, so these are always available.
+
+		static void print_bananas(struct prnf_out_struct* out, const void* ctx)
+		{
+			prnf_out(out, "%i bananas", *(const int*)ctx);
+		}
+		#define PREXT_BANANAS(_n)	PRNF_EXT(print_bananas, &(const int){_n})
+
+		prnf("Fred has %p\n", PREXT_BANANAS(freds_bananas));
+
+	The descriptor and ctx are compound literals, which live until the end of the enclosing block (so for the duration of the prnf call).
+	Width and the - flag are supported, fn() is called twice to measure the output if a width is given. Precision is ignored.
+	prnf_out() formats from RAM on AVR targets.
+	Tokenized output renders the extension to a string of up to PRNF_EXT_TOK_SIZE (64) characters.
+	The compiler accepts any pointer for %p, so PRNF_EXT() records the address of each descriptor it creates, in a ring of the
+	 calling thread's last PRNF_EXT_RECENT (16, 8 on AVR). A %p argument is only called if it is one of them, other pointers are
+	 never dereferenced, and output nothing. A descriptor must be printed by the thread which created it, before it creates PRNF_EXT_RECENT more.
+
+Registered conversions.
+
+	Conversions for the application's types can be registered by name, and used as %p{name} with a pointer to the value.
+
+		static void print_ip(struct prnf_out_struct* out, const void* ctx)
+		{
+			const uint8_t* ip = ctx;
+			prnf_out(out, "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+		}
+
+		prnf_conv_register("ip", print_ip);		// once, at startup
+		prnf("Connected to %p{ip}\n", &addr);
+
+	The compiler sees %p followed by the text {ip}, so the argument is still checked to be a pointer.
+	The name is resolved to an index into the registry while parsing the placeholder, and the handler is called through it (with the argument as ctx).
+	Width and the - flag are supported as for PRNF_EXT(). A NULL argument, or an unregistered name, outputs nothing.
+	Up to PRNF_CONV_MAX (8) conversions may be registered, before printing starts (registration is not synchronized with printing threads).
+	Registered conversions are not supported by tokenized output, the argument is the application's value and only the format names it's conversion.
+	A _TOK format containing p{ (ie. %p{ip} or %-8p{ip}) is rejected when compiling.
+*/
+	struct prnf_out_struct;
+
+	struct prnf_ext_struct
+	{
+		void(*fn)(struct prnf_out_struct* out, const void* ctx);
+		const void* ctx;
+	};
+
+//	Descriptor for a %p argument, recorded as created by the calling thread
+	#define PRNF_EXT(_fn, _ctx)	prnf_ext_mark(&(const struct prnf_ext_struct){(_fn), (_ctx)})
+
+/*
+Hex dumps.
+
+	%p arguments which print len bytes from ptr in hex, without a placeholder per byte.
+
+		prnf("key %p\n", PRNF_HEX(key, sizeof(key)));				// key 00A1B2C3...
+		prnf("mac %p\n", PRNF_HEX_SEP(mac, 6, ':'));				// mac 00:1A:2B:3C:4D:5E
+		prnf("rx %u bytes\n%p", (unsigned)len, PRNF_XXD(buf, len));	// lines of 16 bytes, with offset and ASCII columns as xxd
+
+		00000000: 4865 6C6C 6F2C 2077 6F72 6C64 210A 0001  Hello, world!...
+
+	The separator must be a printable character, or 0 for none. Each line of PRNF_XXD() output ends with a line ending.
+	Bytes are converted 16 at a time with SSE2 where available.
+*/
+	struct prnf_hex_struct
+	{
+		const void* ptr;
+		size_t len;
+		char sep;
+		uint8_t xxd;
+	};
+
+	#define PRNF_HEX(_ptr, _len)			PRNF_EXT(prnf_hex_out, (&(const struct prnf_hex_struct){(_ptr), (_len), 0, 0}))
+	#define PRNF_HEX_SEP(_ptr, _len, _sep)	PRNF_EXT(prnf_hex_out, (&(const struct prnf_hex_struct){(_ptr), (_len), (_sep), 0}))
+	#define PRNF_XXD(_ptr, _len)			PRNF_EXT(prnf_hex_out, (&(const struct prnf_hex_struct){(_ptr), (_len), 0, 1}))
+
+/*
+Base64 and base32.
+
+	%p arguments which encode len bytes from ptr (RFC 4648) directly to the output, without a temporary buffer.
+
+		prnf("key=%p\n", PRNF_BASE64(key, sizeof(key)));			// padded with =
+		prnf("token=%p\n", PRNF_BASE64URL(tok, tok_len));			// - and _ instead of + and /, not padded
+		prnf("secret=%p\n", PRNF_BASE32(secret, sizeof(secret)));	// padded with =
+
+	Base64 is encoded 12 bytes at a time with SSSE3 where available.
+*/
+	#define PRNF_ENC_BASE64		0
+	#define PRNF_ENC_BASE64URL	1
+	#define PRNF_ENC_BASE32		2
+
+	struct prnf_enc_struct
+	{
+		const void* ptr;
+		size_t len;
+		uint8_t enc;		//PRNF_ENC_x
+	};
+
+	#define PRNF_BASE64(_ptr, _len)		PRNF_EXT(prnf_enc_out, (&(const struct prnf_enc_struct){(_ptr), (_len), PRNF_ENC_BASE64}))
+	#define PRNF_BASE64URL(_ptr, _len)	PRNF_EXT(prnf_enc_out, (&(const struct prnf_enc_struct){(_ptr), (_len), PRNF_ENC_BASE64URL}))
+	#define PRNF_BASE32(_ptr, _len)		PRNF_EXT(prnf_enc_out, (&(const struct prnf_enc_struct){(_ptr), (_len), PRNF_ENC_BASE32}))
+
+/*
+Arrays.
+
+	%p arguments which print count elements of an int16_t, int32_t or float array, each formatted by the placeholder spec, separated by sep.
+
+		prnf("adc: %p\n", PRNF_ARRAY_INT16(samples, 8, "%5i", ","));		// adc:   512,  -13,  ...
+		prnf("temps: %p\n", PRNF_ARRAY_FLOAT(temps, n, "%.1f", " "));	// temps: 21.5 22.0 ...
+
+	The spec is a single placeholder, which is parsed once for the whole array. It's width, precision and flags apply to every element.
+	The spec is checked against the element type by the compiler, dynamic width and precision (*) are not supported.
+*/
+	#define PRNF_ARRAY_I16		0
+	#define PRNF_ARRAY_I32		1
+	#define PRNF_ARRAY_FLT		2
+
+	struct prnf_array_struct
+	{
+		const void* ptr;
+		size_t count;
+		const char* spec;
+		const char* sep;
+		uint8_t type;		//PRNF_ARRAY_x
+	};
+
+	#define PRNF_ARRAY_(_type, _arg_type, _ptr, _count, _spec, _sep)	\
+		(0? (fmttst_optout(_spec, (_arg_type)0), (void*)0) : PRNF_EXT(prnf_array_out, (&(const struct prnf_array_struct){(_ptr), (_count), (_spec), (_sep), (_type)})))
+
+	#define PRNF_ARRAY_INT16(_ptr, _count, _spec, _sep)	PRNF_ARRAY_(PRNF_ARRAY_I16, int16_t, (const int16_t*){_ptr}, _count, _spec, _sep)
+	#define PRNF_ARRAY_INT32(_ptr, _count, _spec, _sep)	PRNF_ARRAY_(PRNF_ARRAY_I32, int32_t, (const int32_t*){_ptr}, _count, _spec, _sep)
+	#define PRNF_ARRAY_FLOAT(_ptr, _count, _spec, _sep)	PRNF_ARRAY_(PRNF_ARRAY_FLT, double, (const float*){_ptr}, _count, _spec, _sep)
+
+/*
+Tables.
+
+	Print an array of structs as CSV or aligned text, one line per struct, from a schema of the fields to print.
+
+		struct reading_struct {uint32_t t; int16_t level; float volts; const char* site;};
+
+		static const struct prnf_field_struct fields[] =
+		{
+			PRNF_FIELD(struct reading_struct, t, PRNF_FIELD_U32, NULL),		// NULL for the default placeholder of the type
+			PRNF_FIELD(struct reading_struct, level, PRNF_FIELD_I16, "%6i"),
+			PRNF_FIELD(struct reading_struct, volts, PRNF_FIELD_FLOAT, "%.2f"),
+			PRNF_FIELD(struct reading_struct, site, PRNF_FIELD_STR, "%-10s"),
+		};
+		static const struct prnf_table_struct table = {fields, 4, PRNF_TABLE_CSV, 1};
+
+		blkprnf_table(my_blk_handler, &fd, &table, readings, sizeof(readings[0]), reading_cnt);
+
+	The placeholders are parsed once per call, each row is then printed without parsing.
+	Output is staged in a buffer of PRNF_TABLE_BLK_SIZE on the stack, and passed to the handler in whole lines where possible.
+	PRNF_TABLE_BLK_SIZE is 4096, and up to PRNF_TABLE_FIELDS_MAX (32) fields are parsed to the stack. On AVR they default to PRNF_BLK_SIZE and 8.
+	CSV fields are separated by , and strings are output as CSV fields (see %s{csv}). The header line is the field names.
+	Text columns are separated by a space, and are at least as wide as their name, so the header (if any) lines up with them.
+	PRNF_FIELD_STR is a const char* member, PRNF_FIELD_TEXT is a null terminated char[] member.
+	64 bit fields need PRNF_SUPPORT_LONG_LONG.
+	A spec which does not suit the field's type (ie. %s for an integer, or a * width) fails PRNF_WARN(), and the default placeholder of the type is used.
+*/
+	#define PRNF_FIELD_I8		0
+	#define PRNF_FIELD_U8		1
+	#define PRNF_FIELD_I16		2
+	#define PRNF_FIELD_U16		3
+	#define PRNF_FIELD_I32		4
+	#define PRNF_FIELD_U32		5
+	#define PRNF_FIELD_I64		6
+	#define PRNF_FIELD_U64		7
+	#define PRNF_FIELD_FLOAT	8
+	#define PRNF_FIELD_DOUBLE	9
+	#define PRNF_FIELD_STR		10
+	#define PRNF_FIELD_TEXT		11
+
+	struct prnf_field_struct
+	{
+		size_t offset;			// of the member within the struct
+		uint8_t type;			// PRNF_FIELD_x
+		const char* spec;		// placeholder ie. "%.2f", or NULL
+		const char* name;		// column heading
+	};
+
+	#define PRNF_FIELD(_struct, _member, _type, _spec)	{offsetof(_struct, _member), (_type), (_spec), #_member}
+
+	#define PRNF_TABLE_CSV		0
+	#define PRNF_TABLE_TEXT		1
+
+	struct prnf_table_struct
+	{
+		const struct prnf_field_struct* fields;
+		uint8_t field_cnt;		// up to PRNF_TABLE_FIELDS_MAX
+		uint8_t style;			// PRNF_TABLE_x
+		uint8_t header;			// print a line of field names first
+	};
+
+#ifdef __AVR__
 //	_SL macros for AVR
 	#define prnf_SL(_fmtarg, ...) 						({int _prv; _prv = prnf_P(PSTR(_fmtarg) ,##__VA_ARGS__); while(0) fmttst_optout(_fmtarg ,##__VA_ARGS__); _prv;})
 	#define sprnf_SL(_dst, _fmtarg, ...) 				({int _prv; _prv = sprnf_P(_dst, PSTR(_fmtarg) ,##__VA_ARGS__); while(0) fmttst_optout(_fmtarg ,##__VA_ARGS__); _prv;})
 	#define snprnf_SL(_dst, _dst_size, _fmtarg, ...) 	({int _prv; _prv = snprnf_P(_dst, _dst_size, PSTR(_fmtarg) ,##__VA_ARGS__); while(0) fmttst_optout(_fmtarg ,##__VA_ARGS__); _prv;})
 	#define snappf_SL(_dst, _dst_size, _fmtarg, ...) 	({int _prv; _prv = snappf_P(_dst, _dst_size, PSTR(_fmtarg) ,##__VA_ARGS__); while(0) fmttst_optout(_fmtarg ,##__VA_ARGS__); _prv;})
 	#define fptrprnf_SL(_fptr, _fargs, _fmtarg, ...) 	({int _prv; _prv = fptrprnf_P(_fptr, _fargs, PSTR(_fmtarg) ,##__VA_ARGS__); while(0) fmttst_optout(_fmtarg ,##__VA_ARGS__); _prv;})
-	#define PRNF_ARG_SL(_arg)							((wchar_t*)PSTR(_arg))
+	#define blkprnf_SL(_fptr, _fargs, _fmtarg, ...) 	({int _prv; _prv = blkprnf_P(_fptr, _fargs, PSTR(_fmtarg) ,##__VA_ARGS__); while(0) fmttst_optout(_fmtarg ,##__VA_ARGS__); _prv;})
+	#define PRNF_ARG_SL(_arg)							((const wchar_t*)PSTR(_arg))
 #else
 	#define prnf_SL(_fmtarg, ...) 						prnf(_fmtarg ,##__VA_ARGS__)
 	#define sprnf_SL(_dst, _fmtarg, ...) 				sprnf(_dst, _fmtarg ,##__VA_ARGS__)
 	#define snprnf_SL(_dst, _dst_size, _fmtarg, ...) 	snprnf(_dst, _dst_size, _fmtarg ,##__VA_ARGS__)
 	#define snappf_SL(_dst, _dst_size, _fmtarg, ...) 	snappf(_dst, _dst_size, _fmtarg ,##__VA_ARGS__)
 	#define fptrprnf_SL(_fptr, _fargs, _fmtarg, ...)	fptrprnf(_fptr, _fargs, _fmtarg ,##__VA_ARGS__)
-	#define PRNF_ARG_SL(_arg)							((wchar_t*)(_arg))
+	#define blkprnf_SL(_fptr, _fargs, _fmtarg, ...)		blkprnf(_fptr, _fargs, _fmtarg ,##__VA_ARGS__)
+	#define PRNF_ARG_SL(_arg)							((const wchar_t*)(_arg))
+#endif
+
+/*
+Tokenized output.
+
+	The _TOK macros do not place the format string in the image. Instead the string literal is placed in the "prnf_fmt" section,
+	 and only it's offset within that section (the token) is output, followed by the arguments packed in binary form.
+	The output is expanded back to text by tools/detok, which reads the format strings from the "prnf_fmt" section of the ELF file.
+
+	If PRNF_TOKENIZE is defined, prnf_SL() and fptrprnf_SL() will use the _TOK macros.
+	The buffer printing _SL macros (sprnf_SL, snprnf_SL, snappf_SL) are never tokenized, as their output is text for the application.
+
+	For the format strings to be absent from the firmware image, the "prnf_fmt" section must not be loaded.
+	With GNU ld this can be done by adding the following to the SECTIONS of the linker script:
+
+		prnf_fmt 0 (INFO) : { __start_prnf_fmt = .; KEEP(*(prnf_fmt)) }
+
+	Hosted targets (and the linker's default script) will leave the section in the image as read only data, which is harmless.
+
+	Output format, integers are LEB128 varints, signed integers are zig-zag encoded first.
+		token					varint
+		d i u x X o c * 		zig-zag varint
+		f e 					raw float (4 bytes, or 8 bytes if PRNF_SUPPORT_DOUBLE is defined), little endian
+		s S n p					varint length, followed by the characters (no terminator)
+
+	Limitations:
+		A maximum of 16 arguments.
+		%S arguments must be passed with PRNF_ARG_SL(), which makes them const wchar_t*. A plain wchar_t* may be the int* of %n.
+		Any other int* argument is taken to be a %n string, and is freed once printed. Cast a pointer for %p to void*.
+		%p{name} is not supported (see Registered conversions). A format containing p{ anywhere (so with any flags or width) does not compile.
+*/
+
+//	Argument classes packed into the 64bit type descriptor, 3 bits per argument after a 5 bit argument count.
+	#define PRNF_TOK_INT		0
+	#define PRNF_TOK_LONG		1
+	#define PRNF_TOK_LLONG		2
+	#define PRNF_TOK_FLOAT		3
+	#define PRNF_TOK_STR		4
+	#define PRNF_TOK_NSTR		5
+	#define PRNF_TOK_EXT		6
+	#define PRNF_TOK_SL			7	// PRNF_ARG_SL() string, in program memory on AVR
+
+	#define PRNF_TOK_CNT_BITS	5
+	#define PRNF_TOK_TYPE_BITS	3
+
+	#define PRNF_TOK_TYPE(_arg)	((uint64_t)_Generic((_arg),											\
+		float: PRNF_TOK_FLOAT, double: PRNF_TOK_FLOAT,													\
+		char*: PRNF_TOK_STR, const char*: PRNF_TOK_STR,													\
+		int*: PRNF_TOK_NSTR, const wchar_t*: PRNF_TOK_SL,												\
+		void*: PRNF_TOK_EXT, const void*: PRNF_TOK_EXT,													\
+		default: (sizeof(_arg) <= sizeof(int) ? PRNF_TOK_INT : sizeof(_arg) <= sizeof(long) ? PRNF_TOK_LONG : PRNF_TOK_LLONG)))
+
+	#define PRNF_TOK_CAT_(_a, _b)	_a##_b
+	#define PRNF_TOK_CAT(_a, _b)	PRNF_TOK_CAT_(_a, _b)
+	#define PRNF_TOK_NARG(...)		PRNF_TOK_NARG_(_0 ,##__VA_ARGS__, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+	#define PRNF_TOK_NARG_(_0, _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, _n, ...) _n
+
+	#define PRNF_TOK_TT_0(_s)
+	#define PRNF_TOK_TT_1(_s, _a)		| (PRNF_TOK_TYPE(_a) << (_s))
+	#define PRNF_TOK_TT_2(_s, _a, ...)	| (PRNF_TOK_TYPE(_a) << (_s)) PRNF_TOK_TT_1((_s)+PRNF_TOK_TYPE_BITS, __VA_ARGS__)
+	#define PRNF_TOK_TT_3(_s, _a, ...)	| (PRNF_TOK_TYPE(_a) << (_s)) PRNF_TOK_TT_2((_s)+PRNF_TOK_TYPE_BITS, __VA_ARGS__)
+	#define PRNF_TOK_TT_4(_s, _a, ...)	| (PRNF_TOK_TYPE(_a) << (_s)) PRNF_TOK_TT_3((_s)+PRNF_TOK_TYPE_BITS, __VA_ARGS__)
+	#define PRNF_TOK_TT_5(_s, _a, ...)	| (PRNF_TOK_TYPE(_a) << (_s)) PRNF_TOK_TT_4((_s)+PRNF_TOK_TYPE_BITS, __VA_ARGS__)
+	#define PRNF_TOK_TT_6(_s, _a, ...)	| (PRNF_TOK_TYPE(_a) << (_s)) PRNF_TOK_TT_5((_s)+PRNF_TOK_TYPE_BITS, __VA_ARGS__)
+	#define PRNF_TOK_TT_7(_s, _a, ...)	| (PRNF_TOK_TYPE(_a) << (_s)) PRNF_TOK_TT_6((_s)+PRNF_TOK_TYPE_BITS, __VA_ARGS__)
+	#define PRNF_TOK_TT_8(_s, _a, ...)	| (PRNF_TOK_TYPE(_a) << (_s)) PRNF_TOK_TT_7((_s)+PRNF_TOK_TYPE_BITS, __VA_ARGS__)
+	#define PRNF_TOK_TT_9(_s, _a, ...)	| (PRNF_TOK_TYPE(_a) << (_s)) PRNF_TOK_TT_8((_s)+PRNF_TOK_TYPE_BITS, __VA_ARGS__)
+	#define PRNF_TOK_TT_10(_s, _a, ...)	| (PRNF_TOK_TYPE(_a) << (_s)) PRNF_TOK_TT_9((_s)+PRNF_TOK_TYPE_BITS, __VA_ARGS__)
+	#define PRNF_TOK_TT_11(_s, _a, ...)	| (PRNF_TOK_TYPE(_a) << (_s)) PRNF_TOK_TT_10((_s)+PRNF_TOK_TYPE_BITS, __VA_ARGS__)
+	#define PRNF_TOK_TT_12(_s, _a, ...)	| (PRNF_TOK_TYPE(_a) << (_s)) PRNF_TOK_TT_11((_s)+PRNF_TOK_TYPE_BITS, __VA_ARGS__)
+	#define PRNF_TOK_TT_13(_s, _a, ...)	| (PRNF_TOK_TYPE(_a) << (_s)) PRNF_TOK_TT_12((_s)+PRNF_TOK_TYPE_BITS, __VA_ARGS__)
+	#define PRNF_TOK_TT_14(_s, _a, ...)	| (PRNF_TOK_TYPE(_a) << (_s)) PRNF_TOK_TT_13((_s)+PRNF_TOK_TYPE_BITS, __VA_ARGS__)
+	#define PRNF_TOK_TT_15(_s, _a, ...)	| (PRNF_TOK_TYPE(_a) << (_s)) PRNF_TOK_TT_14((_s)+PRNF_TOK_TYPE_BITS, __VA_ARGS__)
+	#define PRNF_TOK_TT_16(_s, _a, ...)	| (PRNF_TOK_TYPE(_a) << (_s)) PRNF_TOK_TT_15((_s)+PRNF_TOK_TYPE_BITS, __VA_ARGS__)
+
+//	Type descriptor for an argument list, the arguments are not evaluated.
+	#define PRNF_TOK_TYPES(...)		((uint64_t)PRNF_TOK_NARG(__VA_ARGS__) PRNF_TOK_CAT(PRNF_TOK_TT_, PRNF_TOK_NARG(__VA_ARGS__))(PRNF_TOK_CNT_BITS ,##__VA_ARGS__))
+
+//	Place a format string in the prnf_fmt section, and produce it's token.
+	#define PRNF_TOK_FMT(_fmtarg)	({static const char _tok_fmt[] __attribute__((section("prnf_fmt"), used)) = _fmtarg; (uint32_t)(_tok_fmt - __start_prnf_fmt);})
+
+//	%p{name} can not be tokenized, the argument is the application's value and the name is only in the format. Rejected when compiling.
+//	Any p{ is rejected, as flags and width may come between the % and the p. __builtin_strstr() of literals folds even without optimization.
+	extern void prnf_tok_conv_unsupported(void) __attribute__((error("%p{name} conversions (or p{ in the text) are not supported by tokenized output")));
+	#define PRNF_TOK_CONV_CHECK(_fmtarg)	do{if(__builtin_strstr(_fmtarg, "p{")) prnf_tok_conv_unsupported();}while(0)
+
+	#define prnf_TOK(_fmtarg, ...) 						({int _prv; PRNF_TOK_CONV_CHECK(_fmtarg); _prv = prnf_tok(PRNF_TOK_FMT(_fmtarg), PRNF_TOK_TYPES(__VA_ARGS__) ,##__VA_ARGS__); while(0) fmttst_optout(_fmtarg ,##__VA_ARGS__); _prv;})
+	#define fptrprnf_TOK(_fptr, _fargs, _fmtarg, ...) 	({int _prv; PRNF_TOK_CONV_CHECK(_fmtarg); _prv = fptrprnf_tok(_fptr, _fargs, PRNF_TOK_FMT(_fmtarg), PRNF_TOK_TYPES(__VA_ARGS__) ,##__VA_ARGS__); while(0) fmttst_optout(_fmtarg ,##__VA_ARGS__); _prv;})
+
+#ifdef PRNF_TOKENIZE
+	#undef prnf_SL
+	#undef fptrprnf_SL
+	#define prnf_SL(_fmtarg, ...) 						prnf_TOK(_fmtarg ,##__VA_ARGS__)
+	#define fptrprnf_SL(_fptr, _fargs, _fmtarg, ...)	fptrprnf_TOK(_fptr, _fargs, _fmtarg ,##__VA_ARGS__)
 #endif
 
 //********************************************************************************************************
 // Public variables
 //********************************************************************************************************
 
+//	Start of the tokenized format strings, provided by the linker.
+	extern const char __start_prnf_fmt[];
+
 //********************************************************************************************************
 // Public prototypes
 //********************************************************************************************************
@@ -265,6 +581,16 @@ AVR targets.
 //	void* out_vars is also passed to the void* parameter if the character handler.
 	int fptrprnf(void(*out_fptr)(void*, char), void* out_vars, const char* fmtstr, ...) __attribute__((format(printf, 3, 4)));
 
+//	Print. Sending output in blocks to the specified block handler, void* blk_vars is passed to it's void* parameter.
+//	Output is staged in a buffer of PRNF_BLK_SIZE on the stack, and passed to the handler at the end of the call.
+//	If the buffer fills, output up to the last line ending is passed on, so lines shorter than PRNF_BLK_SIZE are never split.
+//	This allows a handler to commit each call (or line) to it's destination in one operation, ie. a single write() which will not interleave with other threads.
+//	The block handler may be NULL if no output is required.
+	int blkprnf(void(*blk_fptr)(void*, const char*, size_t), void* blk_vars, const char* fmtstr, ...) __attribute__((format(printf, 3, 4)));
+
+//	Default block handler for prnf() if PRNF_PUTBLK is defined. If the application does not provide it, output is passed to prnf_putch().
+	void prnf_putblk(void* ctx, const char* blk, size_t len);
+
 
 //	non-variadic versions of the above, accepting va_list
 //	The variadic functions above are quite small and call these. 
@@ -275,6 +601,76 @@ AVR targets.
 	int vsnprnf(char* dst, size_t dst_size, const char* fmtstr, va_list va);
     int vsnappf(char* dst, size_t dst_size, const char* fmtstr, va_list va);
 	int vfptrprnf(void(*out_fptr)(void*, char), void* out_vars, const char* fmtstr, va_list va);
+	int vblkprnf(void(*blk_fptr)(void*, const char*, size_t), void* blk_vars, const char* fmtstr, va_list va);
+
+//	JSON output, the format string is a JSON template ie. blkprnf_json(sink, NULL, "{\"t\":%u,\"v\":%f,\"name\":%s}\n", t, v, name);
+//	String, character, hex, binary, %e and %p values are output as JSON strings, quoted and escaped while printing. NULL is output as null.
+//	Integers and %f are output as numbers, a NAN, INF or OVER %f is output as null.
+//	Width and precision apply to the value before escaping. The format string is read from RAM on AVR targets.
+	int prnf_json(const char* fmtstr, ...) __attribute__((format(printf, 1, 2)));
+	int snprnf_json(char* dst, size_t dst_size, const char* fmtstr, ...) __attribute__((format(printf, 3, 4)));
+	int fptrprnf_json(void(*out_fptr)(void*, char), void* out_vars, const char* fmtstr, ...) __attribute__((format(printf, 3, 4)));
+	int blkprnf_json(void(*blk_fptr)(void*, const char*, size_t), void* blk_vars, const char* fmtstr, ...) __attribute__((format(printf, 3, 4)));
+	int vprnf_json(const char* fmtstr, va_list va);
+	int vsnprnf_json(char* dst, size_t dst_size, const char* fmtstr, va_list va);
+	int vfptrprnf_json(void(*out_fptr)(void*, char), void* out_vars, const char* fmtstr, va_list va);
+	int vblkprnf_json(void(*blk_fptr)(void*, const char*, size_t), void* blk_vars, const char* fmtstr, va_list va);
+
+//	Allocate from the calling thread's arena for %n strings, enabled by defining PRNF_ARENA_SIZE (see README.md).
+//	Returns NULL if the arena is full or not enabled, the caller should then use the heap.
+//	The arena is reset when the outermost print finishes, if all strings allocated from it have been freed by printing them (or by prnf_ext_free()).
+//	Arena strings are bound to the thread which allocated them, they must be printed or freed by that thread.
+	void* prnf_arena_alloc(size_t size);
+
+//	Free a %n string which will not be printed, from the arena or with prnf_free().
+	void prnf_ext_free(void* str);
+
+//	Discard the calling thread's arena, including any strings which were never printed or freed. Those strings must not be used afterwards.
+//	Not to be called from within a print (ie. from a callback extension).
+	void prnf_arena_reset(void);
+
+//	Arena usage, for sizing PRNF_ARENA_SIZE. high_water is the most used at once by any thread.
+	struct prnf_arena_stats_struct
+	{
+		size_t size;
+		size_t high_water;
+		uint32_t overflows;			// allocations which did not fit
+		uint32_t held;				// prints which freed strings, but finished with others outstanding so the arena was not reset (a string leaked if this keeps rising)
+	};
+	struct prnf_arena_stats_struct prnf_arena_stats(void);
+
+//	Register a conversion for %p{name}, name must remain valid. Registering a name again replaces it's handler.
+//	Returns the index of the conversion, or -1 if the registry is full.
+	int prnf_conv_register(const char* name, void(*fn)(struct prnf_out_struct* out, const void* ctx));
+
+//	Record a descriptor as created by the calling thread, used by PRNF_EXT(). Returns ext.
+	void* prnf_ext_mark(const struct prnf_ext_struct* ext);
+
+//	Output from a callback extension (see PRNF_EXT above), returns the number of characters output.
+	int prnf_out(struct prnf_out_struct* out, const char* fmtstr, ...) __attribute__((format(printf, 2, 3)));
+	int vprnf_out(struct prnf_out_struct* out, const char* fmtstr, va_list va);
+
+//	Output len characters from a callback extension, without formatting.
+	void prnf_out_blk(struct prnf_out_struct* out, const char* blk, size_t len);
+
+//	Callback extension for PRNF_HEX(), PRNF_HEX_SEP() and PRNF_XXD(), ctx is a struct prnf_hex_struct.
+	void prnf_hex_out(struct prnf_out_struct* out, const void* ctx);
+
+//	Callback extension for PRNF_BASE64(), PRNF_BASE64URL() and PRNF_BASE32(), ctx is a struct prnf_enc_struct.
+	void prnf_enc_out(struct prnf_out_struct* out, const void* ctx);
+
+//	Callback extension for PRNF_ARRAY_INT16(), PRNF_ARRAY_INT32() and PRNF_ARRAY_FLOAT(), ctx is a struct prnf_array_struct.
+	void prnf_array_out(struct prnf_out_struct* out, const void* ctx);
+
+//	Print row_cnt structs of row_size bytes from rows as a table (see above), in blocks as blkprnf(). Returns the number of characters output.
+	size_t blkprnf_table(void(*blk_fptr)(void*, const char*, size_t), void* blk_vars, const struct prnf_table_struct* table, const void* rows, size_t row_size, size_t row_cnt);
+
+//	Tokenized output (see _TOK macros above), returns the number of bytes output.
+//	These are not intended to be called directly, the _TOK macros provide the token and argument types.
+	int prnf_tok(uint32_t token, uint64_t types, ...);
+	int fptrprnf_tok(void(*out_fptr)(void*, char), void* out_vars, uint32_t token, uint64_t types, ...);
+	int vfptrprnf_tok(void(*out_fptr)(void*, char), void* out_vars, uint32_t token, uint64_t types, va_list va);
+	int vblkprnf_tok(void(*blk_fptr)(void*, const char*, size_t), void* blk_vars, uint32_t token, uint64_t types, va_list va);
 
 #ifdef __AVR__
 	int prnf_P(const char* fmtstr, ...);
@@ -282,11 +678,13 @@ AVR targets.
 	int snprnf_P(char* dst, size_t dst_size, const char* fmtstr, ...);
 	int snappf_P(char* dst, size_t dst_size, const char* fmtstr, ...);
 	int fptrprnf_P(void(*out_fptr)(void*, char), void* out_vars, const char* fmtstr, ...);
+	int blkprnf_P(void(*blk_fptr)(void*, const char*, size_t), void* blk_vars, const char* fmtstr, ...);
 	int vprnf_P(const char* fmtstr, va_list va);
 	int vsprnf_P(char* dst, const char* fmtstr, va_list va);
 	int vsnprnf_P(char* dst, size_t dst_size, const char* fmtstr, va_list va);
     int vsnappf_P(char* dst, size_t dst_size, const char* fmtstr, va_list va);
 	int vfptrprnf_P(void(*out_fptr)(void*, char), void* out_vars, const char* fmtstr, va_list va);
+	int vblkprnf_P(void(*blk_fptr)(void*, const char*, size_t), void* blk_vars, const char* fmtstr, va_list va);
 #endif
 
 #ifdef __cplusplus
@@ -303,7 +701,7 @@ AVR targets.
 // PRNF Implementation
 // 
 //********************************************************************************************************
-#ifdef PRNF_IMPLEMENTATION
+#if defined(PRNF_IMPLEMENTATION) && !defined(_PRNF_IMPLEMENTED_)
 
 
 
@@ -314,6 +712,15 @@ AVR targets.
 	#include <stdbool.h>
 	#include <stdint.h>
 	#include <limits.h>
+	#include <string.h>
+
+	#ifdef __SSE2__
+		#include <emmintrin.h>
+	#endif
+
+	#ifdef __SSSE3__
+		#include <tmmintrin.h>
+	#endif
 
 //********************************************************************************************************
 // Local defines
@@ -327,6 +734,74 @@ AVR targets.
 		#define PRNF_FLOAT_PREC_DEFAULT 3
 	#endif
 
+	#ifndef PRNF_BLK_SIZE
+		#define PRNF_BLK_SIZE 128
+	#endif
+
+	#ifndef PRNF_EXT_TOK_SIZE
+		#define PRNF_EXT_TOK_SIZE 64
+	#endif
+
+	#ifndef PRNF_CONV_MAX
+		#define PRNF_CONV_MAX 8
+	#endif
+
+//	Descriptors recorded per thread by PRNF_EXT(), a %p argument is only called if it is one of them
+	#ifndef PRNF_EXT_RECENT
+		#ifdef __AVR__
+			#define PRNF_EXT_RECENT 8
+		#else
+			#define PRNF_EXT_RECENT 16
+		#endif
+	#endif
+
+	#ifndef PRNF_EXT_TLS
+		#ifdef __AVR__
+			#define PRNF_EXT_TLS
+		#else
+			#define PRNF_EXT_TLS	_Thread_local
+		#endif
+	#endif
+
+//	Bytes converted at a time by prnf_hex_out(), and per line of PRNF_XXD() output
+	#define HEX_CHUNK		32
+	#define XXD_LINE		16
+
+//	Bytes encoded at a time by prnf_enc_out(), multiples of the 3 and 5 byte groups
+	#define BASE64_CHUNK	48
+	#define BASE32_CHUNK	40
+
+//	Stack used by blkprnf_table(), kept small on AVR
+#ifdef __AVR__
+	#ifndef PRNF_TABLE_FIELDS_MAX
+		#define PRNF_TABLE_FIELDS_MAX 8
+	#endif
+	#ifndef PRNF_TABLE_BLK_SIZE
+		#define PRNF_TABLE_BLK_SIZE PRNF_BLK_SIZE
+	#endif
+#else
+	#ifndef PRNF_TABLE_FIELDS_MAX
+		#define PRNF_TABLE_FIELDS_MAX 32
+	#endif
+	#ifndef PRNF_TABLE_BLK_SIZE
+		#define PRNF_TABLE_BLK_SIZE 4096
+	#endif
+#endif
+
+//	placeholder_struct.conv for a %p{name} which is not registered
+	#define CONV_UNKNOWN	UINT_LEAST8_MAX
+
+//	32 bit FNV-1a, for conversion names
+	#define CONV_HASH_INIT	2166136261UL
+	#define CONV_HASH_PRIME	16777619UL
+
+//	Arena allocations are rounded up to this
+	#define ARENA_ALIGN		sizeof(void*)
+
+	#ifndef PRNF_ARENA_TLS
+		#define PRNF_ARENA_TLS	_Thread_local
+	#endif
+
 	#ifndef PRNF_WARN
 		#define PRNF_WARN(arg)	((void)0)
 	#endif
@@ -394,7 +869,10 @@ AVR targets.
 		#define FMTRD(_fmt) 	(*(_fmt))
 	#endif
 
-	enum {TYPE_NONE, TYPE_BIN, TYPE_INT, TYPE_UINT, TYPE_HEX, TYPE_STR, TYPE_PSTR, TYPE_NSTR, TYPE_CHAR, TYPE_FLOAT, TYPE_ENG};	// di u xX s S c fF eE
+//	Escapes for %s{name}
+	enum {ESC_NONE, ESC_JSON, ESC_CSV, ESC_C};
+
+	enum {TYPE_NONE, TYPE_BIN, TYPE_INT, TYPE_UINT, TYPE_HEX, TYPE_STR, TYPE_PSTR, TYPE_NSTR, TYPE_CHAR, TYPE_FLOAT, TYPE_ENG, TYPE_EXT};	// di u xX s S c fF eE p
 
 	struct placeholder_struct
 	{
@@ -408,6 +886,8 @@ AVR targets.
 		bool 	width_is_dynamic;
 		uint_least8_t size_modifier;	//equal to size of int, or size of specified type (l h hh etc)
 		uint_least8_t type;				//TYPE_x
+		uint_least8_t conv;				//for TYPE_EXT, 0 for a PRNF_EXT() descriptor, otherwise 1+ the index of a registered conversion
+		uint_least8_t esc;				//ESC_x for string types
 	};
 
 	struct out_struct
@@ -420,6 +900,11 @@ AVR targets.
 		char* 	buf;
 		void* 	dst_fptr_vars;
 		void(*dst_fptr)(void*, char);
+		char*	blk;		//staging buffer for dst_blk_fptr
+		int		blk_size;	//PRNF_BLK_SIZE, or PRNF_TABLE_BLK_SIZE for blkprnf_table()
+		int		blk_len;
+		void(*dst_blk_fptr)(void*, const char*, size_t);
+		bool	json;		//output values as JSON (prnf_json() etc.)
 	};
 
 	struct eng_struct
@@ -439,6 +924,7 @@ AVR targets.
 		unsigned int ui;
 		prnf_float_t f;
 		char* str;
+		const void* ptr;
 		char c;
 	};
 
@@ -454,6 +940,8 @@ AVR targets.
 	#define vsnprnf_PX 		vsnprnf
 	#define fptrprnf_PX 	fptrprnf
 	#define vfptrprnf_PX 	vfptrprnf
+	#define blkprnf_PX 		blkprnf
+	#define vblkprnf_PX 	vblkprnf
 #else
 	#undef prnf_PX
 	#undef sprnf_PX
@@ -464,6 +952,8 @@ AVR targets.
 	#undef vsnprnf_PX
 	#undef fptrprnf_PX
 	#undef vfptrprnf_PX
+	#undef blkprnf_PX
+	#undef vblkprnf_PX
 	#define prnf_PX 		prnf_P
 	#define sprnf_PX 		sprnf_P
 	#define snprnf_PX 		snprnf_P
@@ -473,6 +963,8 @@ AVR targets.
 	#define vsnprnf_PX 		vsnprnf_P
 	#define fptrprnf_PX 	fptrprnf_P
 	#define vfptrprnf_PX 	vfptrprnf_P
+	#define blkprnf_PX 		blkprnf_P
+	#define vblkprnf_PX 	vblkprnf_P
 #endif
 
 //********************************************************************************************************
@@ -484,6 +976,37 @@ AVR targets.
 //********************************************************************************************************
 
 #ifdef FIRST_PASS
+	struct conv_struct
+	{
+		const char* name;
+		uint32_t hash;		// of the name, compared before the name
+		void(*fn)(struct prnf_out_struct* out, const void* ctx);
+	};
+
+//	Registered conversions for %p{name}
+	static struct conv_struct conv_tbl[PRNF_CONV_MAX];
+	static uint_least8_t conv_cnt = 0;
+
+//	Descriptors recently created by PRNF_EXT() in this thread, compared by address only
+	static PRNF_EXT_TLS const struct prnf_ext_struct* ext_recent[PRNF_EXT_RECENT];
+	static PRNF_EXT_TLS uint_least8_t ext_recent_next;
+
+#ifdef PRNF_ARENA_SIZE
+	struct arena_struct
+	{
+		size_t top;
+		size_t live;				// allocations not yet freed
+		size_t live_at_start;		// of the outermost print
+		uint_least8_t depth;		// of core_prnf() calls
+		char buf[PRNF_ARENA_SIZE] __attribute__((aligned(ARENA_ALIGN)));
+	};
+
+	static PRNF_ARENA_TLS struct arena_struct arena;
+	static size_t arena_high_water = 0;
+	static uint32_t arena_overflows = 0;
+	static uint32_t arena_held = 0;
+#endif
+
 #ifdef PRNF_SUPPORT_FLOAT
 	#ifdef LONG_IS_32
 		static prnf_float_t pow10_tbl[10] = {1E0F, 1E1F, 1E2F, 1E3F, 1E4F, 1E5F, 1E6F, 1E7F, 1E8F, 1E9F};
@@ -499,8 +1022,19 @@ AVR targets.
 
 #ifdef FIRST_PASS
 	static const char* parse_placeholder(struct placeholder_struct* placeholder, const char* fmtstr, bool is_pgm);
+	static void ext_free(char* str);
+	static const char* parse_conv(struct placeholder_struct* placeholder, const char* fmtstr, bool is_pgm);
+	static bool conv_name_is(const char* registered, const char* name, int len, bool is_pgm);
+	static uint32_t conv_hash(const char* name, int len, bool is_pgm);
+	static const char* parse_esc(struct placeholder_struct* placeholder, const char* fmtstr, bool is_pgm);
 	static void print_placeholder(struct out_struct* out_info, union varg_union varg, struct placeholder_struct* placeholder);
+	static void print_json(struct out_struct* out_info, union varg_union varg, struct placeholder_struct* placeholder);
+	static union varg_union int_varg(struct placeholder_struct* placeholder, prnf_long_t value);
+	static union varg_union field_varg(struct placeholder_struct* placeholder, const struct prnf_field_struct* field, const char* row);
+	static void table_parse_field(struct placeholder_struct* placeholder, const struct prnf_field_struct* field, uint_least8_t style);
+	static bool table_spec_suits(uint_least8_t field_type, const struct placeholder_struct* placeholder);
 	static int core_prnf(struct out_struct* out_info, const char* fmtstr, bool is_pgm, va_list va);
+	static void core_fmt(struct out_struct* out_info, const char* fmtstr, bool is_pgm, va_list va);
 
 #ifdef PRNF_COL_ALIGNMENT
 	static const char* print_col_alignment(struct out_struct* out_info, const char* fmtstr, bool is_pgm);
@@ -536,8 +1070,26 @@ AVR targets.
 
 	static void out_char(struct out_struct* out_info, char x);
 	static void out_terminate(struct out_struct* out_info);
+	static void out_blk_flush(struct out_struct* out_info, bool all);
+
+	static void out_varint(struct out_struct* out_info, uint64_t x);
+	static void out_zigzag(struct out_struct* out_info, int64_t x);
+	static void out_tok_str(struct out_struct* out_info, const char* str, bool is_pgm);
+	static void out_json_esc(void* vars, char x);
+	static void out_esc(struct out_struct* out_info, const char* str, int len, uint_least8_t esc, bool is_pgm);
+	static void out_esc_char(struct out_struct* out_info, char x, uint_least8_t esc);
+	static void out_run(struct out_struct* out_info, const char* str, int len, bool is_pgm);
+	static int esc_run_len(const char* str, int len, char a, char b, char c, bool is_pgm);
+	static void out_xxd(struct out_struct* out_info, const uint8_t* src, size_t len);
+	static void hex_encode(char* dst, const uint8_t* src, int len);
+	static int base64_encode(char* dst, const uint8_t* src, int len, bool url);
+	static int base32_encode(char* dst, const uint8_t* src, int len);
 
 	static void print_str(struct out_struct* out_info, struct placeholder_struct* placeholder, const char* str, bool is_pgm);
+	static void print_ext(struct out_struct* out_info, struct placeholder_struct* placeholder, const struct prnf_ext_struct* ext);
+	static bool is_ext(const struct prnf_ext_struct* ext);
+	static void out_tok_ext(struct out_struct* out_info, const struct prnf_ext_struct* ext);
+	static int tok_core(struct out_struct* out_info, uint32_t token, uint64_t types, va_list va);
 	static int prnf_strlen(const char* str, bool is_pgm, int max);
 	static int prnf_atoi(const char** fmtstr, bool is_pgm);
 
@@ -558,6 +1110,15 @@ void prnf_putch(void *ctx, char c)
 	(void)ctx;
 	(void)c;
 }
+
+#ifdef PRNF_PUTBLK
+	#pragma weak prnf_putblk
+void prnf_putblk(void* ctx, const char* blk, size_t len)
+{
+	while(len--)
+		prnf_putch(ctx, *blk++);
+}
+#endif
 #endif
 
 // On AVR platforms these _PX functions are compiled twice.
@@ -626,10 +1187,25 @@ int fptrprnf_PX(void(*out_fptr)(void*, char), void* out_vars, const char* fmtstr
 	return ret;
 }
 
+int blkprnf_PX(void(*blk_fptr)(void*, const char*, size_t), void* blk_vars, const char* fmtstr, ...)
+{
+	va_list va;
+	va_start(va, fmtstr);
+
+	const int ret = vblkprnf_PX(blk_fptr, blk_vars, fmtstr, va);
+
+	va_end(va);
+	return ret;
+}
+
 int vprnf_PX(const char* fmtstr, va_list va)
 {
+#ifdef PRNF_PUTBLK
+	return vblkprnf_PX(&prnf_putblk, NULL, fmtstr, va);
+#else
 	struct out_struct out_info = {.dst_fptr = &prnf_putch};
 	return core_prnf(&out_info, fmtstr, IS_SECOND_PASS, va);
+#endif
 }
 
 int vsprnf_PX(char* dst, const char* fmtstr, va_list va)
@@ -650,95 +1226,541 @@ int vfptrprnf_PX(void(*out_fptr)(void*, char), void* out_vars, const char* fmtst
 	return core_prnf(&out_info, fmtstr, IS_SECOND_PASS, va);
 }
 
-//********************************************************************************************************
-// Private functions
-//********************************************************************************************************
-
-// wrappers for PGM or non-PGM access
+int vblkprnf_PX(void(*blk_fptr)(void*, const char*, size_t), void* blk_vars, const char* fmtstr, va_list va)
+{
+	char blk[PRNF_BLK_SIZE];
+	struct out_struct out_info = {.dst_fptr_vars=blk_vars, .blk=blk, .blk_size=PRNF_BLK_SIZE, .dst_blk_fptr=blk_fptr};
+	return core_prnf(&out_info, fmtstr, IS_SECOND_PASS, va);
+}
 
 #ifdef FIRST_PASS
+void* prnf_arena_alloc(size_t size)
+{
+#ifdef PRNF_ARENA_SIZE
+	void* ptr;
 
-#ifdef __AVR__
-static char fmt_rd_either(const char* fmt, bool is_pgm)
+	size = (size + ARENA_ALIGN-1) & ~(ARENA_ALIGN-1);
+	if(size > PRNF_ARENA_SIZE - arena.top)
+	{
+		arena_overflows++;
+		return NULL;
+	};
+
+	ptr = &arena.buf[arena.top];
+	arena.top += size;
+	arena.live++;
+	if(arena.top > arena_high_water)
+		arena_high_water = arena.top;	// not synchronized, a simultaneous peak in another thread may be missed
+
+	return ptr;
+#else
+	(void)size;
+	return NULL;
+#endif
+}
+
+void prnf_ext_free(void* str)
 {
-	return is_pgm? 	pgm_read_byte(fmt):(*fmt);
+	ext_free(str);
 }
-#endif
 
-//Read from variable argument list (src) to varg union (dst)
-#define READ_VARG(dst, placeholder, src) 											\
-do																					\
-{																					\
-	if(placeholder.width_is_dynamic)												\
-	{																				\
-		placeholder.width = va_arg(va, int);										\
-		if(placeholder.width < 0)													\
-		{																			\
-			placeholder.width = -placeholder.width;									\
-			placeholder.flag_minus = true;											\
-		};																			\
-	};																				\
-																					\
-	if(placeholder.prec_is_dynamic)													\
-		placeholder.prec = va_arg(va, int);											\
-																					\
-	if(is_type_int(placeholder.type))												\
-	{																				\
-		if(placeholder.size_modifier == sizeof(prnf_ulong_t))						\
-			dst.prnf_ul = va_arg(src, prnf_ulong_t);								\
-		else if(placeholder.size_modifier == sizeof(long))							\
-		{																			\
-			dst.ul = va_arg(src, unsigned long);									\
-			if(is_type_unsigned(placeholder.type))									\
-				dst.prnf_ul = dst.ul;												\
-			else																	\
-				dst.prnf_l = dst.l;													\
-		}																			\
-		else																		\
-		{																			\
-			dst.ui = va_arg(src, unsigned int);										\
-			if(is_type_unsigned(placeholder.type))									\
-				dst.prnf_ul = dst.ui;												\
-			else																	\
-				dst.prnf_l = dst.i;													\
-		};																			\
-	}																				\
-	else if(placeholder.type == TYPE_FLOAT || placeholder.type == TYPE_ENG)			\
-		dst.f = (prnf_float_t)va_arg(src, double);									\
-																					\
-	else if(placeholder.type == TYPE_CHAR)											\
-		dst.c = (char)va_arg(src, int);												\
-																					\
-	else if(placeholder.type == TYPE_STR || placeholder.type == TYPE_PSTR)			\
-		dst.str = va_arg(src, char*);												\
-																					\
-	else if(placeholder.type == TYPE_NSTR)											\
-		dst.str = (char*)va_arg(src, int*);											\
-																					\
-}while(false)
+void prnf_arena_reset(void)
+{
+	#ifdef PRNF_ARENA_SIZE
+		PRNF_ASSERT(!arena.depth);	//not within a print
+		arena.top = 0;
+		arena.live = 0;
+	#endif
+}
 
-static int core_prnf(struct out_struct* out_info, const char* fmtstr, bool is_pgm, va_list va)
+struct prnf_arena_stats_struct prnf_arena_stats(void)
 {
-	struct placeholder_struct placeholder;
-	union varg_union varg;
+	struct prnf_arena_stats_struct stats = {0};
 
-	while(FMTRD(fmtstr))
-	{
-		// placeholder? %[flags][width][.precision][length]type
-		if(FMTRD(fmtstr) == '%')
-		{
-			fmtstr++;
-			if(FMTRD(fmtstr) == '%')
-			{
-				out_char(out_info, '%');
-				fmtstr++;
-			}
-			else
-			{
-				fmtstr = parse_placeholder(&placeholder, fmtstr, is_pgm);
-				READ_VARG(varg, placeholder, va);
-				print_placeholder(out_info, varg, &placeholder);
-			};
+	#ifdef PRNF_ARENA_SIZE
+		stats.size = PRNF_ARENA_SIZE;
+		stats.high_water = arena_high_water;
+		stats.overflows = arena_overflows;
+		stats.held = arena_held;
+	#endif
+
+	return stats;
+}
+
+int prnf_conv_register(const char* name, void(*fn)(struct prnf_out_struct* out, const void* ctx))
+{
+	int len = prnf_strlen(name, IS_NOT_PGM, INT_MAX);
+	uint32_t hash = conv_hash(name, len, IS_NOT_PGM);
+	uint_least8_t i = 0;
+
+	while(i < conv_cnt && !(conv_tbl[i].hash == hash && conv_name_is(conv_tbl[i].name, name, len, IS_NOT_PGM)))
+		i++;
+
+	if(i == PRNF_CONV_MAX)
+		return -1;
+
+	conv_tbl[i].name = name;
+	conv_tbl[i].hash = hash;
+	conv_tbl[i].fn = fn;
+	if(i == conv_cnt)
+		conv_cnt++;
+
+	return i;
+}
+
+void* prnf_ext_mark(const struct prnf_ext_struct* ext)
+{
+	ext_recent[ext_recent_next] = ext;
+	ext_recent_next = (ext_recent_next + 1) % PRNF_EXT_RECENT;
+	return (void*)ext;
+}
+
+int prnf_out(struct prnf_out_struct* out, const char* fmtstr, ...)
+{
+	va_list va;
+	va_start(va, fmtstr);
+
+	const int ret = vprnf_out(out, fmtstr, va);
+
+	va_end(va);
+	return ret;
+}
+
+// The prnf_out_struct given to an extension is the out_struct of the print in progress
+int vprnf_out(struct prnf_out_struct* out, const char* fmtstr, va_list va)
+{
+	struct out_struct* out_info = (struct out_struct*)out;
+	int start = out_info->char_cnt;
+
+	core_fmt(out_info, fmtstr, IS_NOT_PGM, va);
+
+	return out_info->char_cnt - start;
+}
+
+void prnf_out_blk(struct prnf_out_struct* out, const char* blk, size_t len)
+{
+	struct out_struct* out_info = (struct out_struct*)out;
+
+	while(len--)
+		out_char(out_info, *blk++);
+}
+
+// Hex or separated hex is converted HEX_CHUNK bytes at a time, and output in bulk
+void prnf_hex_out(struct prnf_out_struct* out, const void* ctx)
+{
+	const struct prnf_hex_struct* hex = ctx;
+	struct out_struct* out_info = (struct out_struct*)out;
+	const uint8_t* src = hex->ptr;
+	size_t len = hex->len;
+	char pairs[HEX_CHUNK*2];
+	char txt[HEX_CHUNK*3];
+	int cnt;
+	int i;
+
+	if(hex->xxd)
+	{
+		out_xxd(out_info, src, len);
+		return;
+	};
+
+	while(len)
+	{
+		cnt = len < HEX_CHUNK? len:HEX_CHUNK;
+		if(!hex->sep)
+		{
+			hex_encode(txt, src, cnt);
+			out_run(out_info, txt, cnt*2, IS_NOT_PGM);
+		}
+		else
+		{
+			hex_encode(pairs, src, cnt);
+			for(i=0; i<cnt; i++)
+			{
+				txt[i*3] = hex->sep;
+				txt[i*3+1] = pairs[i*2];
+				txt[i*3+2] = pairs[i*2+1];
+			};
+			// no separator before the first byte
+			if(src == hex->ptr)
+				out_run(out_info, &txt[1], cnt*3-1, IS_NOT_PGM);
+			else
+				out_run(out_info, txt, cnt*3, IS_NOT_PGM);
+		};
+		src += cnt;
+		len -= cnt;
+	};
+}
+
+// Encoded a chunk at a time, and output in bulk. Only the last chunk may have a partial group, which is padded.
+void prnf_enc_out(struct prnf_out_struct* out, const void* ctx)
+{
+	const struct prnf_enc_struct* enc = ctx;
+	struct out_struct* out_info = (struct out_struct*)out;
+	const uint8_t* src = enc->ptr;
+	size_t len = enc->len;
+	size_t chunk = (enc->enc == PRNF_ENC_BASE32)? BASE32_CHUNK:BASE64_CHUNK;
+	char txt[BASE32_CHUNK/5*8 > BASE64_CHUNK/3*4 ? BASE32_CHUNK/5*8 : BASE64_CHUNK/3*4];
+	int txt_len;
+	int cnt;
+
+	while(len)
+	{
+		cnt = len < chunk? len:chunk;
+		if(enc->enc == PRNF_ENC_BASE32)
+			txt_len = base32_encode(txt, src, cnt);
+		else
+			txt_len = base64_encode(txt, src, cnt, enc->enc == PRNF_ENC_BASE64URL);
+		out_run(out_info, txt, txt_len, IS_NOT_PGM);
+		src += cnt;
+		len -= cnt;
+	};
+}
+
+// The spec is parsed once, then each element is converted to the type given by the placeholder's length (see int_varg())
+void prnf_array_out(struct prnf_out_struct* out, const void* ctx)
+{
+	const struct prnf_array_struct* arr = ctx;
+	struct out_struct* out_info = (struct out_struct*)out;
+	struct placeholder_struct placeholder;
+	union varg_union varg;
+	prnf_long_t value;
+	const char* sep;
+	size_t i;
+
+	PRNF_ASSERT(arr->spec[0] == '%');
+	parse_placeholder(&placeholder, arr->spec+1, IS_NOT_PGM);
+	PRNF_ASSERT(!placeholder.width_is_dynamic && !placeholder.prec_is_dynamic);	//not supported
+	PRNF_ASSERT((arr->type == PRNF_ARRAY_FLT) == (placeholder.type == TYPE_FLOAT || placeholder.type == TYPE_ENG));
+
+	for(i=0; i<arr->count; i++)
+	{
+		if(i && arr->sep)
+		{
+			for(sep = arr->sep; *sep; sep++)
+				out_char(out_info, *sep);
+		};
+
+		if(arr->type == PRNF_ARRAY_FLT)
+			varg.f = ((const float*)arr->ptr)[i];
+		else
+		{
+			if(arr->type == PRNF_ARRAY_I16)
+				value = ((const int16_t*)arr->ptr)[i];
+			else
+				value = ((const int32_t*)arr->ptr)[i];
+			varg = int_varg(&placeholder, value);
+		};
+
+		print_placeholder(out_info, varg, &placeholder);
+	};
+}
+
+// The fields are parsed once, then each row is printed with the parsed placeholders and the separator
+size_t blkprnf_table(void(*blk_fptr)(void*, const char*, size_t), void* blk_vars, const struct prnf_table_struct* table, const void* rows, size_t row_size, size_t row_cnt)
+{
+	char blk[PRNF_TABLE_BLK_SIZE];
+	struct out_struct out_info = {.dst_fptr_vars=blk_vars, .blk=blk, .blk_size=PRNF_TABLE_BLK_SIZE, .dst_blk_fptr=blk_fptr};
+	struct placeholder_struct placeholders[PRNF_TABLE_FIELDS_MAX];
+	struct placeholder_struct heading;
+	const char* row = rows;
+	const char sep = (table->style == PRNF_TABLE_CSV)? ',':' ';
+	size_t total = 0;
+	int field_cnt = table->field_cnt;
+	int i;
+
+	PRNF_ASSERT(field_cnt <= PRNF_TABLE_FIELDS_MAX);
+	if(field_cnt > PRNF_TABLE_FIELDS_MAX)
+		field_cnt = PRNF_TABLE_FIELDS_MAX;
+
+	for(i=0; i<field_cnt; i++)
+		table_parse_field(&placeholders[i], &table->fields[i], table->style);
+
+	if(table->header)
+	{
+		for(i=0; i<field_cnt; i++)
+		{
+			if(i)
+				out_char(&out_info, sep);
+			heading = (struct placeholder_struct){.width=placeholders[i].width, .flag_minus=placeholders[i].flag_minus, .size_modifier=sizeof(int), .type=TYPE_STR};
+			if(table->style == PRNF_TABLE_CSV)
+				heading.esc = ESC_CSV;
+			print_str(&out_info, &heading, table->fields[i].name, IS_NOT_PGM);
+		};
+		out_char(&out_info, '\n');
+	};
+
+	// count per row, so that a large table does not overflow char_cnt
+	while(row_cnt--)
+	{
+		total += out_info.char_cnt;
+		out_info.char_cnt = 0;
+		for(i=0; i<field_cnt; i++)
+		{
+			if(i)
+				out_char(&out_info, sep);
+			print_placeholder(&out_info, field_varg(&placeholders[i], &table->fields[i], row), &placeholders[i]);
+		};
+		out_char(&out_info, '\n');
+		row += row_size;
+	};
+
+	out_terminate(&out_info);
+	return total + out_info.char_cnt;
+}
+
+int prnf_json(const char* fmtstr, ...)
+{
+	va_list va;
+	va_start(va, fmtstr);
+
+	const int ret = vprnf_json(fmtstr, va);
+
+	va_end(va);
+	return ret;
+}
+
+int snprnf_json(char* dst, size_t dst_size, const char* fmtstr, ...)
+{
+	va_list va;
+	va_start(va, fmtstr);
+
+	const int ret = vsnprnf_json(dst, dst_size, fmtstr, va);
+
+	va_end(va);
+	return ret;
+}
+
+int fptrprnf_json(void(*out_fptr)(void*, char), void* out_vars, const char* fmtstr, ...)
+{
+	va_list va;
+	va_start(va, fmtstr);
+
+	const int ret = vfptrprnf_json(out_fptr, out_vars, fmtstr, va);
+
+	va_end(va);
+	return ret;
+}
+
+int blkprnf_json(void(*blk_fptr)(void*, const char*, size_t), void* blk_vars, const char* fmtstr, ...)
+{
+	va_list va;
+	va_start(va, fmtstr);
+
+	const int ret = vblkprnf_json(blk_fptr, blk_vars, fmtstr, va);
+
+	va_end(va);
+	return ret;
+}
+
+int vprnf_json(const char* fmtstr, va_list va)
+{
+#ifdef PRNF_PUTBLK
+	return vblkprnf_json(&prnf_putblk, NULL, fmtstr, va);
+#else
+	struct out_struct out_info = {.dst_fptr = &prnf_putch, .json=true};
+	return core_prnf(&out_info, fmtstr, IS_NOT_PGM, va);
+#endif
+}
+
+int vsnprnf_json(char* dst, size_t dst_size, const char* fmtstr, va_list va)
+{
+	struct out_struct out_info = {.size_limit=dst_size, .buf=dst, .json=true};
+	return core_prnf(&out_info, fmtstr, IS_NOT_PGM, va);
+}
+
+int vfptrprnf_json(void(*out_fptr)(void*, char), void* out_vars, const char* fmtstr, va_list va)
+{
+	struct out_struct out_info = {.dst_fptr_vars=out_vars, .dst_fptr=out_fptr, .json=true};
+	return core_prnf(&out_info, fmtstr, IS_NOT_PGM, va);
+}
+
+int vblkprnf_json(void(*blk_fptr)(void*, const char*, size_t), void* blk_vars, const char* fmtstr, va_list va)
+{
+	char blk[PRNF_BLK_SIZE];
+	struct out_struct out_info = {.dst_fptr_vars=blk_vars, .blk=blk, .blk_size=PRNF_BLK_SIZE, .dst_blk_fptr=blk_fptr, .json=true};
+	return core_prnf(&out_info, fmtstr, IS_NOT_PGM, va);
+}
+
+int prnf_tok(uint32_t token, uint64_t types, ...)
+{
+	va_list va;
+	va_start(va, types);
+
+#ifdef PRNF_PUTBLK
+	const int ret = vblkprnf_tok(&prnf_putblk, NULL, token, types, va);
+#else
+	const int ret = vfptrprnf_tok(&prnf_putch, NULL, token, types, va);
+#endif
+
+	va_end(va);
+	return ret;
+}
+
+int fptrprnf_tok(void(*out_fptr)(void*, char), void* out_vars, uint32_t token, uint64_t types, ...)
+{
+	va_list va;
+	va_start(va, types);
+
+	const int ret = vfptrprnf_tok(out_fptr, out_vars, token, types, va);
+
+	va_end(va);
+	return ret;
+}
+
+int vfptrprnf_tok(void(*out_fptr)(void*, char), void* out_vars, uint32_t token, uint64_t types, va_list va)
+{
+	struct out_struct out_info = {.dst_fptr_vars=out_vars, .dst_fptr=out_fptr};
+	return tok_core(&out_info, token, types, va);
+}
+
+int vblkprnf_tok(void(*blk_fptr)(void*, const char*, size_t), void* blk_vars, uint32_t token, uint64_t types, va_list va)
+{
+	char blk[PRNF_BLK_SIZE];
+	struct out_struct out_info = {.dst_fptr_vars=blk_vars, .blk=blk, .blk_size=PRNF_BLK_SIZE, .dst_blk_fptr=blk_fptr};
+	return tok_core(&out_info, token, types, va);
+}
+#endif
+
+//********************************************************************************************************
+// Private functions
+//********************************************************************************************************
+
+// wrappers for PGM or non-PGM access
+
+#ifdef FIRST_PASS
+
+#ifdef __AVR__
+static char fmt_rd_either(const char* fmt, bool is_pgm)
+{
+	return is_pgm? 	pgm_read_byte(fmt):(*fmt);
+}
+#endif
+
+//Read from variable argument list (src) to varg union (dst)
+#define READ_VARG(dst, placeholder, src) 											\
+do																					\
+{																					\
+	if(placeholder.width_is_dynamic)												\
+	{																				\
+		placeholder.width = va_arg(va, int);										\
+		if(placeholder.width < 0)													\
+		{																			\
+			placeholder.width = -placeholder.width;									\
+			placeholder.flag_minus = true;											\
+		};																			\
+	};																				\
+																					\
+	if(placeholder.prec_is_dynamic)													\
+		placeholder.prec = va_arg(va, int);											\
+																					\
+	if(is_type_int(placeholder.type))												\
+	{																				\
+		if(placeholder.size_modifier == sizeof(prnf_ulong_t))						\
+			dst.prnf_ul = va_arg(src, prnf_ulong_t);								\
+		else if(placeholder.size_modifier == sizeof(long))							\
+		{																			\
+			dst.ul = va_arg(src, unsigned long);									\
+			if(is_type_unsigned(placeholder.type))									\
+				dst.prnf_ul = dst.ul;												\
+			else																	\
+				dst.prnf_l = dst.l;													\
+		}																			\
+		else																		\
+		{																			\
+			dst.ui = va_arg(src, unsigned int);										\
+			if(is_type_unsigned(placeholder.type))									\
+				dst.prnf_ul = dst.ui;												\
+			else																	\
+				dst.prnf_l = dst.i;													\
+		};																			\
+	}																				\
+	else if(placeholder.type == TYPE_FLOAT || placeholder.type == TYPE_ENG)			\
+		dst.f = (prnf_float_t)va_arg(src, double);									\
+																					\
+	else if(placeholder.type == TYPE_CHAR)											\
+		dst.c = (char)va_arg(src, int);												\
+																					\
+	else if(placeholder.type == TYPE_STR || placeholder.type == TYPE_PSTR)			\
+		dst.str = va_arg(src, char*);												\
+																					\
+	else if(placeholder.type == TYPE_NSTR)											\
+		dst.str = (char*)va_arg(src, int*);											\
+																					\
+	else if(placeholder.type == TYPE_EXT)											\
+		dst.ptr = va_arg(src, void*);												\
+																					\
+}while(false)
+
+static int core_prnf(struct out_struct* out_info, const char* fmtstr, bool is_pgm, va_list va)
+{
+	#ifdef PRNF_ARENA_SIZE
+		if(!arena.depth++)
+			arena.live_at_start = arena.live;
+	#endif
+
+	core_fmt(out_info, fmtstr, is_pgm, va);
+
+	// Terminate
+	out_terminate(out_info);
+
+	// outermost print finished, reset the arena if all of it's strings have been printed
+	// held if it printed strings but others remain, an extension printing into it's own string (live throughout) is not counted
+	#ifdef PRNF_ARENA_SIZE
+		if(!--arena.depth)
+		{
+			if(!arena.live)
+				arena.top = 0;
+			else if(arena.live < arena.live_at_start)
+				arena_held++;
+		};
+	#endif
+
+	return out_info->char_cnt;
+}
+
+// free a %n string, which may be in the arena
+static void ext_free(char* str)
+{
+	#ifdef PRNF_ARENA_SIZE
+		if((uintptr_t)str - (uintptr_t)arena.buf < PRNF_ARENA_SIZE)
+		{
+			if(!--arena.live && !arena.depth)
+				arena.top = 0;
+			return;
+		};
+	#endif
+
+	#ifdef prnf_free
+		prnf_free(str);
+	#else
+		(void)str;
+		PRNF_ASSERT(false);	//extensions not enabled
+	#endif
+}
+
+// format to the output, without terminating it (callback extensions add to the output of the print in progress)
+static void core_fmt(struct out_struct* out_info, const char* fmtstr, bool is_pgm, va_list va)
+{
+	struct placeholder_struct placeholder;
+	union varg_union varg;
+
+	while(FMTRD(fmtstr))
+	{
+		// placeholder? %[flags][width][.precision][length]type
+		if(FMTRD(fmtstr) == '%')
+		{
+			fmtstr++;
+			if(FMTRD(fmtstr) == '%')
+			{
+				out_char(out_info, '%');
+				fmtstr++;
+			}
+			else
+			{
+				fmtstr = parse_placeholder(&placeholder, fmtstr, is_pgm);
+				READ_VARG(varg, placeholder, va);
+				print_placeholder(out_info, varg, &placeholder);
+			};
 		}
 		#ifdef PRNF_COL_ALIGNMENT
 		// colum alignment?
@@ -754,11 +1776,6 @@ static int core_prnf(struct out_struct* out_info, const char* fmtstr, bool is_pg
 			fmtstr++;
 		};
 	};
-
-	// Terminate
-	out_terminate(out_info);
-
-	return out_info->char_cnt;
 }
 
 // parse textual placeholder information into a placeholder_struct
@@ -889,18 +1906,27 @@ static const char* parse_placeholder(struct placeholder_struct* dst, const char*
 		case 'S' :
 		#ifdef __AVR__
 			placeholder.type = TYPE_PSTR;
+			fmtstr = parse_esc(&placeholder, fmtstr, is_pgm);
 			break;
 		#endif
 		case 's' :
 			placeholder.type = TYPE_STR;
+			fmtstr = parse_esc(&placeholder, fmtstr, is_pgm);
 			break;
 
 		#ifdef prnf_free
 		case 'n' :
 			placeholder.type = TYPE_NSTR;
+			fmtstr = parse_esc(&placeholder, fmtstr, is_pgm);
 			break;
 		#endif
 
+		case 'p' :
+			placeholder.type = TYPE_EXT;
+			if(FMTRD(fmtstr+1) == '{')
+				fmtstr = parse_conv(&placeholder, fmtstr+1, is_pgm);
+			break;
+
 		case 'c' :
 			placeholder.type = TYPE_CHAR;
 			break;
@@ -911,12 +1937,99 @@ static const char* parse_placeholder(struct placeholder_struct* dst, const char*
 	};
 	fmtstr++;
 
-	//ignore zero flag for int types when precision is specified
-	if(placeholder.prec_specified && is_type_int(placeholder.type))
-		placeholder.flag_zero = false;
+	//ignore zero flag for int types when precision is specified
+	if(placeholder.prec_specified && is_type_int(placeholder.type))
+		placeholder.flag_zero = false;
+
+	*dst = placeholder;
+	return fmtstr;
+}
+
+// resolve the {name} following %p to it's index in the conversion registry, returns a pointer to the closing }
+// the name is hashed as it is scanned, so only a matching hash is compared by name
+static const char* parse_conv(struct placeholder_struct* placeholder, const char* fmtstr, bool is_pgm)
+{
+	const char* name = fmtstr+1;
+	const char* end = name;
+	uint32_t hash = CONV_HASH_INIT;
+	uint_least8_t i;
+
+	while(FMTRD(end) && FMTRD(end) != '}')
+	{
+		hash = (hash ^ (uint8_t)FMTRD(end)) * CONV_HASH_PRIME;
+		end++;
+	};
+
+	placeholder->conv = CONV_UNKNOWN;
+	for(i=0; i<conv_cnt; i++)
+	{
+		if(conv_tbl[i].hash == hash && conv_name_is(conv_tbl[i].name, name, end-name, is_pgm))
+		{
+			placeholder->conv = i+1;
+			break;
+		};
+	};
+	PRNF_ASSERT(placeholder->conv != CONV_UNKNOWN);	//conversion not registered
+
+	// unterminated, stop at the end of the format string
+	if(!FMTRD(end))
+		end--;
+
+	return end;
+}
+
+// escape named by {json} {csv} or {c} following a string type, returns a pointer to the closing }
+// other text following the type is not part of the placeholder, and fmtstr (the type) is returned
+static const char* parse_esc(struct placeholder_struct* placeholder, const char* fmtstr, bool is_pgm)
+{
+	static const char* const names[] = {[ESC_JSON]="json", [ESC_CSV]="csv", [ESC_C]="c"};
+	const char* name = fmtstr+2;
+	const char* end = name;
+	uint_least8_t i;
+
+	if(FMTRD(fmtstr+1) != '{')
+		return fmtstr;
+
+	while(FMTRD(end) && FMTRD(end) != '}' && end-name < 4)
+		end++;
+
+	if(FMTRD(end) == '}')
+	{
+		for(i=ESC_JSON; i<=ESC_C; i++)
+		{
+			if(conv_name_is(names[i], name, end-name, is_pgm))
+			{
+				placeholder->esc = i;
+				return end;
+			};
+		};
+	};
+
+	return fmtstr;
+}
+
+// compare a registered name with len characters of the format string
+static bool conv_name_is(const char* registered, const char* name, int len, bool is_pgm)
+{
+	(void)is_pgm;
+	int i = 0;
+
+	while(i < len && registered[i] == FMTRD(name+i))
+		i++;
+
+	return i == len && !registered[i];
+}
 
-	*dst = placeholder;
-	return fmtstr;
+// 32 bit FNV-1a of len characters of a name
+static uint32_t conv_hash(const char* name, int len, bool is_pgm)
+{
+	(void)is_pgm;
+	uint32_t hash = CONV_HASH_INIT;
+
+	while(len--)
+		hash = (hash ^ (uint8_t)FMTRD(name++)) * CONV_HASH_PRIME;
+
+	return hash;
 }
 
 static void print_placeholder(struct out_struct* out_info, union varg_union varg, struct placeholder_struct* placeholder)
@@ -924,8 +2037,12 @@ static void print_placeholder(struct out_struct* out_info, union varg_union varg
 	#ifdef PRNF_SUPPORT_FLOAT
 		struct eng_struct eng;
 	#endif
+	struct prnf_ext_struct ext;
 
-	if(placeholder->type == TYPE_INT || placeholder->type == TYPE_UINT || placeholder->type == TYPE_HEX)
+	if(out_info->json && placeholder->esc != ESC_JSON && placeholder->type != TYPE_INT && placeholder->type != TYPE_UINT)
+		print_json(out_info, varg, placeholder);
+
+	else if(placeholder->type == TYPE_INT || placeholder->type == TYPE_UINT || placeholder->type == TYPE_HEX)
 		print_hex_dec(out_info, placeholder, varg.prnf_l);
 	else if(placeholder->type == TYPE_BIN)
 		print_bin(out_info, placeholder, varg.prnf_ul);
@@ -953,9 +2070,197 @@ static void print_placeholder(struct out_struct* out_info, union varg_union varg
 	else if(placeholder->type == TYPE_NSTR)
 	{
 		print_str(out_info, placeholder, varg.str, IS_NOT_PGM);
-		prnf_free(varg.str);
+		ext_free(varg.str);
+	}
+	#endif
+	else if(placeholder->type == TYPE_EXT)
+	{
+		if(!placeholder->conv)
+		{
+			if(is_ext(varg.ptr))
+				print_ext(out_info, placeholder, varg.ptr);
+		}
+		else if(placeholder->conv != CONV_UNKNOWN && varg.ptr)
+		{
+			ext.fn = conv_tbl[placeholder->conv-1].fn;
+			ext.ctx = varg.ptr;
+			print_ext(out_info, placeholder, &ext);
+		};
 	};
+}
+
+// JSON value of a non-integer placeholder
+// Strings are printed with ESC_JSON, other values are printed as usual to an output which escapes them into the output of the print in progress
+static void print_json(struct out_struct* out_info, union varg_union varg, struct placeholder_struct* placeholder)
+{
+	struct out_struct esc = {.dst_fptr_vars=out_info, .dst_fptr=out_json_esc};
+	struct placeholder_struct str_placeholder;
+	const char* null_str = "null";
+	bool is_null;
+
+	#ifdef PRNF_SUPPORT_FLOAT
+	if(placeholder->type == TYPE_FLOAT)
+	{
+		if(!determine_float_msg(placeholder, varg.f))
+		{
+			print_float(out_info, placeholder, varg.f, NO_PREFIX);
+			return;
+		};
+		is_null = true;
+	}
+	else
 	#endif
+	if(placeholder->type == TYPE_STR || placeholder->type == TYPE_PSTR || placeholder->type == TYPE_NSTR)
+		is_null = !varg.str;
+	else if(placeholder->type == TYPE_EXT)
+		is_null = !varg.ptr || placeholder->conv == CONV_UNKNOWN;
+	else
+		is_null = false;
+
+	if(is_null)
+	{
+		if(placeholder->type == TYPE_NSTR)
+			ext_free(varg.str);
+		while(*null_str)
+			out_char(out_info, *null_str++);
+	}
+	else if(placeholder->type == TYPE_STR || placeholder->type == TYPE_PSTR || placeholder->type == TYPE_NSTR)
+	{
+		str_placeholder = *placeholder;
+		str_placeholder.esc = ESC_JSON;
+		out_char(out_info, '"');
+		print_placeholder(out_info, varg, &str_placeholder);
+		out_char(out_info, '"');
+	}
+	else
+	{
+		out_char(out_info, '"');
+		#ifdef PRNF_COL_ALIGNMENT
+			esc.col = out_info->col;
+		#endif
+		print_placeholder(&esc, varg, placeholder);
+		out_char(out_info, '"');
+	};
+}
+
+// integer value to a varg, as if it were read from the argument list for the placeholder
+// unsigned types take the value at the size of their length modifier (ie. %hX of -1 is FFFF)
+static union varg_union int_varg(struct placeholder_struct* placeholder, prnf_long_t value)
+{
+	union varg_union varg;
+
+	if(!is_type_unsigned(placeholder->type))
+		varg.prnf_l = value;
+	else if(placeholder->size_modifier == sizeof(prnf_ulong_t))
+		varg.prnf_ul = (prnf_ulong_t)value;
+	else if(placeholder->size_modifier == sizeof(long))
+		varg.prnf_ul = (unsigned long)value;
+	else if(placeholder->size_modifier == sizeof(int))
+		varg.prnf_ul = (unsigned int)value;
+	else if(placeholder->size_modifier == sizeof(short))
+		varg.prnf_ul = (unsigned short)value;
+	else
+		varg.prnf_ul = (unsigned char)value;
+
+	return varg;
+}
+
+// parse the placeholder for a table field, or the default for it's type if there is none or it does not suit the type
+// text columns are made at least as wide as the field name, CSV strings are escaped as CSV fields
+static void table_parse_field(struct placeholder_struct* placeholder, const struct prnf_field_struct* field, uint_least8_t style)
+{
+	const char* spec = field->spec;
+	int name_len;
+
+	if(spec && spec[0] == '%')
+		parse_placeholder(placeholder, spec+1, IS_NOT_PGM);
+
+	if(spec && (spec[0] != '%' || !table_spec_suits(field->type, placeholder)))
+	{
+		PRNF_WARN(true);	//spec does not suit the field type
+		spec = NULL;
+	};
+
+	if(!spec)
+	{
+		if(field->type == PRNF_FIELD_STR || field->type == PRNF_FIELD_TEXT)
+			spec = "%s";
+		else if(field->type == PRNF_FIELD_FLOAT || field->type == PRNF_FIELD_DOUBLE)
+			spec = "%f";
+		#ifdef PRNF_SUPPORT_LONG_LONG
+		else if(field->type == PRNF_FIELD_I64)
+			spec = "%lli";
+		else if(field->type == PRNF_FIELD_U64)
+			spec = "%llu";
+		#endif
+		else if(field->type & 1)
+			spec = "%u";
+		else
+			spec = "%i";
+		parse_placeholder(placeholder, spec+1, IS_NOT_PGM);
+	};
+
+	if(style == PRNF_TABLE_TEXT)
+	{
+		name_len = prnf_strlen(field->name, IS_NOT_PGM, INT_MAX);
+		if(placeholder->width < name_len)
+			placeholder->width = name_len;
+	}
+	else if(!placeholder->esc)
+		placeholder->esc = ESC_CSV;
+}
+
+// true if the placeholder parsed from a field's spec can print the field's type, and takes no other arguments
+static bool table_spec_suits(uint_least8_t field_type, const struct placeholder_struct* placeholder)
+{
+	if(placeholder->width_is_dynamic || placeholder->prec_is_dynamic)
+		return false;
+
+	if(field_type == PRNF_FIELD_STR || field_type == PRNF_FIELD_TEXT)
+		return placeholder->type == TYPE_STR;
+
+	if(field_type == PRNF_FIELD_FLOAT || field_type == PRNF_FIELD_DOUBLE)
+		return placeholder->type == TYPE_FLOAT || placeholder->type == TYPE_ENG;
+
+	return is_type_int(placeholder->type);
+}
+
+// value of a field in a row, for it's parsed placeholder
+static union varg_union field_varg(struct placeholder_struct* placeholder, const struct prnf_field_struct* field, const char* row)
+{
+	const char* member = row + field->offset;
+	union varg_union varg;
+	prnf_long_t value = 0;
+
+	switch(field->type)
+	{
+		case PRNF_FIELD_I8:		value = *(const int8_t*)member;		break;
+		case PRNF_FIELD_U8:		value = *(const uint8_t*)member;	break;
+		case PRNF_FIELD_I16:	value = *(const int16_t*)member;	break;
+		case PRNF_FIELD_U16:	value = *(const uint16_t*)member;	break;
+		case PRNF_FIELD_I32:	value = *(const int32_t*)member;	break;
+		case PRNF_FIELD_U32:	value = *(const uint32_t*)member;	break;
+		case PRNF_FIELD_I64:	value = *(const int64_t*)member;	break;
+		case PRNF_FIELD_U64:	value = *(const uint64_t*)member;	break;
+
+		case PRNF_FIELD_FLOAT:
+			varg.f = *(const float*)member;
+			return varg;
+
+		case PRNF_FIELD_DOUBLE:
+			varg.f = (prnf_float_t)*(const double*)member;
+			return varg;
+
+		case PRNF_FIELD_STR:
+			varg.str = *(char* const*)member;
+			return varg;
+
+		case PRNF_FIELD_TEXT:
+			varg.str = (char*)member;
+			return varg;
+	};
+
+	return int_varg(placeholder, value);
 }
 
 //Handles both signed and unsigned integers, and hex 
@@ -1223,22 +2528,67 @@ static void print_str(struct out_struct* out_info, struct placeholder_struct* pl
 {
 	int	source_len;
 	int cnt;
+	bool quote = false;
 
 	source_len = prnf_strlen(str, is_pgm, INT_MAX);
 
 	if(placeholder->prec_specified && placeholder->prec < source_len && !is_centered_string(placeholder))
 		source_len = placeholder->prec;
 
+	// a CSV field is quoted if it contains a comma, quote or control character, padding is part of the field (inside the quotes)
+	if(placeholder->esc == ESC_CSV)
+		quote = esc_run_len(str, source_len, '"', ',', ',', is_pgm) < source_len;
+
+	if(quote)
+		out_char(out_info, '"');
+
 	prepad(out_info, placeholder, source_len);
 
-	cnt = source_len;
-	while(cnt--)
+	if(placeholder->esc)
+		out_esc(out_info, str, source_len, placeholder->esc, is_pgm);
+	else
 	{
-		out_char(out_info, FMTRD(str));
-		str++;
+		cnt = source_len;
+		while(cnt--)
+		{
+			out_char(out_info, FMTRD(str));
+			str++;
+		};
 	};
 
 	postpad(out_info, placeholder, source_len);
+
+	if(quote)
+		out_char(out_info, '"');
+}
+
+// callback extension, if a width is given the output is first measured by calling fn() with an output which only counts
+static void print_ext(struct out_struct* out_info, struct placeholder_struct* placeholder, const struct prnf_ext_struct* ext)
+{
+	struct out_struct counter = {0};
+
+	if(placeholder->width)
+	{
+		#ifdef PRNF_COL_ALIGNMENT
+			counter.col = out_info->col;
+		#endif
+		ext->fn((struct prnf_out_struct*)&counter, ext->ctx);
+	};
+
+	prepad(out_info, placeholder, counter.char_cnt);
+	ext->fn((struct prnf_out_struct*)out_info, ext->ctx);
+	postpad(out_info, placeholder, counter.char_cnt);
+}
+
+// a %p argument is a descriptor if PRNF_EXT() recently created it in this thread, the argument is not dereferenced
+static bool is_ext(const struct prnf_ext_struct* ext)
+{
+	uint_least8_t i = 0;
+
+	while(ext && i < PRNF_EXT_RECENT && ext != ext_recent[i])
+		i++;
+
+	return ext && i < PRNF_EXT_RECENT;
 }
 
 #ifdef PRNF_COL_ALIGNMENT
@@ -1499,7 +2849,7 @@ static uint_least8_t ulong2asc_revhex(char* buf, prnf_ulong_t il)
 
 // Per-character output processing
 // Counts output characters (regardless of truncation)
-// Calls function pointer to destinations character output OR writes to buffer
+// Calls function pointer to destinations character output OR writes to buffer OR stages output for a block handler
 // Truncates buffer output
 // Detects line endings and tracks colum (1st column is 0)
 static void out_char(struct out_struct* out_info, char x)
@@ -1507,6 +2857,13 @@ static void out_char(struct out_struct* out_info, char x)
 	if(out_info->buf && out_info->char_cnt+1 < out_info->size_limit)
 		*(out_info->buf++) = x;
 
+	else if(out_info->blk)
+	{
+		out_info->blk[out_info->blk_len++] = x;
+		if(out_info->blk_len == out_info->blk_size)
+			out_blk_flush(out_info, false);
+	}
+
 	else if(out_info->dst_fptr)
 		out_info->dst_fptr(out_info->dst_fptr_vars, x);
 
@@ -1525,6 +2882,466 @@ static void out_terminate(struct out_struct* out_info)
 {
 	if(out_info->buf && out_info->size_limit)
 		*(out_info->buf) = 0;
+
+	if(out_info->blk)
+		out_blk_flush(out_info, true);
+}
+
+// pass staged output to the block handler
+// unless all output is required, stop after the last line ending so that lines are not split across blocks
+static void out_blk_flush(struct out_struct* out_info, bool all)
+{
+	int len = out_info->blk_len;
+	int i;
+
+	if(!all)
+	{
+		while(len && out_info->blk[len-1] != '\n')
+			len--;
+		if(!len)
+			len = out_info->blk_len;	//line longer than the buffer
+	};
+
+	if(len && out_info->dst_blk_fptr)
+		out_info->dst_blk_fptr(out_info->dst_fptr_vars, out_info->blk, len);
+
+	out_info->blk_len -= len;
+	for(i=0; i<out_info->blk_len; i++)
+		out_info->blk[i] = out_info->blk[len+i];
+}
+
+// LEB128 unsigned varint, for tokenized output
+static void out_varint(struct out_struct* out_info, uint64_t x)
+{
+	while(x > 0x7F)
+	{
+		out_char(out_info, (char)(0x80 | (x & 0x7F)));
+		x >>= 7;
+	};
+	out_char(out_info, (char)x);
+}
+
+// zig-zag encoded signed varint, for tokenized output
+static void out_zigzag(struct out_struct* out_info, int64_t x)
+{
+	out_varint(out_info, ((uint64_t)x << 1) ^ (uint64_t)(x >> 63));
+}
+
+// length prefixed string, for tokenized output. NULL is output as an empty string.
+static void out_tok_str(struct out_struct* out_info, const char* str, bool is_pgm)
+{
+	(void)is_pgm;
+	int len = prnf_strlen(str, is_pgm, INT_MAX);
+
+	out_varint(out_info, len);
+	while(len--)
+		out_char(out_info, FMTRD(str++));
+}
+
+// character handler for JSON string values, vars is the out_struct of the print in progress
+static void out_json_esc(void* vars, char x)
+{
+	out_esc_char(vars, x, ESC_JSON);
+}
+
+// output len characters of str escaped for JSON, CSV or C (the quotes of a CSV field are added by print_str())
+// runs of characters which need no escaping are found by esc_run_len(), and output in bulk
+static void out_esc(struct out_struct* out_info, const char* str, int len, uint_least8_t esc, bool is_pgm)
+{
+	static const char special[][3] = {[ESC_JSON]={'"', '\\', '\\'}, [ESC_CSV]={'"', '"', '"'}, [ESC_C]={'"', '\\', 0x7F}};
+	int run;
+
+	while(len)
+	{
+		run = esc_run_len(str, len, special[esc][0], special[esc][1], special[esc][2], is_pgm);
+		out_run(out_info, str, run, is_pgm);
+		str += run;
+		len -= run;
+		if(len)
+		{
+			out_esc_char(out_info, FMTRD(str), esc);
+			str++;
+			len--;
+		};
+	};
+}
+
+// output a character escaped for JSON (\" \\ \n \u001B etc.), CSV ("" within a quoted field), or C (\" \\ and \ooo for control characters)
+// C uses 3 digit octal, as a hex escape would run on into a following hex digit
+static void out_esc_char(struct out_struct* out_info, char x, uint_least8_t esc)
+{
+	static const char json_chars[] = "btnvfr";	// \b to \r, \v is not a JSON escape
+
+	if(esc == ESC_CSV)
+	{
+		if(x == '"')
+			out_char(out_info, '"');
+		out_char(out_info, x);
+	}
+	else if(x == '\\' || x == '"')
+	{
+		out_char(out_info, '\\');
+		out_char(out_info, x);
+	}
+	else if((unsigned char)x < 0x20 || (x == 0x7F && esc == ESC_C))
+	{
+		out_char(out_info, '\\');
+		if(esc == ESC_JSON && x >= '\b' && x <= '\r' && x != '\v')
+			out_char(out_info, json_chars[x-'\b']);
+		else if(esc == ESC_JSON)
+		{
+			out_char(out_info, 'u');
+			out_char(out_info, '0');
+			out_char(out_info, '0');
+			out_char(out_info, ascii_hex_digit(x >> 4));
+			out_char(out_info, ascii_hex_digit(x));
+		}
+		else
+		{
+			out_char(out_info, '0' + ((x >> 6) & 3));
+			out_char(out_info, '0' + ((x >> 3) & 7));
+			out_char(out_info, '0' + (x & 7));
+		};
+	}
+	else
+		out_char(out_info, x);
+}
+
+// output a run of len characters which contains no control characters, copying to a buffer or block in bulk
+static void out_run(struct out_struct* out_info, const char* str, int len, bool is_pgm)
+{
+	int cnt;
+
+	if(is_pgm)
+	{
+		while(len--)
+		{
+			out_char(out_info, FMTRD(str));
+			str++;
+		};
+		return;
+	};
+
+	#ifdef PRNF_COL_ALIGNMENT
+		for(cnt=0; cnt<len; cnt++)
+			out_info->col += (str[cnt] > 0x1F);
+	#endif
+
+	if(out_info->buf)
+	{
+		cnt = out_info->size_limit-1 - out_info->char_cnt;
+		if(cnt > len)
+			cnt = len;
+		if(cnt > 0)
+		{
+			memcpy(out_info->buf, str, cnt);
+			out_info->buf += cnt;
+		};
+		out_info->char_cnt += len;
+	}
+	else if(out_info->blk)
+	{
+		out_info->char_cnt += len;
+		while(len)
+		{
+			cnt = out_info->blk_size - out_info->blk_len;
+			if(cnt > len)
+				cnt = len;
+			memcpy(&out_info->blk[out_info->blk_len], str, cnt);
+			out_info->blk_len += cnt;
+			if(out_info->blk_len == out_info->blk_size)
+				out_blk_flush(out_info, false);
+			str += cnt;
+			len -= cnt;
+		};
+	}
+	else
+	{
+		out_info->char_cnt += len;
+		if(out_info->dst_fptr)
+		{
+			while(len--)
+				out_info->dst_fptr(out_info->dst_fptr_vars, *str++);
+		};
+	};
+}
+
+// xxd style lines of XXD_LINE bytes, "00000000: 4865 6C6C ... 0001  Hello, world!..."
+// the hex of a short last line is padded so that it's ASCII column aligns
+static void out_xxd(struct out_struct* out_info, const uint8_t* src, size_t len)
+{
+	char pairs[XXD_LINE*2];
+	char line[sizeof("00000000:")-1 + XXD_LINE/2*5 + 2 + XXD_LINE];
+	size_t offset = 0;
+	char* ptr;
+	int cnt;
+	int i;
+
+	while(len)
+	{
+		cnt = len < XXD_LINE? len:XXD_LINE;
+		hex_encode(pairs, src, cnt);
+
+		for(i=0; i<8; i++)
+			line[i] = ascii_hex_digit(offset >> (28-i*4));
+		line[8] = ':';
+		ptr = &line[9];
+
+		for(i=0; i<XXD_LINE; i++)
+		{
+			if(!(i&1))
+				*ptr++ = ' ';
+			*ptr++ = (i < cnt)? pairs[i*2]:' ';
+			*ptr++ = (i < cnt)? pairs[i*2+1]:' ';
+		};
+
+		*ptr++ = ' ';
+		*ptr++ = ' ';
+		for(i=0; i<cnt; i++)
+			*ptr++ = (src[i] >= 0x20 && src[i] < 0x7F)? (char)src[i]:'.';
+
+		out_run(out_info, line, ptr-line, IS_NOT_PGM);
+		out_char(out_info, '\n');
+		src += cnt;
+		len -= cnt;
+		offset += cnt;
+	};
+}
+
+// 2*len uppercase hex digits of the bytes at src, 16 bytes at a time with SSE2
+static void hex_encode(char* dst, const uint8_t* src, int len)
+{
+	static const char hex_digits[sizeof(HEX_DIGITS_STRING)] = HEX_DIGITS_STRING;
+	int i = 0;
+
+	#ifdef __SSE2__
+		const __m128i low_nibble = _mm_set1_epi8(0x0F);
+		const __m128i nine = _mm_set1_epi8(9);
+		const __m128i zero = _mm_set1_epi8('0');
+		const __m128i letters = _mm_set1_epi8('A'-'0'-10);
+		__m128i bytes;
+		__m128i hi;
+		__m128i lo;
+		__m128i nibbles;
+		int half;
+
+		while(i+16 <= len)
+		{
+			bytes = _mm_loadu_si128((const __m128i*)&src[i]);
+			hi = _mm_and_si128(_mm_srli_epi16(bytes, 4), low_nibble);
+			lo = _mm_and_si128(bytes, low_nibble);
+			for(half=0; half<2; half++)
+			{
+				nibbles = half? _mm_unpackhi_epi8(hi, lo) : _mm_unpacklo_epi8(hi, lo);
+				nibbles = _mm_add_epi8(_mm_add_epi8(nibbles, zero), _mm_and_si128(_mm_cmpgt_epi8(nibbles, nine), letters));
+				_mm_storeu_si128((__m128i*)&dst[i*2+half*16], nibbles);
+			};
+			i += 16;
+		};
+	#endif
+
+	for(; i<len; i++)
+	{
+		dst[i*2] = hex_digits[src[i] >> 4];
+		dst[i*2+1] = hex_digits[src[i] & 0x0F];
+	};
+}
+
+// base64 of len bytes at src, padded with = unless url, returns the number of characters
+// with SSSE3, 12 bytes are spread to 16 6-bit indices and translated to ASCII with a shuffle (W. Mula, D. Lemire)
+static int base64_encode(char* dst, const uint8_t* src, int len, bool url)
+{
+	static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	static const char url_digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+	const char* alphabet = url? url_digits:digits;
+	char* ptr = dst;
+	uint32_t group;
+	int i = 0;
+
+	#ifdef __SSSE3__
+		const __m128i spread = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+		const __m128i offsets = _mm_setr_epi8('a'-26, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52,
+			(url? '-':'+')-62, (url? '_':'/')-63, 'A', 0, 0);
+		__m128i in;
+		__m128i idx;
+		__m128i lut_idx;
+
+		// 16 bytes are loaded for each 12 encoded
+		while(i+16 <= len)
+		{
+			in = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)&src[i]), spread);
+			idx = _mm_or_si128(
+				_mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0FC0FC00)), _mm_set1_epi32(0x04000040)),
+				_mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003F03F0)), _mm_set1_epi32(0x01000010)));
+			lut_idx = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+			lut_idx = _mm_or_si128(lut_idx, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), idx), _mm_set1_epi8(13)));
+			_mm_storeu_si128((__m128i*)ptr, _mm_add_epi8(_mm_shuffle_epi8(offsets, lut_idx), idx));
+			ptr += 16;
+			i += 12;
+		};
+	#endif
+
+	for(; i+3<=len; i+=3)
+	{
+		group = (uint32_t)src[i] << 16 | (uint32_t)src[i+1] << 8 | src[i+2];
+		*ptr++ = alphabet[group >> 18];
+		*ptr++ = alphabet[(group >> 12) & 0x3F];
+		*ptr++ = alphabet[(group >> 6) & 0x3F];
+		*ptr++ = alphabet[group & 0x3F];
+	};
+
+	if(i < len)
+	{
+		group = (uint32_t)src[i] << 16;
+		if(i+1 < len)
+			group |= (uint32_t)src[i+1] << 8;
+		*ptr++ = alphabet[group >> 18];
+		*ptr++ = alphabet[(group >> 12) & 0x3F];
+		if(i+1 < len)
+			*ptr++ = alphabet[(group >> 6) & 0x3F];
+		else if(!url)
+			*ptr++ = '=';
+		if(!url)
+			*ptr++ = '=';
+	};
+
+	return ptr - dst;
+}
+
+// base32 of len bytes at src, padded with =, returns the number of characters
+static int base32_encode(char* dst, const uint8_t* src, int len)
+{
+	static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
+	static const uint_least8_t digit_cnt[5] = {0, 2, 4, 5, 7};	// for a partial group of n bytes
+	char* ptr = dst;
+	uint64_t group;
+	int cnt;
+	int i;
+	int j;
+
+	for(i=0; i<len; i+=5)
+	{
+		cnt = (len-i < 5)? digit_cnt[len-i]:8;
+		group = 0;
+		for(j=0; j<5; j++)
+			group = group << 8 | ((i+j < len)? src[i+j]:0);
+		for(j=0; j<8; j++)
+			*ptr++ = (j < cnt)? alphabet[(group >> (35-j*5)) & 0x1F] : '=';
+	};
+
+	return ptr - dst;
+}
+
+// length of the run at the start of str (up to len) which contains no control characters, and neither a or b
+// 16 characters at a time with SSE2
+static int esc_run_len(const char* str, int len, char a, char b, char c, bool is_pgm)
+{
+	(void)is_pgm;
+	int i = 0;
+	char x;
+
+	#ifdef __SSE2__
+		const __m128i ctrl = _mm_set1_epi8(0x1F);
+		const __m128i va = _mm_set1_epi8(a);
+		const __m128i vb = _mm_set1_epi8(b);
+		const __m128i vc = _mm_set1_epi8(c);
+		__m128i chars;
+		__m128i hits;
+		int mask;
+
+		while(i+16 <= len)
+		{
+			chars = _mm_loadu_si128((const __m128i*)&str[i]);
+			hits = _mm_cmpeq_epi8(_mm_min_epu8(chars, ctrl), chars);
+			hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chars, va));
+			hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chars, vb));
+			hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chars, vc));
+			mask = _mm_movemask_epi8(hits);
+			if(mask)
+				return i + __builtin_ctz(mask);
+			i += 16;
+		};
+	#endif
+
+	while(i < len)
+	{
+		x = FMTRD(str+i);
+		if((unsigned char)x < 0x20 || x == a || x == b || x == c)
+			break;
+		i++;
+	};
+
+	return i;
+}
+
+// callback extension rendered to a string, for tokenized output
+static void out_tok_ext(struct out_struct* out_info, const struct prnf_ext_struct* ext)
+{
+	char txt[PRNF_EXT_TOK_SIZE];
+	struct out_struct txt_out = {.size_limit=sizeof(txt), .buf=txt};
+
+	if(is_ext(ext))
+		ext->fn((struct prnf_out_struct*)&txt_out, ext->ctx);
+	out_terminate(&txt_out);
+	out_tok_str(out_info, txt, IS_NOT_PGM);
+}
+
+// token and arguments packed for tokenized output, returns the number of bytes output
+static int tok_core(struct out_struct* out_info, uint32_t token, uint64_t types, va_list va)
+{
+	uint_least8_t argc = types & ((1<<PRNF_TOK_CNT_BITS)-1);
+	prnf_float_t f;
+	uint_least8_t i;
+	char* str;
+
+	types >>= PRNF_TOK_CNT_BITS;
+	out_varint(out_info, token);
+
+	while(argc--)
+	{
+		switch(types & ((1<<PRNF_TOK_TYPE_BITS)-1))
+		{
+			case PRNF_TOK_INT:
+				out_zigzag(out_info, va_arg(va, int));
+				break;
+
+			case PRNF_TOK_LONG:
+				out_zigzag(out_info, va_arg(va, long));
+				break;
+
+			case PRNF_TOK_LLONG:
+				out_zigzag(out_info, va_arg(va, long long));
+				break;
+
+			case PRNF_TOK_FLOAT:
+				f = (prnf_float_t)va_arg(va, double);
+				for(i=0; i<sizeof(f); i++)
+					out_char(out_info, ((char*)&f)[i]);	//assumes little endian target
+				break;
+
+			case PRNF_TOK_STR:
+				out_tok_str(out_info, va_arg(va, char*), IS_NOT_PGM);
+				break;
+
+			case PRNF_TOK_NSTR:
+				str = (char*)va_arg(va, int*);
+				out_tok_str(out_info, str, IS_NOT_PGM);
+				ext_free(str);
+				break;
+
+			case PRNF_TOK_SL:
+				out_tok_str(out_info, (const char*)va_arg(va, const wchar_t*), IS_PGM);
+				break;
+
+			case PRNF_TOK_EXT:
+				out_tok_ext(out_info, va_arg(va, void*));
+				break;
+		};
+		types >>= PRNF_TOK_TYPE_BITS;
+	};
+
+	out_terminate(out_info);
+	return out_info->char_cnt;
 }
 
 #endif //FIRST_PASS
@@ -1542,4 +3359,9 @@ static void out_terminate(struct out_struct* out_info)
 	#endif
 #endif
 
+// Guard against the implementation being included again, ie. by other prnf headers
+#ifndef SECOND_PASS
+	#define _PRNF_IMPLEMENTED_
+#endif
+
 #endif // PRNF_IMPLEMENTATION
\ No newline at end of file
@@ -0,0 +1,971 @@
+/*
+-------------------------------------------------------------------------------------
+# PRNF LOG
+
+ Logging macros for prnf, where every call site is registered (file, function, line, format and level) in the "prnf_site" linker section.
+ Sites can be enabled or disabled at runtime, by level, or by file name pattern.
+
+ * Single header (stb style), in one .c file:
+
+	#define PRNF_LOG_IMPLEMENTATION
+	#include "prnf_log.h"
+
+ * Requires prnf.h, and GCC or clang (for the section attribute). The linker provides the section bounds, no linker script changes are needed.
+
+-------------------------------------------------------------------------------------
+# Call sites
+
+	prnf_INFO("Fred is %i years old\n", freds_age);
+	prnf_DEBUG("%n\n", prext_tstamp(PREXT_ISO8601, time(NULL)));
+	prnf_LOG(PRNF_LOG_WARN, "Voltage low %.2fV\n", volts);
+
+ A disabled site costs one predictable branch on it's enabled flag. Arguments are not evaluated, so the prext_tstamp() above does not allocate unless the site is enabled.
+ Sites are initially enabled if their level is at least PRNF_LOG_DEFAULT_LEVEL.
+
+ Sites below PRNF_LOG_MIN_LEVEL are removed at compile time, and do not appear in the registry.
+ (For prnf_LOG() with a level which is not a literal, this relies on the optimizer removing the dead branch.)
+ Both may be defined in your build configuration, or before including prnf_log.h.
+
+ Output goes to prnf_putch() (as prnf() does), or a block handler given to prnf_log_sink() (ie. prnf_tee_blk, see prnf_sink.h).
+
+-------------------------------------------------------------------------------------
+# Runtime control
+
+	prnf_log_enable_level(PRNF_LOG_DEBUG);		// enable DEBUG and above, disable TRACE
+	prnf_log_enable("*uart*", true);			// enable all sites in files matching *uart*
+	prnf_log_enable("motor.c:120", false);		// disable the site(s) at line 120 of motor.c
+
+ Patterns may use * and ?, and match either the whole file path (as given by __FILE__) or just the file name.
+ An optional :line suffix matches only sites on that line.
+
+ prnf_log_sites() gives access to the registry, ie. to list sites in a user interface.
+ Enabling and disabling is seen by other threads, but is not synchronized with sites which are printing at the time.
+
+-------------------------------------------------------------------------------------
+# Repeats, rate limits and sampling
+
+ For sites which may be hit very often (ie. an error storm), a site can:
+
+	prnf_LOG_DEDUP(PRNF_LOG_ERROR, 1000, "CRC error on port %i\n", port);		// suppress repeats of the same message for 1000ms
+	prnf_LOG_RATE(PRNF_LOG_WARN, 10, 20, "Queue full %u\n", depth);			// at most 10 per second, in bursts of up to 20
+	prnf_LOG_SAMPLE(PRNF_LOG_DEBUG, 100, "rx %u bytes\n", len);				// 1 in every 100
+	prnf_LOG_LIMIT(PRNF_LOG_ERROR, 1000, 10, 20, 0, "...");					// any combination (window_ms, rate, burst, sample)
+
+ Sampling and the rate limit are decided before the arguments are evaluated.
+ Repeats are found by hashing the format pointer and the raw arguments (strings by their content), before any formatting.
+ Callback extensions (%p) are rendered to hash them.
+ When a different message is printed, or the same one after the window, "last message repeated N times" is printed first.
+ Messages dropped by the rate limit are also reported when one is next printed.
+ These sites may have at most 16 arguments, and %S is not supported (as for tokenized output).
+
+ Time is from PRNF_LOG_MS(), which defaults to clock_gettime(CLOCK_MONOTONIC) on POSIX targets.
+ Other targets should define PRNF_LOG_MS() (as a millisecond count) where the implementation is included, otherwise windows never expire and rates never refill.
+ The state of a site is not locked, concurrent prints at the same site may miscount repeats and drops.
+
+-------------------------------------------------------------------------------------
+# Line prefix
+
+	#define PRNF_LOG_PREFIX		// where the implementation is included
+	...
+	prnf_log_prefix("%Y-%m-%dT%H:%M:%S%z ", "%s:%.4i(%s)\v55 %s: ");
+
+ Only compiled if PRNF_LOG_PREFIX is defined where the implementation is included, otherwise prnf_log_prefix() does not link,
+ and the caches, time(), localtime() and strftime() are left out.
+ Starts every message with a timestamp (a strftime() format) and the site (a prnf format, given the file, line, function and level name).
+ Either may be NULL. A message should be a single line, the prefix is not repeated after line endings within it.
+
+ The timestamp is only re-rendered when the second changes, and the site prefix only once for each site, so a line costs two memcpy()s and the body.
+ The prefix and the first block of the body are passed to the sink in one call.
+ Both are cached per thread on POSIX targets. The site cache is direct mapped by the site address, with PRNF_LOG_PREFIX_CACHE entries (32, 4 on AVR).
+ A site prefix longer than PRNF_LOG_SITE_SIZE (80), or a timestamp longer than PRNF_LOG_TSTAMP_SIZE (32) is truncated.
+ Column alignment (\v) in the site format counts from the start of the line, assuming the timestamp keeps the width it had when prnf_log_prefix() was called.
+
+ The time is from PRNF_LOG_TIME(), which defaults to time(NULL). Calling prnf_log_prefix() again invalidates the caches, ie. after changing the time zone.
+
+-------------------------------------------------------------------------------------
+# AVR
+
+ Format strings are placed in PROGMEM.
+*/
+
+#ifndef _PRNF_LOG_H_
+#define _PRNF_LOG_H_
+
+	#include <stddef.h>
+	#include <stdbool.h>
+	#include <stdint.h>
+	#include "prnf.h"
+
+	#ifdef __cplusplus
+	extern "C" {
+	#endif
+
+//********************************************************************************************************
+// Public defines
+//********************************************************************************************************
+
+	#define PRNF_LOG_TRACE		0
+	#define PRNF_LOG_DEBUG		1
+	#define PRNF_LOG_INFO		2
+	#define PRNF_LOG_WARN		3
+	#define PRNF_LOG_ERROR		4
+	#define PRNF_LOG_NONE		5
+
+//	Sites below this level are removed at compile time
+	#ifndef PRNF_LOG_MIN_LEVEL
+		#define PRNF_LOG_MIN_LEVEL		PRNF_LOG_TRACE
+	#endif
+
+//	Sites below this level start disabled
+	#ifndef PRNF_LOG_DEFAULT_LEVEL
+		#define PRNF_LOG_DEFAULT_LEVEL	PRNF_LOG_INFO
+	#endif
+
+//	Repeat suppression, rate limit and sampling for a site
+	struct prnf_log_limit_struct
+	{
+		uint16_t window_ms;			// suppress repeats of the same message within this time, 0 for none
+		uint16_t rate;				// messages per second, 0 for no limit
+		uint16_t burst;				// messages allowed in a burst
+		uint16_t sample;			// print 1 in every sample messages, 0 or 1 for all
+		uint32_t hash;				// of the last message printed
+		uint32_t repeat_ms;			// when it was printed
+		uint32_t repeats;			// repeats of it suppressed
+		uint32_t credit;			// token bucket, in 1/1000 of a message
+		uint32_t credit_ms;			// when credit was last updated
+		uint32_t count;				// for sampling
+		uint32_t dropped;			// by the rate limit, since a message was last printed
+		bool started;
+	};
+
+	struct prnf_log_site_struct
+	{
+		const char* file;
+		const char* func;
+		const char* fmt;			// in PROGMEM for AVR
+		struct prnf_log_limit_struct* limit;	// NULL if none
+		uint16_t line;
+		uint8_t level;
+		volatile bool enabled;
+	};
+
+#ifdef __AVR__
+	#define PRNF_LOG_PROGMEM	PROGMEM
+#else
+	#define PRNF_LOG_PROGMEM
+#endif
+
+//	Place a site in the registry, the alignment prevents the compiler padding sites apart
+	#define PRNF_LOG_SECTION	__attribute__((section("prnf_site"), aligned(__alignof__(struct prnf_log_site_struct))))
+
+//	Register a call site, and print if it is enabled. The arguments are only evaluated if the site is enabled.
+	#define prnf_LOG(_level, _fmtarg, ...)																			\
+	do{																												\
+		if((_level) >= PRNF_LOG_MIN_LEVEL)																			\
+		{																											\
+			static const char _log_fmt[] PRNF_LOG_PROGMEM = _fmtarg;												\
+			static struct prnf_log_site_struct _log_site PRNF_LOG_SECTION =											\
+				{__FILE__, __func__, _log_fmt, NULL, __LINE__, (_level), (_level) >= PRNF_LOG_DEFAULT_LEVEL};		\
+			if(__builtin_expect(_log_site.enabled, false))															\
+				prnf_log_print(&_log_site ,##__VA_ARGS__);															\
+		};																											\
+		while(0) fmttst_optout(_fmtarg ,##__VA_ARGS__);																\
+	}while(0)
+
+//	A site with repeat suppression, a rate limit and/or sampling (see above).
+	#define prnf_LOG_LIMIT(_level, _window_ms, _rate, _burst, _sample, _fmtarg, ...)									\
+	do{																												\
+		if((_level) >= PRNF_LOG_MIN_LEVEL)																			\
+		{																											\
+			static const char _log_fmt[] PRNF_LOG_PROGMEM = _fmtarg;												\
+			static struct prnf_log_limit_struct _log_limit = {.window_ms=(_window_ms), .rate=(_rate), .burst=(_burst), .sample=(_sample)};	\
+			static struct prnf_log_site_struct _log_site PRNF_LOG_SECTION =											\
+				{__FILE__, __func__, _log_fmt, &_log_limit, __LINE__, (_level), (_level) >= PRNF_LOG_DEFAULT_LEVEL};	\
+			if(__builtin_expect(_log_site.enabled, false) && prnf_log_admit(&_log_site))							\
+				prnf_log_print_limited(&_log_site, PRNF_TOK_TYPES(__VA_ARGS__) ,##__VA_ARGS__);						\
+		};																											\
+		while(0) fmttst_optout(_fmtarg ,##__VA_ARGS__);																\
+	}while(0)
+
+	#define prnf_LOG_DEDUP(_level, _window_ms, _fmtarg, ...)	prnf_LOG_LIMIT(_level, _window_ms, 0, 0, 0, _fmtarg ,##__VA_ARGS__)
+	#define prnf_LOG_RATE(_level, _rate, _burst, _fmtarg, ...)	prnf_LOG_LIMIT(_level, 0, _rate, _burst, 0, _fmtarg ,##__VA_ARGS__)
+	#define prnf_LOG_SAMPLE(_level, _sample, _fmtarg, ...)		prnf_LOG_LIMIT(_level, 0, 0, 0, _sample, _fmtarg ,##__VA_ARGS__)
+
+//	A site removed at compile time, the format is still checked
+	#define PRNF_LOG_STRIPPED(_fmtarg, ...)	do{ while(0) fmttst_optout(_fmtarg ,##__VA_ARGS__); }while(0)
+
+#if PRNF_LOG_MIN_LEVEL > PRNF_LOG_TRACE
+	#define prnf_TRACE(_fmtarg, ...)	PRNF_LOG_STRIPPED(_fmtarg ,##__VA_ARGS__)
+#else
+	#define prnf_TRACE(_fmtarg, ...)	prnf_LOG(PRNF_LOG_TRACE, _fmtarg ,##__VA_ARGS__)
+#endif
+#if PRNF_LOG_MIN_LEVEL > PRNF_LOG_DEBUG
+	#define prnf_DEBUG(_fmtarg, ...)	PRNF_LOG_STRIPPED(_fmtarg ,##__VA_ARGS__)
+#else
+	#define prnf_DEBUG(_fmtarg, ...)	prnf_LOG(PRNF_LOG_DEBUG, _fmtarg ,##__VA_ARGS__)
+#endif
+#if PRNF_LOG_MIN_LEVEL > PRNF_LOG_INFO
+	#define prnf_INFO(_fmtarg, ...)		PRNF_LOG_STRIPPED(_fmtarg ,##__VA_ARGS__)
+#else
+	#define prnf_INFO(_fmtarg, ...)		prnf_LOG(PRNF_LOG_INFO, _fmtarg ,##__VA_ARGS__)
+#endif
+#if PRNF_LOG_MIN_LEVEL > PRNF_LOG_WARN
+	#define prnf_WARN(_fmtarg, ...)		PRNF_LOG_STRIPPED(_fmtarg ,##__VA_ARGS__)
+#else
+	#define prnf_WARN(_fmtarg, ...)		prnf_LOG(PRNF_LOG_WARN, _fmtarg ,##__VA_ARGS__)
+#endif
+#if PRNF_LOG_MIN_LEVEL > PRNF_LOG_ERROR
+	#define prnf_ERROR(_fmtarg, ...)	PRNF_LOG_STRIPPED(_fmtarg ,##__VA_ARGS__)
+#else
+	#define prnf_ERROR(_fmtarg, ...)	prnf_LOG(PRNF_LOG_ERROR, _fmtarg ,##__VA_ARGS__)
+#endif
+
+//********************************************************************************************************
+// Public prototypes
+//********************************************************************************************************
+
+//	Send log output to a block handler, or prnf_putch() if blk_fptr is NULL.
+	void prnf_log_sink(void(*blk_fptr)(void*, const char*, size_t), void* blk_vars);
+
+//	Enable or disable sites in files matching the pattern (see above), returns the number of sites matched.
+	int prnf_log_enable(const char* pattern, bool enable);
+
+//	Enable sites at or above level, and disable those below, returns the number of sites enabled.
+	int prnf_log_enable_level(uint8_t level);
+
+//	Start each message with a timestamp (strftime() format) and the site (prnf format, given the file, line, function and level name), either may be NULL.
+//	Requires PRNF_LOG_PREFIX to be defined where the implementation is included.
+	void prnf_log_prefix(const char* time_fmt, const char* site_fmt);
+
+//	The registered sites, and their count.
+	struct prnf_log_site_struct* prnf_log_sites(size_t* count);
+
+//	Print for an enabled site, these are not intended to be called directly.
+	int prnf_log_print(struct prnf_log_site_struct* site, ...);
+	bool prnf_log_admit(struct prnf_log_site_struct* site);
+	int prnf_log_print_limited(struct prnf_log_site_struct* site, uint64_t types, ...);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // _PRNF_LOG_H_
+
+
+
+
+
+//********************************************************************************************************
+//
+// PRNF LOG Implementation
+//
+//********************************************************************************************************
+#ifdef PRNF_LOG_IMPLEMENTATION
+#ifndef _PRNF_LOG_IMPLEMENTED_
+#define _PRNF_LOG_IMPLEMENTED_
+
+	#include <stdbool.h>
+	#include <stdint.h>
+	#include <stdarg.h>
+	#include <string.h>
+
+//********************************************************************************************************
+// Local defines
+//********************************************************************************************************
+
+	#ifndef PRNF_ASSERT
+		#define PRNF_ASSERT(arg)	((void)0)
+	#endif
+
+#ifdef __AVR__
+	#define LOG_VBLKPRNF	vblkprnf_P
+	#define LOG_FMT_RD(_p)	((char)pgm_read_byte(_p))
+#else
+	#define LOG_VBLKPRNF	vblkprnf
+	#define LOG_FMT_RD(_p)	(*(_p))
+#endif
+
+#ifndef PRNF_LOG_MS
+	#if defined(__unix__) || defined(__APPLE__)
+		#include <time.h>
+		#define PRNF_LOG_MS()	log_posix_ms()
+		#define LOG_POSIX_MS
+	#else
+		#define PRNF_LOG_MS()	0
+	#endif
+#endif
+
+#ifdef PRNF_LOG_PREFIX
+	#ifndef PRNF_LOG_TIME
+		#include <time.h>
+		#define PRNF_LOG_TIME()		time(NULL)
+	#endif
+
+	#ifndef PRNF_LOG_TSTAMP_SIZE
+		#define PRNF_LOG_TSTAMP_SIZE	32
+	#endif
+
+	#ifndef PRNF_LOG_SITE_SIZE
+		#define PRNF_LOG_SITE_SIZE		80
+	#endif
+
+	#ifndef PRNF_LOG_PREFIX_CACHE
+		#ifdef __AVR__
+			#define PRNF_LOG_PREFIX_CACHE	4
+		#else
+			#define PRNF_LOG_PREFIX_CACHE	32
+		#endif
+	#endif
+
+//	Prefix caches are per thread where there are threads
+	#if defined(__unix__) || defined(__APPLE__)
+		#define LOG_TLS						__thread
+		#define LOG_LOCALTIME(_t, _tm)		localtime_r(_t, _tm)
+	#else
+		#define LOG_TLS
+		#define LOG_LOCALTIME(_t, _tm)		(*(_tm) = *localtime(_t))
+	#endif
+#endif
+
+//	Size of the blocks from vblkprnf(), if the prnf implementation is not in this unit assume the default
+#ifdef PRNF_BLK_SIZE
+	#define LOG_BLK_SIZE	PRNF_BLK_SIZE
+#else
+	#define LOG_BLK_SIZE	128
+#endif
+
+//	Callback extension arguments are rendered to a buffer of this size to hash them
+	#ifndef PRNF_LOG_EXT_HASH_SIZE
+		#define PRNF_LOG_EXT_HASH_SIZE	64
+	#endif
+
+//	Size of a %p{name} placeholder copied from a format, longer names are not hashed by value
+	#define LOG_EXT_SPEC_SIZE	24
+
+//	32 bit FNV-1a
+	#define LOG_HASH_INIT		2166136261UL
+	#define LOG_HASH_PRIME		16777619UL
+
+//********************************************************************************************************
+// Private variables
+//********************************************************************************************************
+
+//	Section bounds provided by the linker, weak so that a program without any sites links
+	extern struct prnf_log_site_struct __start_prnf_site[] __attribute__((weak));
+	extern struct prnf_log_site_struct __stop_prnf_site[] __attribute__((weak));
+
+	static void(*log_blk_fptr)(void*, const char*, size_t) = NULL;
+	static void* log_blk_vars = NULL;
+
+#ifdef PRNF_LOG_PREFIX
+	static const char* log_level_names[] = {"TRACE", "DEBUG", "INFO", "WARN", "ERROR", "NONE"};
+
+//	Prefix configuration, the site format is preceded by spaces for the width of the timestamp
+	static const char* log_time_fmt = NULL;
+	static char log_site_fmt[PRNF_LOG_TSTAMP_SIZE + PRNF_LOG_SITE_SIZE];
+	static bool log_site_on = false;
+	static uint_least8_t log_time_width = 0;
+	static unsigned log_gen = 1;				// changed by prnf_log_prefix(), 0 is never used
+
+	struct log_time_struct
+	{
+		time_t sec;
+		unsigned gen;
+		uint_least8_t len;
+		char text[PRNF_LOG_TSTAMP_SIZE];
+	};
+
+	struct log_prefix_struct
+	{
+		const struct prnf_log_site_struct* site;
+		unsigned gen;
+		uint_least8_t len;
+		char text[PRNF_LOG_SITE_SIZE];
+	};
+
+	static LOG_TLS struct log_time_struct log_time_cache;
+	static LOG_TLS struct log_prefix_struct log_prefix_cache[PRNF_LOG_PREFIX_CACHE];
+
+//	A line being passed to the sink, the prefix and the first block of the body are sent together
+	struct log_line_struct
+	{
+		void(*blk_fptr)(void*, const char*, size_t);
+		void* blk_vars;
+		size_t len;
+		char buf[PRNF_LOG_TSTAMP_SIZE + PRNF_LOG_SITE_SIZE + LOG_BLK_SIZE];
+	};
+#endif
+
+//********************************************************************************************************
+// Private prototypes
+//********************************************************************************************************
+
+	static bool log_match(const char* pattern, const char* pattern_end, const char* str);
+	static uint32_t log_hash(uint32_t hash, const void* src, size_t len);
+	static uint32_t log_hash_args(const char* fmt, uint64_t types, va_list va);
+	static void log_free_args(uint64_t types, va_list va);
+	static char log_next_conv(const char** fmt, char* spec, int* stars);
+	static void log_note(const struct prnf_log_site_struct* site, const char* fmtstr, ...);
+	static int log_vout(const struct prnf_log_site_struct* site, const char* fmt, bool progmem, va_list va);
+#ifdef PRNF_LOG_PREFIX
+	static int log_vout_prefix(const struct prnf_log_site_struct* site, const char* fmt, bool progmem, va_list va);
+	static size_t log_time(const char** text);
+	static size_t log_prefix(const struct prnf_log_site_struct* site, const char** text);
+	static void log_line_blk(void* vars, const char* blk, size_t len);
+#endif
+	static void log_putblk(void* vars, const char* blk, size_t len);
+#ifdef LOG_POSIX_MS
+	static uint32_t log_posix_ms(void);
+#endif
+
+//********************************************************************************************************
+// Public functions
+//********************************************************************************************************
+
+void prnf_log_sink(void(*blk_fptr)(void*, const char*, size_t), void* blk_vars)
+{
+	log_blk_fptr = blk_fptr;
+	log_blk_vars = blk_vars;
+}
+
+int prnf_log_enable(const char* pattern, bool enable)
+{
+	struct prnf_log_site_struct* site;
+	const char* pattern_end = pattern + strlen(pattern);
+	const char* colon = strrchr(pattern, ':');
+	const char* name;
+	long line = -1;
+	int count = 0;
+
+	if(colon && colon[1] >= '0' && colon[1] <= '9')
+	{
+		line = 0;
+		pattern_end = colon;
+		while(*++colon >= '0' && *colon <= '9')
+			line = line*10 + (*colon - '0');
+	};
+
+	for(site = __start_prnf_site; site != __stop_prnf_site; site++)
+	{
+		name = strrchr(site->file, '/');
+		name = name? name+1 : site->file;
+		if((line < 0 || line == site->line) && (log_match(pattern, pattern_end, site->file) || log_match(pattern, pattern_end, name)))
+		{
+			site->enabled = enable;
+			count++;
+		};
+	};
+
+	return count;
+}
+
+int prnf_log_enable_level(uint8_t level)
+{
+	struct prnf_log_site_struct* site;
+	int count = 0;
+
+	for(site = __start_prnf_site; site != __stop_prnf_site; site++)
+	{
+		site->enabled = (site->level >= level);
+		count += site->enabled;
+	};
+
+	return count;
+}
+
+#ifdef PRNF_LOG_PREFIX
+void prnf_log_prefix(const char* time_fmt, const char* site_fmt)
+{
+	const char* text;
+	size_t len;
+
+	if(!++log_gen)
+		log_gen++;
+
+	log_time_fmt = time_fmt;
+	log_time_width = time_fmt? log_time(&text) : 0;
+
+	log_site_on = (site_fmt != NULL);
+	if(site_fmt)
+	{
+		len = strlen(site_fmt);
+		PRNF_ASSERT(log_time_width + len < sizeof(log_site_fmt));
+		if(log_time_width + len >= sizeof(log_site_fmt))
+			len = sizeof(log_site_fmt) - log_time_width - 1;
+		memset(log_site_fmt, ' ', log_time_width);
+		memcpy(log_site_fmt + log_time_width, site_fmt, len);
+		log_site_fmt[log_time_width + len] = 0;
+	};
+}
+#endif
+
+struct prnf_log_site_struct* prnf_log_sites(size_t* count)
+{
+	*count = __stop_prnf_site - __start_prnf_site;
+	return __start_prnf_site;
+}
+
+int prnf_log_print(struct prnf_log_site_struct* site, ...)
+{
+	va_list va;
+	int ret;
+
+	va_start(va, site);
+	ret = log_vout(site, site->fmt, true, va);
+	va_end(va);
+
+	return ret;
+}
+
+bool prnf_log_admit(struct prnf_log_site_struct* site)
+{
+	struct prnf_log_limit_struct* limit = site->limit;
+	uint32_t now;
+	uint32_t full;
+
+	if(limit->sample > 1 && limit->count++ % limit->sample)
+		return false;
+
+	if(limit->rate)
+	{
+		now = PRNF_LOG_MS();
+		full = (limit->burst? (uint32_t)limit->burst : 1) * 1000;
+		if(!limit->started)
+		{
+			limit->credit = full;
+			limit->started = true;
+		}
+		else if((now - limit->credit_ms) >= full / limit->rate)
+			limit->credit = full;
+		else
+			limit->credit += (now - limit->credit_ms) * limit->rate;
+		if(limit->credit > full)
+			limit->credit = full;
+		limit->credit_ms = now;
+
+		if(limit->credit < 1000)
+		{
+			limit->dropped++;
+			return false;
+		};
+		limit->credit -= 1000;
+	};
+
+	return true;
+}
+
+int prnf_log_print_limited(struct prnf_log_site_struct* site, uint64_t types, ...)
+{
+	struct prnf_log_limit_struct* limit = site->limit;
+	va_list va;
+	va_list va_args;
+	uint32_t hash;
+	uint32_t now;
+	int ret = 0;
+
+	va_start(va, types);
+	if(limit->window_ms)
+	{
+		va_copy(va_args, va);
+		hash = log_hash_args(site->fmt, types, va_args);
+		va_end(va_args);
+		now = PRNF_LOG_MS();
+		if(hash == limit->hash && now - limit->repeat_ms < limit->window_ms)
+		{
+			limit->repeats++;
+			log_free_args(types, va);
+			va_end(va);
+			return 0;
+		};
+		if(limit->repeats)
+			log_note(site, "last message repeated %lu times\n", (unsigned long)limit->repeats);
+		limit->hash = hash;
+		limit->repeat_ms = now;
+		limit->repeats = 0;
+	};
+
+	if(limit->dropped)
+	{
+		log_note(site, "%lu messages dropped by rate limit\n", (unsigned long)limit->dropped);
+		limit->dropped = 0;
+	};
+
+	ret = log_vout(site, site->fmt, true, va);
+	va_end(va);
+
+	return ret;
+}
+
+//********************************************************************************************************
+// Private functions
+//********************************************************************************************************
+
+// Glob match of str against the pattern up to pattern_end, * matches any sequence and ? any character
+static bool log_match(const char* pattern, const char* pattern_end, const char* str)
+{
+	const char* star = NULL;
+	const char* retry = NULL;
+
+	while(*str)
+	{
+		if(pattern != pattern_end && *pattern == '*')
+		{
+			star = ++pattern;
+			retry = str;
+		}
+		else if(pattern != pattern_end && (*pattern == '?' || *pattern == *str))
+		{
+			pattern++;
+			str++;
+		}
+		else if(star)
+		{
+			pattern = star;
+			str = ++retry;
+		}
+		else
+			return false;
+	};
+
+	while(pattern != pattern_end && *pattern == '*')
+		pattern++;
+
+	return pattern == pattern_end;
+}
+
+static uint32_t log_hash(uint32_t hash, const void* src, size_t len)
+{
+	const uint8_t* ptr = src;
+
+	while(len--)
+		hash = (hash ^ *ptr++) * LOG_HASH_PRIME;
+
+	return hash;
+}
+
+// Hash the format pointer, and the arguments as classified by PRNF_TOK_TYPES()
+// %p arguments (of any pointer type) are found from the format, and hashed as rendered by their placeholder
+static uint32_t log_hash_args(const char* fmt, uint64_t types, va_list va)
+{
+	uint_least8_t argc = types & ((1<<PRNF_TOK_CNT_BITS)-1);
+	uint32_t hash = log_hash(LOG_HASH_INIT, &fmt, sizeof(fmt));
+	long long ll;
+	double d;
+	long l;
+	int i;
+	const char* str;
+	const char* conv_fmt = fmt;
+	char conv = 0;
+	int stars = 0;
+	void* ptr;
+	char spec[LOG_EXT_SPEC_SIZE];
+	char txt[PRNF_LOG_EXT_HASH_SIZE];
+
+	types >>= PRNF_TOK_CNT_BITS;
+	while(argc--)
+	{
+		// the conversion this argument is for, * width and precision arguments come first
+		if(!conv)
+			conv = log_next_conv(&conv_fmt, spec, &stars);
+		if(stars)
+			stars--;
+		else if(conv == 'p')
+		{
+			conv = 0;
+			ptr = va_arg(va, void*);
+			if(spec[0])
+			{
+				snprnf(txt, sizeof(txt), spec, ptr);
+				hash = log_hash(hash, txt, strlen(txt)+1);
+			}
+			else
+				hash = log_hash(hash, &ptr, sizeof(ptr));
+			types >>= PRNF_TOK_TYPE_BITS;
+			continue;
+		}
+		else
+			conv = 0;
+
+		switch(types & ((1<<PRNF_TOK_TYPE_BITS)-1))
+		{
+			case PRNF_TOK_INT:
+				i = va_arg(va, int);
+				hash = log_hash(hash, &i, sizeof(i));
+				break;
+
+			case PRNF_TOK_LONG:
+				l = va_arg(va, long);
+				hash = log_hash(hash, &l, sizeof(l));
+				break;
+
+			case PRNF_TOK_LLONG:
+				ll = va_arg(va, long long);
+				hash = log_hash(hash, &ll, sizeof(ll));
+				break;
+
+			case PRNF_TOK_FLOAT:
+				d = va_arg(va, double);
+				hash = log_hash(hash, &d, sizeof(d));
+				break;
+
+			case PRNF_TOK_STR:
+				str = va_arg(va, char*);
+				hash = str? log_hash(hash, str, strlen(str)+1) : hash * LOG_HASH_PRIME;
+				break;
+
+			case PRNF_TOK_NSTR:
+				str = (char*)va_arg(va, int*);
+				hash = str? log_hash(hash, str, strlen(str)+1) : hash * LOG_HASH_PRIME;
+				break;
+
+			case PRNF_TOK_EXT:
+				ptr = va_arg(va, void*);
+				hash = log_hash(hash, &ptr, sizeof(ptr));
+				break;
+		};
+		types >>= PRNF_TOK_TYPE_BITS;
+	};
+
+	return hash;
+}
+
+// Find the next placeholder of a format which takes an argument, returns it's conversion character or 0 at the end of the format
+// stars is set to the number of * width and precision arguments which it takes first
+// for %p, spec is set to %p or %p{name} (without width or flags), or is empty if the name does not fit
+static char log_next_conv(const char** fmt, char* spec, int* stars)
+{
+	const char* ptr = *fmt;
+	char c;
+	int len;
+
+	*stars = 0;
+	spec[0] = 0;
+	while((c = LOG_FMT_RD(ptr)))
+	{
+		ptr++;
+		if(c != '%')
+			continue;
+
+		if(LOG_FMT_RD(ptr) == '%')
+		{
+			ptr++;
+			continue;
+		};
+
+		while((c = LOG_FMT_RD(ptr)) && strchr("-+ #0123456789.*hlLjzt", c))
+		{
+			if(c == '*')
+				(*stars)++;
+			ptr++;
+		};
+
+		if(!c)
+			break;
+		ptr++;
+
+		if(c == 'p')
+		{
+			spec[0] = '%';
+			spec[1] = 'p';
+			len = 2;
+			if(LOG_FMT_RD(ptr) == '{')
+			{
+				do
+				{
+					c = LOG_FMT_RD(ptr);
+					if(!c || len == LOG_EXT_SPEC_SIZE-1)
+					{
+						len = 0;
+						break;
+					};
+					spec[len++] = c;
+					ptr++;
+				}while(c != '}');
+			};
+			spec[len] = 0;
+			c = 'p';
+		};
+		*fmt = ptr;
+		return c;
+	};
+
+	*fmt = ptr;
+	return 0;
+}
+
+// Free the strings of %n arguments which will not be printed
+static void log_free_args(uint64_t types, va_list va)
+{
+	uint_least8_t argc = types & ((1<<PRNF_TOK_CNT_BITS)-1);
+	char* str;
+
+	types >>= PRNF_TOK_CNT_BITS;
+	while(argc--)
+	{
+		switch(types & ((1<<PRNF_TOK_TYPE_BITS)-1))
+		{
+			case PRNF_TOK_INT:		(void)va_arg(va, int);			break;
+			case PRNF_TOK_LONG:		(void)va_arg(va, long);			break;
+			case PRNF_TOK_LLONG:	(void)va_arg(va, long long);	break;
+			case PRNF_TOK_FLOAT:	(void)va_arg(va, double);		break;
+			case PRNF_TOK_STR:		(void)va_arg(va, char*);		break;
+			case PRNF_TOK_EXT:		(void)va_arg(va, void*);		break;
+
+			case PRNF_TOK_NSTR:
+				str = (char*)va_arg(va, int*);
+				prnf_ext_free(str);
+				break;
+		};
+		types >>= PRNF_TOK_TYPE_BITS;
+	};
+}
+
+// Print a message about suppressed output, the format is in RAM
+static void log_note(const struct prnf_log_site_struct* site, const char* fmtstr, ...)
+{
+	va_list va;
+
+	va_start(va, fmtstr);
+	log_vout(site, fmtstr, false, va);
+	va_end(va);
+}
+
+// Print a message with the prefix for the site (if any), the format is in PROGMEM on AVR if progmem is true
+static int log_vout(const struct prnf_log_site_struct* site, const char* fmt, bool progmem, va_list va)
+{
+	void(*blk_fptr)(void*, const char*, size_t) = log_blk_fptr? log_blk_fptr : log_putblk;
+
+	#ifdef PRNF_LOG_PREFIX
+		if(log_time_fmt || log_site_on)
+			return log_vout_prefix(site, fmt, progmem, va);
+	#else
+		(void)site;
+	#endif
+
+	return progmem? LOG_VBLKPRNF(blk_fptr, log_blk_vars, fmt, va) : vblkprnf(blk_fptr, log_blk_vars, fmt, va);
+}
+
+#ifdef PRNF_LOG_PREFIX
+// Print a message with the prefix for the site, sent to the sink with the first block of the message
+static int log_vout_prefix(const struct prnf_log_site_struct* site, const char* fmt, bool progmem, va_list va)
+{
+	struct log_line_struct line;
+	const char* text;
+	size_t len;
+	int ret;
+
+	line.blk_fptr = log_blk_fptr? log_blk_fptr : log_putblk;
+	line.blk_vars = log_blk_vars;
+	line.len = 0;
+
+	if(log_time_fmt)
+	{
+		len = log_time(&text);
+		memcpy(line.buf, text, len);
+		line.len = len;
+	};
+
+	if(log_site_on)
+	{
+		len = log_prefix(site, &text);
+		memcpy(line.buf + line.len, text, len);
+		line.len += len;
+	};
+
+	len = line.len;
+	ret = progmem? LOG_VBLKPRNF(log_line_blk, &line, fmt, va) : vblkprnf(log_line_blk, &line, fmt, va);
+
+	// empty body
+	if(line.len)
+		line.blk_fptr(line.blk_vars, line.buf, line.len);
+
+	return ret + (int)len;
+}
+
+// The timestamp for the current second, rendered only when the second (or the configuration) changes
+static size_t log_time(const char** text)
+{
+	struct log_time_struct* cache = &log_time_cache;
+	time_t now = PRNF_LOG_TIME();
+	struct tm tm;
+
+	if(now != cache->sec || cache->gen != log_gen)
+	{
+		LOG_LOCALTIME(&now, &tm);
+		cache->len = strftime(cache->text, sizeof(cache->text), log_time_fmt, &tm);
+		cache->sec = now;
+		cache->gen = log_gen;
+	};
+
+	*text = cache->text;
+	return cache->len;
+}
+
+// The site prefix, rendered once per site (unless evicted by another site with the same cache index)
+static size_t log_prefix(const struct prnf_log_site_struct* site, const char** text)
+{
+	struct log_prefix_struct* entry = &log_prefix_cache[((uintptr_t)site / sizeof(*site)) % PRNF_LOG_PREFIX_CACHE];
+	char tmp[sizeof(log_site_fmt)];
+	size_t len;
+
+	if(entry->site != site || entry->gen != log_gen)
+	{
+		// the leading spaces make \v columns count from the start of the line, they are then dropped
+		snprnf(tmp, sizeof(tmp), log_site_fmt, site->file, (int)site->line, site->func, log_level_names[site->level < PRNF_LOG_NONE? site->level : PRNF_LOG_NONE]);
+		len = strlen(tmp);
+		len = (len > log_time_width)? len - log_time_width : 0;
+		if(len > sizeof(entry->text))
+			len = sizeof(entry->text);
+		memcpy(entry->text, tmp + log_time_width, len);
+		entry->len = len;
+		entry->site = site;
+		entry->gen = log_gen;
+	};
+
+	*text = entry->text;
+	return entry->len;
+}
+
+// Block handler which sends the prefix with the first block
+static void log_line_blk(void* vars, const char* blk, size_t len)
+{
+	struct log_line_struct* line = vars;
+
+	if(!line->len)
+		line->blk_fptr(line->blk_vars, blk, len);
+	else if(line->len + len <= sizeof(line->buf))
+	{
+		memcpy(line->buf + line->len, blk, len);
+		line->blk_fptr(line->blk_vars, line->buf, line->len + len);
+		line->len = 0;
+	}
+	else
+	{
+		line->blk_fptr(line->blk_vars, line->buf, line->len);
+		line->blk_fptr(line->blk_vars, blk, len);
+		line->len = 0;
+	};
+}
+#endif
+
+// Output when no sink is given, as prnf() would
+static void log_putblk(void* vars, const char* blk, size_t len)
+{
+	#ifdef PRNF_PUTBLK
+		prnf_putblk(vars, blk, len);
+	#else
+		while(len--)
+			prnf_putch(vars, *blk++);
+	#endif
+}
+
+#ifdef LOG_POSIX_MS
+static uint32_t log_posix_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)ts.tv_sec*1000 + ts.tv_nsec/1000000;
+}
+#endif
+
+#endif // _PRNF_LOG_IMPLEMENTED_
+#endif // PRNF_LOG_IMPLEMENTATION
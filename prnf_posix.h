@@ -0,0 +1,2332 @@
+/*
+-------------------------------------------------------------------------------------
+# PRNF POSIX
+
+ Additions to prnf for hosted POSIX targets (Linux etc), which need threads or operating system services.
+ These are kept out of prnf.h so that it remains portable to bare metal targets.
+
+ * Single header (stb style), in one .c file:
+
+	#define PRNF_POSIX_IMPLEMENTATION
+	#include "prnf_posix.h"
+
+ * Requires prnf.h, and linking with -pthread
+
+-------------------------------------------------------------------------------------
+# Batch formatting
+
+	char* prnf_batch(const char* fmtstr, size_t count, int(*rec_fn)(char*, size_t, const char*, size_t, void*), void* rec_vars, int threads, size_t* len);
+
+ Formats count records with the same format string into one contiguous buffer, using a number of threads.
+ The lengths of all records are first measured in parallel, a prefix sum of the lengths gives the position of each record,
+ and then the records are printed in parallel directly to their position in the buffer.
+ The output is identical to calling sprnf() for each record in turn.
+
+ The record function is passed (dst, dst_size, fmtstr, index, rec_vars) and should return snprnf(dst, dst_size, fmtstr, <arguments for record[index]>).
+ It is called twice for each record, first with dst==NULL to measure the length, and it must produce the same output both times.
+
+ Example:
+
+	static int print_rec(char* dst, size_t dst_size, const char* fmtstr, size_t idx, void* recs)
+	{
+		struct rec_struct* rec = &((struct rec_struct*)recs)[idx];
+		return snprnf(dst, dst_size, fmtstr, rec->id, rec->name, rec->value);
+	}
+
+	txt = prnf_batch("%u,%s,%f\n", rec_count, print_rec, recs, 0, &txt_len);
+
+ If threads is 0 the number of online processors is used.
+ Returns the null terminated output allocated with malloc() (to be free()'d by the caller), or NULL on failure.
+ The output length is written to *len (if not NULL).
+
+-------------------------------------------------------------------------------------
+# Asynchronous writer
+
+ A block handler for blkprnf() which keeps slow destinations (files on slow storage etc..) from stalling the caller.
+ It owns two buffers and a writer thread. Callers copy their output into the active buffer, while the writer thread writes the other buffer to the file descriptor.
+ The buffers are swapped when the active buffer reaches flush_size bytes, or flush_ms after data was first placed in it.
+
+	struct prnf_async_struct log;
+	prnf_async_open(&log, fd, 64*1024, 16*1024, 100);
+	blkprnf(prnf_async_blk, &log, "Fred is %i years old\n", freds_age);
+	...
+	prnf_async_close(&log);		// writes remaining output, stops the writer thread, frees the buffers
+
+ If the active buffer is full, callers wait for the writer (backpressure), this is recorded in the statistics.
+ prnf_async_flush() is a fence, returning once all output passed to prnf_async_blk() before the call has been written.
+ prnf_async_crash_flush() is for signal handlers and crash paths, it writes any unwritten output without locking or waiting for the writer thread.
+
+-------------------------------------------------------------------------------------
+# io_uring writer (Linux)
+
+ A block handler for blkprnf() which never blocks in write().
+ Output is copied into one of a set of buffers registered with io_uring as fixed buffers.
+ When a buffer fills it is submitted as a single asynchronous write, and the caller continues with the next free buffer.
+ Buffers are recycled as their writes complete, the caller only waits if every buffer is in flight.
+
+	struct prnf_uring_struct log;
+	prnf_uring_open(&log, fd, 8, 64*1024);		// 8 buffers of 64k
+	blkprnf(prnf_uring_blk, &log, "Fred is %i years old\n", freds_age);
+	...
+	prnf_uring_close(&log);						// submits the partly filled buffer and waits for all writes
+
+ Output stays in the partly filled buffer until it fills, prnf_uring_flush() submits it and waits for all writes to complete.
+ If io_uring is not available (not Linux, old kernel, or disabled), prnf_uring_open() falls back to blocking write()s of full buffers,
+ prnf_uring_is_async() reports which is in use.
+ If the kernel refuses a submission (ie. out of memory), that buffer is written with blocking writes instead.
+ Writes to regular files are placed by offset and may complete in any order. For pipes, sockets and O_APPEND files, one write is in flight at a time to preserve order.
+ The file offset is moved to the end of the output by prnf_uring_flush() and prnf_uring_close(), so the fd can be written to directly afterwards, either way.
+
+-------------------------------------------------------------------------------------
+# Shared memory transport
+
+ A block handler for blkprnf() which passes output from many processes to a collector process, through a lock-free ring in a POSIX shared memory segment.
+ Producers never make a system call to output a message, a record is reserved with a compare and swap, copied in, and published.
+ The collector drains the ring to a file descriptor in large writes. tools/prnf_collect is a ready made collector.
+
+	// collector
+	struct prnf_shm_struct ring;
+	prnf_shm_create(&ring, "/myapp_log", 1024*1024);
+	while(running)
+		if(!prnf_shm_collect(&ring, fd))
+			usleep(10000);
+	prnf_shm_close(&ring);		// also removes the segment
+
+	// producers
+	struct prnf_shm_struct log;
+	prnf_shm_open(&log, "/myapp_log");
+	blkprnf(prnf_shm_blk, &log, "Fred is %i years old\n", freds_age);
+
+ The ring is made of fixed size slots (PRNF_SHM_SLOT_SIZE, default 256 bytes), each block passed to prnf_shm_blk() becomes one record of one or more slots.
+ Records from different processes are interleaved whole, so lines are kept intact as long as they fit within PRNF_BLK_SIZE.
+ If the ring is full the record is dropped and counted, producers never wait for the collector.
+ If a producer dies part way through writing a record, the collector skips the record once the process no longer exists,
+ and counts it as lost. The producer's pid is only recorded a few instructions after the reservation, if it dies in between
+ the collector waits PRNF_SHM_STUCK_MS (default 1000) before skipping the record.
+ A producer claims it's record before writing any of it. A record which has not been claimed is also skipped after PRNF_SHM_STUCK_MS
+ if the producer's pid can not be signalled (another user's process), the producer's claim then fails and it writes nothing.
+ A claimed record is only skipped once it's producer no longer exists, so a stalled producer never writes to slots which have been reused.
+
+-------------------------------------------------------------------------------------
+# Unix domain datagram sink
+
+ A block handler for blkprnf() which sends each line of output as one datagram, to a local log daemon listening on a SOCK_DGRAM unix socket.
+ Lines are accumulated, and sent together with a single sendmmsg() call when batch lines are waiting, or latency_ms after the first of them.
+
+	struct prnf_dgram_struct log;
+	prnf_dgram_open(&log, "/run/mylogd.sock", 32, 1024, 5);	// batches of up to 32 lines of up to 1024 bytes, held for at most 5ms
+	blkprnf(prnf_dgram_blk, &log, "Fred is %i years old\n", freds_age);
+	...
+	prnf_dgram_close(&log);		// sends what remains, including any incomplete line
+
+ The '\n' ending each line is not sent. Lines longer than the message size are truncated (and counted).
+ A thread handles the latency bound, with latency_ms 0 there is no thread and lines are sent when the batch fills, or by prnf_dgram_flush().
+ If the daemon's queue is full (net.unix.max_dgram_qlen, 10 by default on Linux) the send waits for it to drain, for up to PRNF_DGRAM_WAIT_MS (default 100).
+ Messages still unsent after that are dropped and counted, and further sends do not wait until one succeeds, so a stalled daemon only stalls the callers once.
+ If the daemon is not running the batch is dropped and counted.
+
+-------------------------------------------------------------------------------------
+# Memory mapped segment files
+
+ A block handler for blkprnf() which appends to a series of preallocated, memory mapped files, with no write() system calls.
+ Callers reserve space with an atomic add to the append cursor, and copy their output straight into the page cache.
+ When a segment fills, the caller which overflowed it creates and maps the next, other callers carry on as soon as it is in place.
+
+	struct prnf_mmap_struct log;
+	prnf_mmap_open(&log, "/var/log/myapp", 16*1024*1024);	// myapp.000000, myapp.000001 .. of 16MB each
+	blkprnf(prnf_mmap_blk, &log, "Fred is %i years old\n", freds_age);
+	...
+	prnf_mmap_close(&log);
+
+ Segments are numbered from the first unused number, so an existing set is continued.
+ The active segment is preallocated to it's full size, the unwritten part reads as zeros.
+ Once every caller has finished with a full segment, it is truncated to the length written and made read-only, which marks it complete.
+
+ A reader can follow the segments while they are written:
+
+	struct prnf_mmap_reader_struct tail;
+	prnf_mmap_reader_open(&tail, "/var/log/myapp", 0);
+	while(running)
+		if(!(len = prnf_mmap_read(&tail, buf, sizeof(buf))))
+			usleep(10000);
+		else
+			...
+
+ prnf_mmap_read() returns output up to the first unwritten byte, and moves to the next segment at the end of a complete one.
+ Output should not contain zero bytes.
+
+-------------------------------------------------------------------------------------
+# Flight recorder file
+
+ Maps a file for use as the region of a flight recorder (see prnf_sink.h), so that the records survive a crash of the process.
+
+	region = prnf_flight_map("/var/tmp/myapp.flight", 64*1024);
+	prnf_flight_init(&flight, region, 64*1024, true);
+
+ The file is created, or extended, to size bytes. After a crash, map it again and use prnf_flight_recover().
+
+*/
+
+#ifndef _PRNF_POSIX_H_
+#define _PRNF_POSIX_H_
+
+	#include <stddef.h>
+	#include <stdbool.h>
+	#include <stdint.h>
+	#include <pthread.h>
+	#include <sys/uio.h>
+	#include "prnf.h"
+
+	#ifdef __cplusplus
+	extern "C" {
+	#endif
+
+//********************************************************************************************************
+// Public defines
+//********************************************************************************************************
+
+	struct prnf_async_stats_struct
+	{
+		uint64_t bytes;			// bytes written
+		uint64_t writes;		// buffers written
+		uint64_t errors;		// failed writes, the output is dropped
+		uint64_t stalls;		// number of times a caller waited for buffer space
+		uint64_t stall_ns;		// total time callers spent waiting
+		size_t peak;			// highest buffer fill
+	};
+
+	struct prnf_async_struct
+	{
+		int fd;
+		size_t buf_size;
+		size_t flush_size;
+		unsigned flush_ms;
+		char* buf[2];
+		int active;				// index of buffer being filled by callers
+		size_t len;				// length of active buffer
+		size_t write_len;		// length of the buffer being written
+		uint64_t submitted;		// total bytes passed in by callers
+		uint64_t written;		// total bytes handled by the writer
+		int waiting;			// callers waiting for space or a fence
+		bool writing;
+		bool stop;
+		struct timespec first;	// time at which data was placed in the empty active buffer
+		pthread_mutex_t lock;
+		pthread_cond_t wake;	// signals the writer thread
+		pthread_cond_t done;	// signals callers waiting for the writer
+		pthread_t thread;
+		struct prnf_async_stats_struct stats;
+	};
+
+//	Per buffer state for the io_uring writer
+	struct prnf_uring_buf_struct
+	{
+		size_t len;				// bytes in the buffer
+		size_t done;			// bytes written so far
+		int64_t offset;			// file offset of the buffer, or -1
+		int next_free;			// free list link
+	};
+
+	struct prnf_uring_struct
+	{
+		int fd;
+		int ring_fd;			// -1 if io_uring is not in use
+		bool seekable;			// false for pipes, sockets and O_APPEND files
+		int64_t offset;			// offset of the next buffer in the file
+		unsigned buf_count;
+		size_t buf_size;
+		char* mem;				// buf_count * buf_size, registered as fixed buffers
+		struct prnf_uring_buf_struct* bufs;
+		int cur;				// buffer being filled, or -1
+		int free_list;
+		unsigned in_flight;
+		uint64_t writes;		// writes submitted
+		uint64_t waits;			// times a caller waited for a free buffer
+		uint64_t errors;		// failed writes, the output is dropped
+		pthread_mutex_t lock;
+		// io_uring rings
+		void* sq_map;
+		size_t sq_map_size;
+		void* cq_map;
+		size_t cq_map_size;
+		void* sqes;
+		size_t sqes_size;
+		unsigned* sq_head;
+		unsigned* sq_tail;
+		unsigned* sq_mask;
+		unsigned* sq_array;
+		unsigned* cq_head;
+		unsigned* cq_tail;
+		unsigned* cq_mask;
+		void* cqes;
+	};
+
+	struct prnf_shm_stats_struct
+	{
+		uint64_t records;		// records collected
+		uint64_t bytes;			// bytes collected
+		uint64_t dropped;		// records dropped by producers because the ring was full
+		uint64_t lost;			// records skipped because their producer died while writing them
+		uint64_t errors;		// failed writes by the collector, the output is dropped
+	};
+
+	struct prnf_shm_struct
+	{
+		const char* name;
+		void* ring;				// the mapped segment
+		size_t map_size;
+		bool collector;			// created by prnf_shm_create()
+		uint64_t tail;			// next slot to collect
+		char* out;				// collector output buffer
+		size_t out_len;
+		uint64_t stuck_pos;		// 1 + slot being waited on, which may belong to a dead producer
+		struct timespec stuck_since;
+		struct prnf_shm_stats_struct stats;
+	};
+
+	struct prnf_dgram_stats_struct
+	{
+		uint64_t messages;		// datagrams sent
+		uint64_t batches;		// calls to sendmmsg()
+		uint64_t dropped;		// messages which could not be sent
+		uint64_t truncated;		// lines longer than the message size
+	};
+
+	struct prnf_dgram_struct
+	{
+		int fd;
+		unsigned batch;
+		size_t msg_size;
+		unsigned latency_ms;
+		char* buf;				// batch messages of msg_size
+		void* msgs;				// batch message headers for sendmmsg()
+		struct iovec* iov;		// iov[i].iov_len is the length of message i
+		unsigned count;			// complete messages waiting, message count is being filled
+		bool truncating;
+		bool stop;
+		bool stalled;			// a send timed out, don't wait again until one succeeds
+		struct timespec first;	// time at which the first waiting message was completed
+		pthread_mutex_t lock;
+		pthread_cond_t wake;
+		pthread_t thread;
+		struct prnf_dgram_stats_struct stats;
+	};
+
+	struct prnf_mmap_seg_struct
+	{
+		struct prnf_mmap_seg_struct* next;
+		char* map;
+		size_t size;
+		int fd;
+		uint64_t cursor;		// next offset to reserve, may run past the end once full
+		uint64_t used;			// length written, once full
+		unsigned writers;		// callers using the mapping, and flags set once the segment is replaced and completed
+	};
+
+	struct prnf_mmap_stats_struct
+	{
+		uint64_t bytes;			// bytes appended
+		uint64_t segments;		// segments created
+		uint64_t dropped;		// bytes which could not be written, because a new segment could not be created
+	};
+
+	struct prnf_mmap_struct
+	{
+		const char* base;
+		size_t seg_size;
+		unsigned index;			// number of the active segment
+		struct prnf_mmap_seg_struct* seg;		// the active segment
+		struct prnf_mmap_seg_struct* segs;		// all segments, freed by prnf_mmap_close()
+		pthread_mutex_t lock;	// held while replacing a segment
+		struct prnf_mmap_stats_struct stats;
+	};
+
+	struct prnf_mmap_reader_struct
+	{
+		const char* base;
+		unsigned index;			// number of the segment being read
+		int fd;
+		uint64_t pos;
+	};
+
+//********************************************************************************************************
+// Public prototypes
+//********************************************************************************************************
+
+//	Format count records into one buffer using a pool of threads (see above).
+	char* prnf_batch(const char* fmtstr, size_t count, int(*rec_fn)(char*, size_t, const char*, size_t, void*), void* rec_vars, int threads, size_t* len);
+
+//	Start an asynchronous writer to fd, with two buffers of buf_size. flush_size must not exceed buf_size. Returns 0 on success.
+	int prnf_async_open(struct prnf_async_struct* async, int fd, size_t buf_size, size_t flush_size, unsigned flush_ms);
+
+//	Block handler for blkprnf(), pass the struct prnf_async_struct* as blk_vars.
+	void prnf_async_blk(void* async, const char* blk, size_t len);
+
+//	Wait until all output passed in before this call has been written.
+	void prnf_async_flush(struct prnf_async_struct* async);
+
+//	Write unwritten output directly, without locking or waiting. For signal handlers and crash paths only.
+	void prnf_async_crash_flush(struct prnf_async_struct* async);
+
+//	Copy of the statistics
+	struct prnf_async_stats_struct prnf_async_stats(struct prnf_async_struct* async);
+
+//	Write remaining output, stop the writer thread and free the buffers. The file descriptor is not closed.
+	void prnf_async_close(struct prnf_async_struct* async);
+
+//	Start an io_uring writer to fd with buf_count buffers of buf_size, falling back to blocking writes if io_uring is unavailable. Returns 0 on success.
+	int prnf_uring_open(struct prnf_uring_struct* uring, int fd, unsigned buf_count, size_t buf_size);
+
+//	Block handler for blkprnf(), pass the struct prnf_uring_struct* as blk_vars.
+	void prnf_uring_blk(void* uring, const char* blk, size_t len);
+
+//	Submit the partly filled buffer, and wait for all writes to complete. The file offset of a regular file is left at the end of the output.
+	void prnf_uring_flush(struct prnf_uring_struct* uring);
+
+//	true if io_uring is in use, false if blocking writes are used.
+	bool prnf_uring_is_async(struct prnf_uring_struct* uring);
+
+//	Flush, then release the ring and buffers. The file descriptor is not closed.
+	void prnf_uring_close(struct prnf_uring_struct* uring);
+
+//	Create (or re-create) the shared memory segment name of about size bytes, as the collector. Returns 0 on success or an errno value.
+	int prnf_shm_create(struct prnf_shm_struct* shm, const char* name, size_t size);
+
+//	Attach to an existing segment as a producer. Returns 0 on success or an errno value.
+	int prnf_shm_open(struct prnf_shm_struct* shm, const char* name);
+
+//	Block handler for blkprnf(), pass the struct prnf_shm_struct* as blk_vars.
+	void prnf_shm_blk(void* shm, const char* blk, size_t len);
+
+//	Write all published records to fd, skipping records abandoned by dead producers. Returns the number of bytes collected.
+	size_t prnf_shm_collect(struct prnf_shm_struct* shm, int fd);
+
+//	Copy of the statistics, dropped is read from the segment and is available to producers and the collector.
+	struct prnf_shm_stats_struct prnf_shm_stats(struct prnf_shm_struct* shm);
+
+//	Unmap the segment. For the collector this also removes it.
+	void prnf_shm_close(struct prnf_shm_struct* shm);
+
+//	Connect to the unix datagram socket at path, sending up to batch lines of up to msg_size bytes per sendmmsg(). Returns 0 on success or an errno value.
+	int prnf_dgram_open(struct prnf_dgram_struct* dgram, const char* path, unsigned batch, size_t msg_size, unsigned latency_ms);
+
+//	Block handler for blkprnf(), pass the struct prnf_dgram_struct* as blk_vars.
+	void prnf_dgram_blk(void* dgram, const char* blk, size_t len);
+
+//	Send the complete lines waiting now.
+	void prnf_dgram_flush(struct prnf_dgram_struct* dgram);
+
+//	Copy of the statistics
+	struct prnf_dgram_stats_struct prnf_dgram_stats(struct prnf_dgram_struct* dgram);
+
+//	Send what remains (an incomplete line as it's own message), stop the thread and close the socket.
+	void prnf_dgram_close(struct prnf_dgram_struct* dgram);
+
+//	Start appending to segment files named base.NNNNNN of seg_size bytes. Returns 0 on success or an errno value.
+	int prnf_mmap_open(struct prnf_mmap_struct* mm, const char* base, size_t seg_size);
+
+//	Block handler for blkprnf(), pass the struct prnf_mmap_struct* as blk_vars.
+	void prnf_mmap_blk(void* mm, const char* blk, size_t len);
+
+//	Copy of the statistics
+	struct prnf_mmap_stats_struct prnf_mmap_stats(struct prnf_mmap_struct* mm);
+
+//	Complete the active segment and release everything. No other thread may be using the sink.
+	void prnf_mmap_close(struct prnf_mmap_struct* mm);
+
+//	Prepare to read the segments named base.NNNNNN, starting with segment number index.
+	void prnf_mmap_reader_open(struct prnf_mmap_reader_struct* reader, const char* base, unsigned index);
+
+//	Read up to size bytes of new output, returns 0 if there is none.
+	size_t prnf_mmap_read(struct prnf_mmap_reader_struct* reader, char* dst, size_t size);
+
+	void prnf_mmap_reader_close(struct prnf_mmap_reader_struct* reader);
+
+//	Map size bytes of the file at path (created if needed) for a flight recorder region. Returns NULL on failure, release with munmap().
+	void* prnf_flight_map(const char* path, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // _PRNF_POSIX_H_
+
+
+
+
+
+//********************************************************************************************************
+//
+// PRNF POSIX Implementation
+//
+//********************************************************************************************************
+#ifdef PRNF_POSIX_IMPLEMENTATION
+#ifndef _PRNF_POSIX_IMPLEMENTED_
+#define _PRNF_POSIX_IMPLEMENTED_
+
+	#include <stdbool.h>
+	#include <stdint.h>
+	#include <stdlib.h>
+	#include <string.h>
+	#include <pthread.h>
+	#include <unistd.h>
+	#include <errno.h>
+	#include <time.h>
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/uio.h>
+	#include <sys/stat.h>
+	#include <signal.h>
+	#include <sys/socket.h>
+	#include <sys/un.h>
+	#include <poll.h>
+
+	#ifdef __linux__
+		#include <sys/syscall.h>
+		#include <linux/io_uring.h>
+	#endif
+
+//********************************************************************************************************
+// Local defines
+//********************************************************************************************************
+
+//	Minimum number of records handled by each batch thread, below this fewer threads are used.
+	#ifndef PRNF_BATCH_MIN_RECS
+		#define PRNF_BATCH_MIN_RECS	1024
+	#endif
+
+//	Records shorter than this are printed via the stack when they end a chunk.
+	#define BATCH_TAIL_SIZE	256
+
+	struct batch_job_struct
+	{
+		const char* fmtstr;
+		int(*rec_fn)(char*, size_t, const char*, size_t, void*);
+		void* rec_vars;
+		char* out;
+		bool measured;		// false for the measuring pass, true for the printing pass
+	};
+
+//	Slot size of the shared memory ring, including an 16 byte header. Producers use the size recorded in the segment.
+	#ifndef PRNF_SHM_SLOT_SIZE
+		#define PRNF_SHM_SLOT_SIZE	256
+	#endif
+
+//	Time to wait on a reserved record with no producer pid, before it is considered abandoned.
+	#ifndef PRNF_SHM_STUCK_MS
+		#define PRNF_SHM_STUCK_MS	1000
+	#endif
+
+//	Time to wait for a full datagram queue to drain, before the unsent messages are dropped.
+	#ifndef PRNF_DGRAM_WAIT_MS
+		#define PRNF_DGRAM_WAIT_MS	100
+	#endif
+
+//	Set in prnf_mmap_seg_struct.writers once a segment has been replaced, and once it has been completed
+	#define MMAP_RETIRED	0x80000000U
+	#define MMAP_COMPLETE	0x40000000U
+
+//	Segment file name, base + "." + 6 digits
+	#define MMAP_NAME_FMT	"%s.%06u"
+
+	#define SHM_MAGIC		0x666E7270	// "prnf"
+	#define SHM_TAKEN		2			// first slot seq offsets, of a record taken back by the collector, and of one being written
+	#define SHM_WRITING		3
+	#define SHM_LINE		64
+	#define SHM_OUT_SIZE	(64*1024)
+
+//	A contiguous range of records handled by one thread
+	struct batch_chunk_struct
+	{
+		struct batch_job_struct* job;
+		pthread_t thread;
+		size_t first;
+		size_t end;
+		size_t pos;			// position of the first record in the output
+		size_t len;			// total length of the chunk
+		size_t tail_len;	// length of the last record in the chunk
+		bool failed;
+	};
+
+//	Same layout as struct mmsghdr, which is only declared with _GNU_SOURCE
+	struct dgram_msg_struct
+	{
+		struct msghdr msg_hdr;
+		unsigned int msg_len;
+	};
+
+//	Start of the shared memory segment, the slots follow.
+//	head is shared by the producers and kept away from the read mostly fields.
+	struct shm_ring_struct
+	{
+		uint32_t magic;			// written last by the collector
+		uint32_t slot_size;
+		uint64_t slot_count;	// a power of 2
+		uint64_t dropped;
+		char pad0[SHM_LINE - 24];
+		uint64_t head;			// next slot to reserve
+		char pad1[SHM_LINE - 8];
+	};
+
+//	Header at the start of each slot.
+//	A free slot at position pos has seq==pos. Once reserved, the producer claims the record by setting the first slot's seq to pos+SHM_WRITING,
+//	writes it and publishes it by setting seq to pos+1. The collector frees it for the next lap by setting seq to pos+slot_count.
+//	A record the collector gives up on has seq pos+SHM_TAKEN.
+	struct shm_slot_struct
+	{
+		uint64_t seq;
+		uint32_t pid;			// producer of the record (first slot only), 0 until set
+		uint16_t len;			// bytes in this slot
+		uint16_t count;			// slots in the record (first slot only)
+	};
+
+//********************************************************************************************************
+// Private variables
+//********************************************************************************************************
+
+	static pid_t shm_pid;		// cached, as getpid() is a system call
+	static pthread_once_t shm_pid_once = PTHREAD_ONCE_INIT;
+
+//********************************************************************************************************
+// Private prototypes
+//********************************************************************************************************
+
+	static bool batch_run(struct batch_chunk_struct* chunks, int threads);
+	static void* batch_thread(void* chunk_vp);
+	static void batch_measure(struct batch_chunk_struct* chunk);
+	static void batch_print(struct batch_chunk_struct* chunk);
+
+	static void* async_thread(void* async_vp);
+	static bool async_should_swap(struct prnf_async_struct* async);
+	static bool write_all(int fd, const char* src, size_t len);
+	static uint64_t elapsed_ns(const struct timespec* since);
+
+	static bool uring_setup(struct prnf_uring_struct* uring);
+	static void uring_teardown(struct prnf_uring_struct* uring);
+	static void uring_submit(struct prnf_uring_struct* uring, int buf_idx);
+	static void uring_submit_failed(struct prnf_uring_struct* uring, int buf_idx);
+	static void uring_write(struct prnf_uring_struct* uring, int buf_idx);
+	static void uring_reap(struct prnf_uring_struct* uring, bool wait);
+	static int uring_get_buf(struct prnf_uring_struct* uring);
+
+	static void shm_pid_init(void);
+	static void shm_pid_update(void);
+	static int shm_map(struct prnf_shm_struct* shm, int fd, size_t map_size);
+	static struct shm_slot_struct* shm_slot(struct shm_ring_struct* ring, uint64_t pos);
+	static size_t shm_max_record(struct shm_ring_struct* ring);
+	static unsigned shm_count(struct shm_ring_struct* ring, struct shm_slot_struct* slot);
+	static void shm_put(struct prnf_shm_struct* shm, const char* src, size_t len);
+	static bool shm_abandoned(struct prnf_shm_struct* shm, struct shm_slot_struct* slot, bool writing);
+	static void shm_release(struct prnf_shm_struct* shm, unsigned count);
+	static void shm_out(struct prnf_shm_struct* shm, int fd, const char* src, size_t len);
+
+	static void* dgram_thread(void* dgram_vp);
+	static void dgram_append(struct prnf_dgram_struct* dgram, const char* src, size_t len);
+	static void dgram_end(struct prnf_dgram_struct* dgram);
+	static void dgram_send(struct prnf_dgram_struct* dgram);
+
+	static int mmap_name(char** dst, const char* base, unsigned index);
+	static struct prnf_mmap_seg_struct* mmap_seg_create(struct prnf_mmap_struct* mm);
+	static void mmap_seg_complete(struct prnf_mmap_seg_struct* seg);
+	static void mmap_seg_leave(struct prnf_mmap_seg_struct* seg);
+	static bool mmap_rotate(struct prnf_mmap_struct* mm, struct prnf_mmap_seg_struct* full);
+	static bool mmap_append(struct prnf_mmap_struct* mm, const char* src, size_t len);
+
+//********************************************************************************************************
+// Public functions
+//********************************************************************************************************
+
+char* prnf_batch(const char* fmtstr, size_t count, int(*rec_fn)(char*, size_t, const char*, size_t, void*), void* rec_vars, int threads, size_t* len)
+{
+	struct batch_job_struct job = {.fmtstr=fmtstr, .rec_fn=rec_fn, .rec_vars=rec_vars};
+	struct batch_chunk_struct* chunks;
+	size_t total = 0;
+	size_t per_chunk;
+	bool ok;
+	int i;
+
+	if(threads <= 0)
+		threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if((size_t)threads > count/PRNF_BATCH_MIN_RECS)
+		threads = count/PRNF_BATCH_MIN_RECS;
+	if(threads < 1)
+		threads = 1;
+
+	chunks = calloc(threads, sizeof(struct batch_chunk_struct));
+	ok = !!chunks;
+
+	// divide the records evenly, the first (count % threads) chunks get one extra
+	if(ok)
+	{
+		per_chunk = count / threads;
+		for(i=0; i<threads; i++)
+		{
+			chunks[i].job = &job;
+			chunks[i].first = i? chunks[i-1].end : 0;
+			chunks[i].end = chunks[i].first + per_chunk + ((size_t)i < count % threads);
+		};
+		ok = batch_run(chunks, threads);
+	};
+
+	// prefix sum of the chunk lengths gives each chunks output position
+	if(ok)
+	{
+		for(i=0; i<threads; i++)
+		{
+			chunks[i].pos = total;
+			total += chunks[i].len;
+		};
+		job.out = malloc(total+1);
+		job.measured = true;
+		ok = !!job.out;
+	};
+
+	if(ok)
+	{
+		job.out[total] = 0;
+		ok = batch_run(chunks, threads);
+	};
+
+	if(!ok)
+	{
+		free(job.out);
+		job.out = NULL;
+	}
+	else if(len)
+		*len = total;
+
+	free(chunks);
+	return job.out;
+}
+
+int prnf_async_open(struct prnf_async_struct* async, int fd, size_t buf_size, size_t flush_size, unsigned flush_ms)
+{
+	pthread_condattr_t attr;
+	int err;
+
+	memset(async, 0, sizeof(struct prnf_async_struct));
+	async->fd = fd;
+	async->buf_size = buf_size;
+	async->flush_size = (flush_size && flush_size <= buf_size)? flush_size : buf_size;
+	async->flush_ms = flush_ms;
+	async->buf[0] = malloc(buf_size);
+	async->buf[1] = malloc(buf_size);
+	err = (!buf_size || !async->buf[0] || !async->buf[1])? ENOMEM : 0;
+
+	if(!err)
+	{
+		pthread_mutex_init(&async->lock, NULL);
+		pthread_condattr_init(&attr);
+		pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+		pthread_cond_init(&async->wake, &attr);
+		pthread_condattr_destroy(&attr);
+		pthread_cond_init(&async->done, NULL);
+		err = pthread_create(&async->thread, NULL, async_thread, async);
+		if(err)
+		{
+			pthread_cond_destroy(&async->done);
+			pthread_cond_destroy(&async->wake);
+			pthread_mutex_destroy(&async->lock);
+		};
+	};
+
+	if(err)
+	{
+		free(async->buf[0]);
+		free(async->buf[1]);
+		async->buf[0] = async->buf[1] = NULL;
+	};
+
+	return err;
+}
+
+void prnf_async_blk(void* async_vp, const char* blk, size_t len)
+{
+	struct prnf_async_struct* async = async_vp;
+	struct timespec stall_start;
+	size_t part;
+
+	pthread_mutex_lock(&async->lock);
+	while(len)
+	{
+		// wait for space, blocks larger than the buffer are passed in parts
+		part = (len < async->buf_size)? len : async->buf_size;
+		if(async->len + part > async->buf_size)
+		{
+			clock_gettime(CLOCK_MONOTONIC, &stall_start);
+			async->stats.stalls++;
+			async->waiting++;
+			while(async->len + part > async->buf_size)
+			{
+				pthread_cond_signal(&async->wake);
+				pthread_cond_wait(&async->done, &async->lock);
+			};
+			async->waiting--;
+			async->stats.stall_ns += elapsed_ns(&stall_start);
+		};
+
+		if(!async->len)
+			clock_gettime(CLOCK_MONOTONIC, &async->first);
+
+		memcpy(&async->buf[async->active][async->len], blk, part);
+		async->len += part;
+		async->submitted += part;
+		blk += part;
+		len -= part;
+
+		if(async->len > async->stats.peak)
+			async->stats.peak = async->len;
+		if(async->len >= async->flush_size || async->len == part)	// also wake for the timer
+			pthread_cond_signal(&async->wake);
+	};
+	pthread_mutex_unlock(&async->lock);
+}
+
+void prnf_async_flush(struct prnf_async_struct* async)
+{
+	uint64_t target;
+
+	pthread_mutex_lock(&async->lock);
+	target = async->submitted;
+	async->waiting++;
+	while(async->written < target)
+	{
+		pthread_cond_signal(&async->wake);
+		pthread_cond_wait(&async->done, &async->lock);
+	};
+	async->waiting--;
+	pthread_mutex_unlock(&async->lock);
+}
+
+// The buffer being written by the writer thread may be partly written already, so some output may be repeated.
+void prnf_async_crash_flush(struct prnf_async_struct* async)
+{
+	if(async->writing)
+		write_all(async->fd, async->buf[!async->active], async->write_len);
+	write_all(async->fd, async->buf[async->active], async->len);
+	async->len = 0;
+}
+
+struct prnf_async_stats_struct prnf_async_stats(struct prnf_async_struct* async)
+{
+	struct prnf_async_stats_struct stats;
+
+	pthread_mutex_lock(&async->lock);
+	stats = async->stats;
+	pthread_mutex_unlock(&async->lock);
+
+	return stats;
+}
+
+void prnf_async_close(struct prnf_async_struct* async)
+{
+	if(!async->buf[0])
+		return;
+
+	pthread_mutex_lock(&async->lock);
+	async->stop = true;
+	pthread_cond_signal(&async->wake);
+	pthread_mutex_unlock(&async->lock);
+
+	pthread_join(async->thread, NULL);
+
+	pthread_cond_destroy(&async->done);
+	pthread_cond_destroy(&async->wake);
+	pthread_mutex_destroy(&async->lock);
+	free(async->buf[0]);
+	free(async->buf[1]);
+	async->buf[0] = async->buf[1] = NULL;
+}
+
+int prnf_uring_open(struct prnf_uring_struct* uring, int fd, unsigned buf_count, size_t buf_size)
+{
+	unsigned i;
+	off_t offset;
+	int flags;
+
+	memset(uring, 0, sizeof(struct prnf_uring_struct));
+	uring->fd = fd;
+	uring->ring_fd = -1;
+	uring->cur = -1;
+	uring->buf_count = buf_count? buf_count : 1;
+	uring->buf_size = buf_size;
+	uring->mem = malloc(uring->buf_count * buf_size);
+	uring->bufs = calloc(uring->buf_count, sizeof(struct prnf_uring_buf_struct));
+	if(!buf_size || !uring->mem || !uring->bufs)
+	{
+		free(uring->mem);
+		free(uring->bufs);
+		uring->mem = NULL;
+		return ENOMEM;
+	};
+
+	for(i=0; i<uring->buf_count; i++)
+		uring->bufs[i].next_free = i+1 < uring->buf_count? (int)i+1 : -1;
+	uring->free_list = 0;
+
+	offset = lseek(fd, 0, SEEK_CUR);
+	flags = fcntl(fd, F_GETFL);
+	uring->seekable = (offset >= 0 && flags >= 0 && !(flags & O_APPEND));
+	uring->offset = uring->seekable? offset : -1;
+
+	pthread_mutex_init(&uring->lock, NULL);
+
+	if(!uring_setup(uring))
+		uring_teardown(uring);
+
+	return 0;
+}
+
+void prnf_uring_blk(void* uring_vp, const char* blk, size_t len)
+{
+	struct prnf_uring_struct* uring = uring_vp;
+	struct prnf_uring_buf_struct* buf;
+	size_t part;
+
+	pthread_mutex_lock(&uring->lock);
+
+	// recycle any completed buffers, without a system call
+	if(uring->in_flight)
+		uring_reap(uring, false);
+
+	while(len)
+	{
+		if(uring->cur < 0)
+			uring->cur = uring_get_buf(uring);
+
+		buf = &uring->bufs[uring->cur];
+		part = uring->buf_size - buf->len;
+		if(part > len)
+			part = len;
+		memcpy(&uring->mem[uring->cur * uring->buf_size + buf->len], blk, part);
+		buf->len += part;
+		blk += part;
+		len -= part;
+
+		if(buf->len == uring->buf_size)
+		{
+			uring_write(uring, uring->cur);
+			uring->cur = -1;
+		};
+	};
+
+	pthread_mutex_unlock(&uring->lock);
+}
+
+void prnf_uring_flush(struct prnf_uring_struct* uring)
+{
+	pthread_mutex_lock(&uring->lock);
+
+	if(uring->cur >= 0 && uring->bufs[uring->cur].len)
+	{
+		uring_write(uring, uring->cur);
+		uring->cur = -1;
+	};
+
+	while(uring->in_flight)
+		uring_reap(uring, true);
+
+	// positioned writes do not move the file offset, leave it after the output as write() would have
+	if(uring->ring_fd >= 0 && uring->seekable)
+		lseek(uring->fd, uring->offset, SEEK_SET);
+
+	pthread_mutex_unlock(&uring->lock);
+}
+
+bool prnf_uring_is_async(struct prnf_uring_struct* uring)
+{
+	return uring->ring_fd >= 0;
+}
+
+void prnf_uring_close(struct prnf_uring_struct* uring)
+{
+	if(!uring->mem)
+		return;
+
+	prnf_uring_flush(uring);
+	uring_teardown(uring);
+	pthread_mutex_destroy(&uring->lock);
+	free(uring->mem);
+	free(uring->bufs);
+	uring->mem = NULL;
+	uring->bufs = NULL;
+}
+
+int prnf_shm_create(struct prnf_shm_struct* shm, const char* name, size_t size)
+{
+	struct shm_ring_struct* ring;
+	uint64_t slot_count = 2;
+	uint64_t pos;
+	int fd;
+	int err;
+
+	while(slot_count*2*PRNF_SHM_SLOT_SIZE <= size)
+		slot_count *= 2;
+
+	memset(shm, 0, sizeof(struct prnf_shm_struct));
+	shm->name = name;
+	shm->collector = true;
+	shm->out = malloc(SHM_OUT_SIZE);
+	if(!shm->out)
+		return ENOMEM;
+
+	shm_unlink(name);
+	fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	err = (fd < 0)? errno : 0;
+
+	if(!err && ftruncate(fd, sizeof(struct shm_ring_struct) + slot_count*PRNF_SHM_SLOT_SIZE))
+		err = errno;
+
+	if(!err)
+		err = shm_map(shm, fd, sizeof(struct shm_ring_struct) + slot_count*PRNF_SHM_SLOT_SIZE);
+
+	if(fd >= 0)
+		close(fd);
+
+	if(!err)
+	{
+		ring = shm->ring;
+		ring->slot_size = PRNF_SHM_SLOT_SIZE;
+		ring->slot_count = slot_count;
+		for(pos=0; pos<slot_count; pos++)
+			shm_slot(ring, pos)->seq = pos;
+		__atomic_store_n(&ring->magic, SHM_MAGIC, __ATOMIC_RELEASE);
+	}
+	else
+	{
+		if(fd >= 0)
+			shm_unlink(name);
+		free(shm->out);
+		shm->out = NULL;
+	};
+
+	return err;
+}
+
+int prnf_shm_open(struct prnf_shm_struct* shm, const char* name)
+{
+	struct shm_ring_struct* ring;
+	struct stat info;
+	int fd;
+	int err;
+
+	pthread_once(&shm_pid_once, shm_pid_init);
+
+	memset(shm, 0, sizeof(struct prnf_shm_struct));
+	shm->name = name;
+
+	fd = shm_open(name, O_RDWR, 0);
+	if(fd < 0)
+		return errno;
+
+	err = fstat(fd, &info)? errno : 0;
+	if(!err && (size_t)info.st_size < sizeof(struct shm_ring_struct))
+		err = EINVAL;
+	if(!err)
+		err = shm_map(shm, fd, info.st_size);
+	close(fd);
+
+	// check the collector has finished setting up the segment, and that it's geometry fits the mapping
+	if(!err)
+	{
+		ring = shm->ring;
+		if(__atomic_load_n(&ring->magic, __ATOMIC_ACQUIRE) != SHM_MAGIC
+		|| ring->slot_size <= sizeof(struct shm_slot_struct) || ring->slot_size > UINT16_MAX
+		|| ring->slot_count < 2 || (ring->slot_count & (ring->slot_count-1))
+		|| sizeof(struct shm_ring_struct) + ring->slot_count*ring->slot_size > shm->map_size)
+		{
+			munmap(shm->ring, shm->map_size);
+			shm->ring = NULL;
+			err = EINVAL;
+		};
+	};
+
+	return err;
+}
+
+void prnf_shm_blk(void* shm_vp, const char* blk, size_t len)
+{
+	struct prnf_shm_struct* shm = shm_vp;
+	size_t max = shm_max_record(shm->ring);
+	size_t part;
+
+	while(len)
+	{
+		part = (len < max)? len : max;
+		shm_put(shm, blk, part);
+		blk += part;
+		len -= part;
+	};
+}
+
+size_t prnf_shm_collect(struct prnf_shm_struct* shm, int fd)
+{
+	struct shm_ring_struct* ring = shm->ring;
+	struct shm_slot_struct* slot;
+	struct shm_slot_struct* part;
+	size_t payload = ring->slot_size - sizeof(struct shm_slot_struct);
+	size_t total = 0;
+	uint64_t seq;
+	uint64_t expected;
+	unsigned count;
+	unsigned i;
+
+	for(;;)
+	{
+		slot = shm_slot(ring, shm->tail);
+		seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+
+		if(seq == shm->tail+1)
+		{
+			count = shm_count(ring, slot);
+			for(i=0; i<count; i++)
+			{
+				part = shm_slot(ring, shm->tail + i);
+				shm_out(shm, fd, (char*)(part+1), (part->len < payload)? part->len : payload);
+				total += (part->len < payload)? part->len : payload;
+			};
+			shm->stats.records++;
+			shm_release(shm, count);
+		}
+		// reserved or being written, but not yet published
+		else if((seq == shm->tail || seq == shm->tail+SHM_WRITING) && __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) != shm->tail)
+		{
+			if(!shm_abandoned(shm, slot, seq == shm->tail+SHM_WRITING))
+				break;
+
+			// take the record back, unless it was claimed or published just now, a late claim will then fail
+			expected = seq;
+			if(__atomic_compare_exchange_n(&slot->seq, &expected, shm->tail+SHM_TAKEN, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			{
+				// without a pid, the producer may not have set the slot count
+				count = __atomic_load_n(&slot->pid, __ATOMIC_ACQUIRE)? shm_count(ring, slot) : 1;
+				shm->stats.lost++;
+				shm_release(shm, count);
+			};
+		}
+		else
+			break;
+	};
+
+	shm_out(shm, fd, NULL, 0);
+	shm->stats.bytes += total;
+	return total;
+}
+
+struct prnf_shm_stats_struct prnf_shm_stats(struct prnf_shm_struct* shm)
+{
+	struct prnf_shm_stats_struct stats = shm->stats;
+	struct shm_ring_struct* ring = shm->ring;
+
+	stats.dropped = __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+	return stats;
+}
+
+void prnf_shm_close(struct prnf_shm_struct* shm)
+{
+	if(shm->ring)
+		munmap(shm->ring, shm->map_size);
+	if(shm->collector)
+		shm_unlink(shm->name);
+	free(shm->out);
+	shm->ring = NULL;
+	shm->out = NULL;
+	shm->collector = false;
+}
+
+int prnf_dgram_open(struct prnf_dgram_struct* dgram, const char* path, unsigned batch, size_t msg_size, unsigned latency_ms)
+{
+	struct sockaddr_un addr = {.sun_family = AF_UNIX};
+	struct dgram_msg_struct* msgs;
+	pthread_condattr_t attr;
+	unsigned i;
+	int err = 0;
+
+	memset(dgram, 0, sizeof(struct prnf_dgram_struct));
+	dgram->batch = batch? batch : 1;
+	dgram->msg_size = msg_size;
+	dgram->latency_ms = latency_ms;
+	dgram->fd = -1;
+
+	if(!msg_size || strlen(path) >= sizeof(addr.sun_path))
+		return EINVAL;
+
+	dgram->buf = malloc(dgram->batch * msg_size);
+	dgram->msgs = calloc(dgram->batch, sizeof(struct dgram_msg_struct));
+	dgram->iov = calloc(dgram->batch, sizeof(struct iovec));
+	if(!dgram->buf || !dgram->msgs || !dgram->iov)
+		err = ENOMEM;
+
+	if(!err)
+	{
+		msgs = dgram->msgs;
+		for(i=0; i<dgram->batch; i++)
+		{
+			dgram->iov[i].iov_base = &dgram->buf[i * msg_size];
+			msgs[i].msg_hdr.msg_iov = &dgram->iov[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		};
+
+		strcpy(addr.sun_path, path);
+		dgram->fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+		if(dgram->fd < 0 || connect(dgram->fd, (struct sockaddr*)&addr, sizeof(addr)))
+			err = errno;
+	};
+
+	if(!err)
+	{
+		pthread_mutex_init(&dgram->lock, NULL);
+		pthread_condattr_init(&attr);
+		pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+		pthread_cond_init(&dgram->wake, &attr);
+		pthread_condattr_destroy(&attr);
+		if(latency_ms)
+			err = pthread_create(&dgram->thread, NULL, dgram_thread, dgram);
+		if(err)
+		{
+			pthread_cond_destroy(&dgram->wake);
+			pthread_mutex_destroy(&dgram->lock);
+		};
+	};
+
+	if(err)
+	{
+		if(dgram->fd >= 0)
+			close(dgram->fd);
+		free(dgram->buf);
+		free(dgram->msgs);
+		free(dgram->iov);
+		dgram->buf = NULL;
+		dgram->fd = -1;
+	};
+
+	return err;
+}
+
+void prnf_dgram_blk(void* dgram_vp, const char* blk, size_t len)
+{
+	struct prnf_dgram_struct* dgram = dgram_vp;
+	const char* eol;
+	size_t part;
+
+	pthread_mutex_lock(&dgram->lock);
+	while(len)
+	{
+		eol = memchr(blk, '\n', len);
+		part = eol? (size_t)(eol - blk) : len;
+		dgram_append(dgram, blk, part);
+		if(eol)
+		{
+			dgram_end(dgram);
+			part++;
+		};
+		blk += part;
+		len -= part;
+	};
+	pthread_mutex_unlock(&dgram->lock);
+}
+
+void prnf_dgram_flush(struct prnf_dgram_struct* dgram)
+{
+	pthread_mutex_lock(&dgram->lock);
+	dgram_send(dgram);
+	pthread_mutex_unlock(&dgram->lock);
+}
+
+struct prnf_dgram_stats_struct prnf_dgram_stats(struct prnf_dgram_struct* dgram)
+{
+	struct prnf_dgram_stats_struct stats;
+
+	pthread_mutex_lock(&dgram->lock);
+	stats = dgram->stats;
+	pthread_mutex_unlock(&dgram->lock);
+
+	return stats;
+}
+
+void prnf_dgram_close(struct prnf_dgram_struct* dgram)
+{
+	if(!dgram->buf)
+		return;
+
+	if(dgram->latency_ms)
+	{
+		pthread_mutex_lock(&dgram->lock);
+		dgram->stop = true;
+		pthread_cond_signal(&dgram->wake);
+		pthread_mutex_unlock(&dgram->lock);
+		pthread_join(dgram->thread, NULL);
+	};
+
+	if(dgram->iov[dgram->count].iov_len)
+		dgram_end(dgram);
+	dgram_send(dgram);
+
+	pthread_cond_destroy(&dgram->wake);
+	pthread_mutex_destroy(&dgram->lock);
+	close(dgram->fd);
+	free(dgram->buf);
+	free(dgram->msgs);
+	free(dgram->iov);
+	dgram->buf = NULL;
+	dgram->fd = -1;
+}
+
+int prnf_mmap_open(struct prnf_mmap_struct* mm, const char* base, size_t seg_size)
+{
+	char* name;
+	bool exists;
+	int err = 0;
+
+	memset(mm, 0, sizeof(struct prnf_mmap_struct));
+	mm->base = base;
+	mm->seg_size = seg_size;
+	if(!seg_size)
+		return EINVAL;
+
+	// continue after any existing segments
+	for(;;)
+	{
+		if(mmap_name(&name, base, mm->index))
+			return ENOMEM;
+		exists = !access(name, F_OK);
+		free(name);
+		if(!exists)
+			break;
+		mm->index++;
+	};
+
+	pthread_mutex_init(&mm->lock, NULL);
+	mm->seg = mmap_seg_create(mm);
+	if(!mm->seg)
+	{
+		err = errno;
+		pthread_mutex_destroy(&mm->lock);
+	};
+
+	return err;
+}
+
+void prnf_mmap_blk(void* mm_vp, const char* blk, size_t len)
+{
+	struct prnf_mmap_struct* mm = mm_vp;
+	size_t part;
+
+	while(len)
+	{
+		part = (len < mm->seg_size)? len : mm->seg_size;
+		if(mmap_append(mm, blk, part))
+			__atomic_fetch_add(&mm->stats.bytes, part, __ATOMIC_RELAXED);
+		else
+			__atomic_fetch_add(&mm->stats.dropped, part, __ATOMIC_RELAXED);
+		blk += part;
+		len -= part;
+	};
+}
+
+struct prnf_mmap_stats_struct prnf_mmap_stats(struct prnf_mmap_struct* mm)
+{
+	struct prnf_mmap_stats_struct stats;
+
+	stats.bytes = __atomic_load_n(&mm->stats.bytes, __ATOMIC_RELAXED);
+	stats.dropped = __atomic_load_n(&mm->stats.dropped, __ATOMIC_RELAXED);
+	pthread_mutex_lock(&mm->lock);
+	stats.segments = mm->stats.segments;
+	pthread_mutex_unlock(&mm->lock);
+
+	return stats;
+}
+
+void prnf_mmap_close(struct prnf_mmap_struct* mm)
+{
+	struct prnf_mmap_seg_struct* seg;
+
+	if(!mm->segs)
+		return;
+
+	mm->seg->used = (mm->seg->cursor < mm->seg_size)? mm->seg->cursor : mm->seg_size;
+	if(__atomic_fetch_or(&mm->seg->writers, MMAP_RETIRED, __ATOMIC_SEQ_CST) == 0)
+		mmap_seg_complete(mm->seg);
+
+	while(mm->segs)
+	{
+		seg = mm->segs;
+		mm->segs = seg->next;
+		free(seg);
+	};
+	mm->seg = NULL;
+	pthread_mutex_destroy(&mm->lock);
+}
+
+void prnf_mmap_reader_open(struct prnf_mmap_reader_struct* reader, const char* base, unsigned index)
+{
+	reader->base = base;
+	reader->index = index;
+	reader->fd = -1;
+	reader->pos = 0;
+}
+
+size_t prnf_mmap_read(struct prnf_mmap_reader_struct* reader, char* dst, size_t size)
+{
+	struct stat info;
+	char* name;
+	ssize_t len;
+	size_t zeros;
+	size_t i;
+	bool complete;
+
+	while(size)
+	{
+		if(reader->fd < 0)
+		{
+			if(mmap_name(&name, reader->base, reader->index))
+				return 0;
+			reader->fd = open(name, O_RDONLY | O_CLOEXEC);
+			free(name);
+			if(reader->fd < 0)
+				return 0;
+		};
+
+		// check for completion before reading, so that the data read from a complete segment is final
+		if(fstat(reader->fd, &info))
+			return 0;
+		complete = !(info.st_mode & (S_IWUSR | S_IWGRP | S_IWOTH));
+
+		len = pread(reader->fd, dst, size, reader->pos);
+		if(len < 0)
+			return 0;
+
+		for(i=0; i<(size_t)len && dst[i]; i++);
+		if(i)
+		{
+			reader->pos += i;
+			return i;
+		};
+
+		if(!complete)
+			return 0;
+
+		// a complete segment may have unwritten holes left by a caller which crashed, skip them
+		for(zeros=0; zeros<(size_t)len && !dst[zeros]; zeros++);
+		reader->pos += zeros;
+
+		if(!len)
+		{
+			close(reader->fd);
+			reader->fd = -1;
+			reader->index++;
+			reader->pos = 0;
+		};
+	};
+
+	return 0;
+}
+
+void prnf_mmap_reader_close(struct prnf_mmap_reader_struct* reader)
+{
+	if(reader->fd >= 0)
+		close(reader->fd);
+	reader->fd = -1;
+}
+
+void* prnf_flight_map(const char* path, size_t size)
+{
+	struct stat info;
+	void* region = NULL;
+	int fd;
+
+	fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if(fd < 0)
+		return NULL;
+
+	if(!fstat(fd, &info) && ((size_t)info.st_size >= size || !ftruncate(fd, size)))
+	{
+		region = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if(region == MAP_FAILED)
+			region = NULL;
+	};
+	close(fd);
+
+	return region;
+}
+
+//********************************************************************************************************
+// Private functions
+//********************************************************************************************************
+
+// run one pass over all chunks, the calling thread handles the first chunk
+static bool batch_run(struct batch_chunk_struct* chunks, int threads)
+{
+	bool ok = true;
+	int started;
+	int i;
+
+	for(started=1; started<threads; started++)
+	{
+		if(pthread_create(&chunks[started].thread, NULL, batch_thread, &chunks[started]))
+			break;
+	};
+
+	// if a thread could not be created, it's chunk is handled here instead
+	for(i=started; i<threads; i++)
+		batch_thread(&chunks[i]);
+	batch_thread(&chunks[0]);
+
+	for(i=1; i<started; i++)
+		pthread_join(chunks[i].thread, NULL);
+
+	for(i=0; i<threads; i++)
+		ok &= !chunks[i].failed;
+
+	return ok;
+}
+
+static void* batch_thread(void* chunk_vp)
+{
+	struct batch_chunk_struct* chunk = chunk_vp;
+
+	if(chunk->job->measured)
+		batch_print(chunk);
+	else
+		batch_measure(chunk);
+
+	return NULL;
+}
+
+static void batch_measure(struct batch_chunk_struct* chunk)
+{
+	struct batch_job_struct* job = chunk->job;
+	size_t idx;
+	int rec_len = 0;
+
+	chunk->len = 0;
+	for(idx = chunk->first; idx < chunk->end && !chunk->failed; idx++)
+	{
+		rec_len = job->rec_fn(NULL, 0, job->fmtstr, idx, job->rec_vars);
+		chunk->failed = (rec_len < 0);
+		chunk->len += rec_len;
+	};
+	chunk->tail_len = rec_len;
+}
+
+// Each record's terminator is overwritten by the following record.
+// The last record of a chunk would place it's terminator on the first character of the next chunk (being printed by another thread),
+// so it is printed elsewhere and copied into place.
+static void batch_print(struct batch_chunk_struct* chunk)
+{
+	struct batch_job_struct* job = chunk->job;
+	char* dst = &job->out[chunk->pos];
+	char* end = dst + chunk->len;
+	char stack_tail[BATCH_TAIL_SIZE];
+	char* tail;
+	size_t idx;
+
+	if(chunk->first == chunk->end)
+		return;
+
+	for(idx = chunk->first; idx < chunk->end-1; idx++)
+		dst += job->rec_fn(dst, end - dst + 1, job->fmtstr, idx, job->rec_vars);
+
+	tail = (chunk->tail_len < BATCH_TAIL_SIZE)? stack_tail : malloc(chunk->tail_len+1);
+	chunk->failed = !tail;
+	if(tail)
+	{
+		job->rec_fn(tail, chunk->tail_len+1, job->fmtstr, idx, job->rec_vars);
+		memcpy(dst, tail, chunk->tail_len);
+	};
+
+	if(tail != stack_tail)
+		free(tail);
+}
+
+// Writer thread, swaps the buffers when required and writes out the full one
+static void* async_thread(void* async_vp)
+{
+	struct prnf_async_struct* async = async_vp;
+	struct timespec deadline;
+	bool ok;
+
+	pthread_mutex_lock(&async->lock);
+	while(!async->stop || async->len)
+	{
+		while(!async_should_swap(async))
+		{
+			if(!async->len || !async->flush_ms)
+				pthread_cond_wait(&async->wake, &async->lock);
+			else
+			{
+				deadline = async->first;
+				deadline.tv_sec += async->flush_ms / 1000;
+				deadline.tv_nsec += (long)(async->flush_ms % 1000) * 1000000L;
+				if(deadline.tv_nsec >= 1000000000L)
+				{
+					deadline.tv_sec++;
+					deadline.tv_nsec -= 1000000000L;
+				};
+				if(pthread_cond_timedwait(&async->wake, &async->lock, &deadline) == ETIMEDOUT)
+					break;
+			};
+		};
+
+		if(!async->len)
+			continue;
+
+		async->write_len = async->len;
+		async->active = !async->active;
+		async->len = 0;
+		async->writing = true;
+		pthread_cond_broadcast(&async->done);	// space is now available
+		pthread_mutex_unlock(&async->lock);
+
+		ok = write_all(async->fd, async->buf[!async->active], async->write_len);
+
+		pthread_mutex_lock(&async->lock);
+		async->writing = false;
+		async->written += async->write_len;
+		async->stats.writes++;
+		if(ok)
+			async->stats.bytes += async->write_len;
+		else
+			async->stats.errors++;
+		pthread_cond_broadcast(&async->done);
+	};
+	pthread_mutex_unlock(&async->lock);
+
+	return NULL;
+}
+
+// true if the active buffer should be handed to the writer now
+static bool async_should_swap(struct prnf_async_struct* async)
+{
+	return async->stop
+		|| async->len >= async->flush_size
+		|| (async->len && async->waiting)
+		|| (async->len && async->flush_ms && elapsed_ns(&async->first) >= (uint64_t)async->flush_ms * 1000000U);
+}
+
+// write, handling partial writes and interruption
+static bool write_all(int fd, const char* src, size_t len)
+{
+	ssize_t written;
+
+	while(len)
+	{
+		written = write(fd, src, len);
+		if(written < 0 && errno == EINTR)
+			continue;
+		if(written <= 0)
+			return false;
+		src += written;
+		len -= written;
+	};
+
+	return true;
+}
+
+static uint64_t elapsed_ns(const struct timespec* since)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)(now.tv_sec - since->tv_sec) * 1000000000U + now.tv_nsec - since->tv_nsec;
+}
+
+// Create the ring, map it, and register the buffers. Returns false if io_uring is unavailable.
+static bool uring_setup(struct prnf_uring_struct* uring)
+{
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+	struct io_uring_params params;
+	struct iovec* iov;
+	unsigned i;
+	int err;
+
+	memset(&params, 0, sizeof(params));
+	uring->ring_fd = syscall(__NR_io_uring_setup, uring->buf_count, &params);
+	if(uring->ring_fd < 0)
+		return false;
+
+	uring->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	uring->cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if(params.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		if(uring->cq_map_size > uring->sq_map_size)
+			uring->sq_map_size = uring->cq_map_size;
+		uring->cq_map_size = 0;
+	};
+
+	uring->sq_map = mmap(NULL, uring->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring->ring_fd, IORING_OFF_SQ_RING);
+	if(uring->sq_map == MAP_FAILED)
+	{
+		uring->sq_map = NULL;
+		return false;
+	};
+
+	if(uring->cq_map_size)
+	{
+		uring->cq_map = mmap(NULL, uring->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring->ring_fd, IORING_OFF_CQ_RING);
+		if(uring->cq_map == MAP_FAILED)
+		{
+			uring->cq_map = NULL;
+			return false;
+		};
+	}
+	else
+		uring->cq_map = uring->sq_map;
+
+	uring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	uring->sqes = mmap(NULL, uring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring->ring_fd, IORING_OFF_SQES);
+	if(uring->sqes == MAP_FAILED)
+	{
+		uring->sqes = NULL;
+		return false;
+	};
+
+	uring->sq_head  = (unsigned*)((char*)uring->sq_map + params.sq_off.head);
+	uring->sq_tail  = (unsigned*)((char*)uring->sq_map + params.sq_off.tail);
+	uring->sq_mask  = (unsigned*)((char*)uring->sq_map + params.sq_off.ring_mask);
+	uring->sq_array = (unsigned*)((char*)uring->sq_map + params.sq_off.array);
+	uring->cq_head  = (unsigned*)((char*)uring->cq_map + params.cq_off.head);
+	uring->cq_tail  = (unsigned*)((char*)uring->cq_map + params.cq_off.tail);
+	uring->cq_mask  = (unsigned*)((char*)uring->cq_map + params.cq_off.ring_mask);
+	uring->cqes     = (char*)uring->cq_map + params.cq_off.cqes;
+
+	iov = malloc(uring->buf_count * sizeof(struct iovec));
+	if(!iov)
+		return false;
+	for(i=0; i<uring->buf_count; i++)
+	{
+		iov[i].iov_base = &uring->mem[i * uring->buf_size];
+		iov[i].iov_len = uring->buf_size;
+	};
+	err = syscall(__NR_io_uring_register, uring->ring_fd, IORING_REGISTER_BUFFERS, iov, uring->buf_count);
+	free(iov);
+
+	return !err;
+#else
+	(void)uring;
+	return false;
+#endif
+}
+
+// Release the ring (if any), leaving the writer using blocking writes
+static void uring_teardown(struct prnf_uring_struct* uring)
+{
+	if(uring->sqes)
+		munmap(uring->sqes, uring->sqes_size);
+	if(uring->cq_map && uring->cq_map != uring->sq_map)
+		munmap(uring->cq_map, uring->cq_map_size);
+	if(uring->sq_map)
+		munmap(uring->sq_map, uring->sq_map_size);
+	if(uring->ring_fd >= 0)
+		close(uring->ring_fd);
+	uring->sqes = uring->cq_map = uring->sq_map = NULL;
+	uring->ring_fd = -1;
+}
+
+// Write a full (or flushed) buffer, asynchronously if possible
+static void uring_write(struct prnf_uring_struct* uring, int buf_idx)
+{
+	struct prnf_uring_buf_struct* buf = &uring->bufs[buf_idx];
+
+	buf->done = 0;
+	buf->offset = uring->offset;
+	if(uring->seekable)
+		uring->offset += buf->len;
+	uring->writes++;
+
+	if(uring->ring_fd >= 0)
+	{
+		// keep order for streams by having only one write in flight
+		while(!uring->seekable && uring->in_flight)
+			uring_reap(uring, true);
+		uring_submit(uring, buf_idx);
+	}
+	else
+	{
+		if(!write_all(uring->fd, &uring->mem[buf_idx * uring->buf_size], buf->len))
+			uring->errors++;
+		buf->len = 0;
+		buf->next_free = uring->free_list;
+		uring->free_list = buf_idx;
+	};
+}
+
+// Queue a write of the unwritten part of a buffer, and submit it to the kernel
+static void uring_submit(struct prnf_uring_struct* uring, int buf_idx)
+{
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+	struct prnf_uring_buf_struct* buf = &uring->bufs[buf_idx];
+	struct io_uring_sqe* sqe;
+	unsigned tail;
+	unsigned idx;
+	long ret;
+
+	tail = *uring->sq_tail;
+	idx = tail & *uring->sq_mask;
+	sqe = &((struct io_uring_sqe*)uring->sqes)[idx];
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+	sqe->opcode = IORING_OP_WRITE_FIXED;
+	sqe->fd = uring->fd;
+	sqe->off = (buf->offset < 0)? (uint64_t)-1 : (uint64_t)(buf->offset + buf->done);
+	sqe->addr = (uint64_t)(uintptr_t)&uring->mem[buf_idx * uring->buf_size + buf->done];
+	sqe->len = buf->len - buf->done;
+	sqe->buf_index = buf_idx;
+	sqe->user_data = buf_idx;
+	uring->sq_array[idx] = idx;
+	__atomic_store_n(uring->sq_tail, tail+1, __ATOMIC_RELEASE);
+	uring->in_flight++;
+
+	do
+		ret = syscall(__NR_io_uring_enter, uring->ring_fd, 1, 0, 0, NULL, 0);
+	while(ret < 0 && errno == EINTR);
+
+	// nothing was consumed, so no completion will arrive. Withdraw the entry and write it now.
+	if(ret < 1)
+	{
+		__atomic_store_n(uring->sq_tail, tail, __ATOMIC_RELEASE);
+		uring->in_flight--;
+		uring_submit_failed(uring, buf_idx);
+	};
+#else
+	(void)uring;
+	(void)buf_idx;
+#endif
+}
+
+// Write the unwritten part of a buffer which the kernel would not take, with blocking writes, then recycle the buffer
+static void uring_submit_failed(struct prnf_uring_struct* uring, int buf_idx)
+{
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+	struct prnf_uring_buf_struct* buf = &uring->bufs[buf_idx];
+	const char* src = &uring->mem[buf_idx * uring->buf_size];
+	ssize_t written;
+	bool ok = true;
+
+	if(buf->offset < 0)
+		ok = write_all(uring->fd, src + buf->done, buf->len - buf->done);
+	else
+	{
+		// fixed writes don't move the file position, so write at the buffer's offset
+		while(ok && buf->done < buf->len)
+		{
+			written = pwrite(uring->fd, src + buf->done, buf->len - buf->done, (off_t)(buf->offset + buf->done));
+			if(written < 0 && errno == EINTR)
+				continue;
+			ok = written > 0;
+			if(ok)
+				buf->done += written;
+		};
+	};
+
+	if(!ok)
+		uring->errors++;
+	buf->len = 0;
+	buf->next_free = uring->free_list;
+	uring->free_list = buf_idx;
+#else
+	(void)uring;
+	(void)buf_idx;
+#endif
+}
+
+// Handle completed writes, resubmitting partial writes and recycling buffers. Optionally wait for at least one completion.
+static void uring_reap(struct prnf_uring_struct* uring, bool wait)
+{
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+	struct io_uring_cqe* cqe;
+	struct prnf_uring_buf_struct* buf;
+	unsigned head, tail;
+	int buf_idx;
+
+	head = *uring->cq_head;
+	tail = __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE);
+	if(head == tail && wait)
+	{
+		while(syscall(__NR_io_uring_enter, uring->ring_fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno == EINTR);
+		tail = __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE);
+	};
+
+	while(head != tail)
+	{
+		cqe = &((struct io_uring_cqe*)uring->cqes)[head & *uring->cq_mask];
+		buf_idx = (int)cqe->user_data;
+		buf = &uring->bufs[buf_idx];
+		uring->in_flight--;
+
+		if(cqe->res > 0)
+			buf->done += cqe->res;
+
+		if(cqe->res > 0 && buf->done < buf->len)
+			uring_submit(uring, buf_idx);	// short write
+		else
+		{
+			if(cqe->res <= 0)
+				uring->errors++;
+			buf->len = 0;
+			buf->next_free = uring->free_list;
+			uring->free_list = buf_idx;
+		};
+		head++;
+	};
+	__atomic_store_n(uring->cq_head, head, __ATOMIC_RELEASE);
+#else
+	(void)uring;
+	(void)wait;
+#endif
+}
+
+// Take a buffer from the free list, waiting for a write to complete if none are free
+static int uring_get_buf(struct prnf_uring_struct* uring)
+{
+	int buf_idx;
+
+	if(uring->free_list < 0)
+		uring->waits++;
+	while(uring->free_list < 0)
+		uring_reap(uring, true);
+
+	buf_idx = uring->free_list;
+	uring->free_list = uring->bufs[buf_idx].next_free;
+	uring->bufs[buf_idx].len = 0;
+	return buf_idx;
+}
+
+static void shm_pid_init(void)
+{
+	shm_pid = getpid();
+	pthread_atfork(NULL, NULL, shm_pid_update);
+}
+
+static void shm_pid_update(void)
+{
+	shm_pid = getpid();
+}
+
+static int shm_map(struct prnf_shm_struct* shm, int fd, size_t map_size)
+{
+	shm->ring = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(shm->ring == MAP_FAILED)
+	{
+		shm->ring = NULL;
+		return errno;
+	};
+	shm->map_size = map_size;
+	return 0;
+}
+
+static struct shm_slot_struct* shm_slot(struct shm_ring_struct* ring, uint64_t pos)
+{
+	return (struct shm_slot_struct*)((char*)(ring+1) + (pos & (ring->slot_count-1)) * ring->slot_size);
+}
+
+// Largest payload of one record, half of the ring
+static size_t shm_max_record(struct shm_ring_struct* ring)
+{
+	uint64_t count = ring->slot_count/2;
+
+	if(count > UINT16_MAX)
+		count = UINT16_MAX;
+	return count * (ring->slot_size - sizeof(struct shm_slot_struct));
+}
+
+// Slots in the record, limited to a sane value in case of corruption
+static unsigned shm_count(struct shm_ring_struct* ring, struct shm_slot_struct* slot)
+{
+	unsigned count = slot->count;
+
+	if(count < 1 || count > shm_max_record(ring) / (ring->slot_size - sizeof(struct shm_slot_struct)))
+		count = 1;
+	return count;
+}
+
+// Reserve, claim, fill, and publish one record
+static void shm_put(struct prnf_shm_struct* shm, const char* src, size_t len)
+{
+	struct shm_ring_struct* ring = shm->ring;
+	struct shm_slot_struct* slot;
+	size_t payload = ring->slot_size - sizeof(struct shm_slot_struct);
+	unsigned count = (len + payload - 1) / payload;
+	uint64_t pos;
+	uint64_t seq;
+	int64_t diff;
+	unsigned i;
+
+	// The collector frees slots in order, so if the last slot of the record is free, so are the others.
+	pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+	for(;;)
+	{
+		seq = __atomic_load_n(&shm_slot(ring, pos + count-1)->seq, __ATOMIC_ACQUIRE);
+		diff = (int64_t)(seq - (pos + count-1));
+		if(diff == 0)
+		{
+			if(__atomic_compare_exchange_n(&ring->head, &pos, pos + count, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		}
+		else if(diff < 0)
+		{
+			__atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+			return;
+		}
+		else
+			pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+	};
+
+	slot = shm_slot(ring, pos);
+	slot->count = count;
+	__atomic_store_n(&slot->pid, (uint32_t)shm_pid, __ATOMIC_RELEASE);
+
+	// fails only if the collector gave up on this record, the slots may then be in use by another producer
+	seq = pos;
+	if(!__atomic_compare_exchange_n(&slot->seq, &seq, pos+SHM_WRITING, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+		return;
+
+	for(i=0; i<count; i++)
+	{
+		slot = shm_slot(ring, pos + i);
+		slot->len = (len < payload)? len : payload;
+		memcpy(slot+1, src, slot->len);
+		src += slot->len;
+		len -= slot->len;
+	};
+
+	// the collector only takes back a claimed record once this process has gone
+	__atomic_store_n(&shm_slot(ring, pos)->seq, pos+1, __ATOMIC_RELEASE);
+}
+
+// true if the producer of a reserved record is gone, or has not claimed it (writing is false) for PRNF_SHM_STUCK_MS
+// a record being written is only given up once the producer no longer exists, as it could still write to the slots
+static bool shm_abandoned(struct prnf_shm_struct* shm, struct shm_slot_struct* slot, bool writing)
+{
+	pid_t pid = __atomic_load_n(&slot->pid, __ATOMIC_ACQUIRE);
+
+	if(pid && !kill(pid, 0))
+		return false;
+
+	if(pid && errno == ESRCH)
+		return true;
+
+	// no pid yet, or one we may not signal (EPERM, another user's process)
+	if(writing)
+		return false;
+
+	if(shm->stuck_pos != shm->tail+1)
+	{
+		shm->stuck_pos = shm->tail+1;
+		clock_gettime(CLOCK_MONOTONIC, &shm->stuck_since);
+	};
+	return elapsed_ns(&shm->stuck_since) >= (uint64_t)PRNF_SHM_STUCK_MS * 1000000U;
+}
+
+// Free the slots of the record at tail for the next lap, in order.
+static void shm_release(struct prnf_shm_struct* shm, unsigned count)
+{
+	struct shm_ring_struct* ring = shm->ring;
+	struct shm_slot_struct* slot;
+	unsigned i;
+
+	slot = shm_slot(ring, shm->tail);
+	slot->pid = 0;
+	slot->count = 0;
+	for(i=0; i<count; i++)
+	{
+		slot = shm_slot(ring, shm->tail + i);
+		__atomic_store_n(&slot->seq, shm->tail + i + ring->slot_count, __ATOMIC_RELEASE);
+	};
+	shm->tail += count;
+}
+
+// Buffer collected output, a NULL src writes out the buffer.
+static void shm_out(struct prnf_shm_struct* shm, int fd, const char* src, size_t len)
+{
+	size_t part;
+
+	while(len)
+	{
+		part = SHM_OUT_SIZE - shm->out_len;
+		if(part > len)
+			part = len;
+		memcpy(&shm->out[shm->out_len], src, part);
+		shm->out_len += part;
+		src += part;
+		len -= part;
+
+		if(shm->out_len == SHM_OUT_SIZE)
+		{
+			if(!write_all(fd, shm->out, shm->out_len))
+				shm->stats.errors++;
+			shm->out_len = 0;
+		};
+	};
+
+	if(!src && shm->out_len)
+	{
+		if(!write_all(fd, shm->out, shm->out_len))
+			shm->stats.errors++;
+		shm->out_len = 0;
+	};
+}
+
+// Sends the waiting messages latency_ms after the first of them was completed
+static void* dgram_thread(void* dgram_vp)
+{
+	struct prnf_dgram_struct* dgram = dgram_vp;
+	struct timespec deadline;
+
+	pthread_mutex_lock(&dgram->lock);
+	while(!dgram->stop)
+	{
+		if(!dgram->count)
+			pthread_cond_wait(&dgram->wake, &dgram->lock);
+		else if(elapsed_ns(&dgram->first) >= (uint64_t)dgram->latency_ms * 1000000U)
+			dgram_send(dgram);
+		else
+		{
+			deadline = dgram->first;
+			deadline.tv_sec += dgram->latency_ms / 1000;
+			deadline.tv_nsec += (long)(dgram->latency_ms % 1000) * 1000000L;
+			if(deadline.tv_nsec >= 1000000000L)
+			{
+				deadline.tv_sec++;
+				deadline.tv_nsec -= 1000000000L;
+			};
+			pthread_cond_timedwait(&dgram->wake, &dgram->lock, &deadline);
+		};
+	};
+	pthread_mutex_unlock(&dgram->lock);
+
+	return NULL;
+}
+
+// Add to the message being filled, truncating at the message size
+static void dgram_append(struct prnf_dgram_struct* dgram, const char* src, size_t len)
+{
+	struct iovec* iov = &dgram->iov[dgram->count];
+
+	if(iov->iov_len + len > dgram->msg_size)
+	{
+		len = dgram->msg_size - iov->iov_len;
+		dgram->truncating = true;
+	};
+	memcpy((char*)iov->iov_base + iov->iov_len, src, len);
+	iov->iov_len += len;
+}
+
+// Complete the message being filled, sending the batch if it is full
+static void dgram_end(struct prnf_dgram_struct* dgram)
+{
+	if(dgram->truncating)
+		dgram->stats.truncated++;
+	dgram->truncating = false;
+
+	if(!dgram->count++)
+	{
+		clock_gettime(CLOCK_MONOTONIC, &dgram->first);
+		if(dgram->latency_ms)
+			pthread_cond_signal(&dgram->wake);
+	};
+
+	if(dgram->count == dgram->batch)
+		dgram_send(dgram);
+	else
+		dgram->iov[dgram->count].iov_len = 0;
+}
+
+// Send the complete messages, and move any partly filled message to the start
+// if the daemon's queue is full, wait up to PRNF_DGRAM_WAIT_MS for it to drain before dropping what remains
+static void dgram_send(struct prnf_dgram_struct* dgram)
+{
+	struct dgram_msg_struct* msgs = dgram->msgs;
+	struct pollfd pfd = {.fd = dgram->fd, .events = POLLOUT};
+	struct timespec wait_start;
+	uint64_t waited_ns;
+	bool waiting = false;
+	unsigned sent = 0;
+	int result;
+
+	while(sent < dgram->count)
+	{
+#if defined(__linux__) && defined(__NR_sendmmsg)
+		result = syscall(__NR_sendmmsg, dgram->fd, &msgs[sent], dgram->count - sent, MSG_DONTWAIT);
+#else
+		result = (sendmsg(dgram->fd, &msgs[sent].msg_hdr, MSG_DONTWAIT) < 0)? -1 : 1;
+#endif
+		if(result < 0 && errno == EINTR)
+			continue;
+		if(result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && !dgram->stalled)
+		{
+			if(!waiting)
+				clock_gettime(CLOCK_MONOTONIC, &wait_start);
+			waiting = true;
+			waited_ns = elapsed_ns(&wait_start);
+			if(waited_ns < (uint64_t)PRNF_DGRAM_WAIT_MS * 1000000U)
+			{
+				poll(&pfd, 1, (int)(((uint64_t)PRNF_DGRAM_WAIT_MS * 1000000U - waited_ns + 999999U) / 1000000U));
+				continue;
+			};
+			dgram->stalled = true;
+		};
+		dgram->stats.batches++;
+		if(result <= 0)
+		{
+			dgram->stats.dropped += dgram->count - sent;
+			break;
+		};
+		dgram->stalled = false;
+		dgram->stats.messages += result;
+		sent += result;
+	};
+
+	if(dgram->count && dgram->count < dgram->batch)
+	{
+		memmove(dgram->iov[0].iov_base, dgram->iov[dgram->count].iov_base, dgram->iov[dgram->count].iov_len);
+		dgram->iov[0].iov_len = dgram->iov[dgram->count].iov_len;
+	}
+	else if(dgram->count)
+		dgram->iov[0].iov_len = 0;
+	dgram->count = 0;
+}
+
+// Allocate a segment file name
+static int mmap_name(char** dst, const char* base, unsigned index)
+{
+	size_t size = strlen(base) + 16;
+
+	*dst = malloc(size);
+	if(!*dst)
+		return ENOMEM;
+	snprnf(*dst, size, MMAP_NAME_FMT, base, index);
+	return 0;
+}
+
+// Create, preallocate and map the segment mm->index, returns NULL with errno set on failure
+static struct prnf_mmap_seg_struct* mmap_seg_create(struct prnf_mmap_struct* mm)
+{
+	struct prnf_mmap_seg_struct* seg = calloc(1, sizeof(struct prnf_mmap_seg_struct));
+	char* name = NULL;
+	int err;
+
+	err = seg? mmap_name(&name, mm->base, mm->index) : ENOMEM;
+
+	if(!err)
+	{
+		seg->fd = open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+		err = (seg->fd < 0)? errno : 0;
+	};
+
+	if(!err)
+		err = posix_fallocate(seg->fd, 0, mm->seg_size);
+
+	if(!err)
+	{
+		seg->size = mm->seg_size;
+		seg->map = mmap(NULL, seg->size, PROT_READ | PROT_WRITE, MAP_SHARED, seg->fd, 0);
+		if(seg->map == MAP_FAILED)
+		{
+			seg->map = NULL;
+			err = errno;
+		};
+	};
+
+	if(err && seg)
+	{
+		if(seg->fd >= 0)
+		{
+			close(seg->fd);
+			unlink(name);
+		};
+		free(seg);
+		seg = NULL;
+	};
+
+	if(seg)
+	{
+		seg->next = mm->segs;
+		mm->segs = seg;
+		mm->stats.segments++;
+		mm->index++;
+	};
+
+	free(name);
+	errno = err;
+	return seg;
+}
+
+// Called once the segment has been replaced and no callers are using it. Marks it as complete for readers.
+// A caller may briefly enter and leave a completed segment, before seeing it has been replaced, so this may be called more than once.
+static void mmap_seg_complete(struct prnf_mmap_seg_struct* seg)
+{
+	if(__atomic_fetch_or(&seg->writers, MMAP_COMPLETE, __ATOMIC_SEQ_CST) & MMAP_COMPLETE)
+		return;
+
+	munmap(seg->map, seg->size);
+	if(!ftruncate(seg->fd, seg->used))
+		fchmod(seg->fd, 0444);
+	close(seg->fd);
+	seg->map = NULL;
+	seg->fd = -1;
+}
+
+// Stop using a segment, completing it if it has been replaced and this was the last user
+static void mmap_seg_leave(struct prnf_mmap_seg_struct* seg)
+{
+	if((__atomic_fetch_sub(&seg->writers, 1, __ATOMIC_SEQ_CST) & ~MMAP_COMPLETE) == (MMAP_RETIRED | 1))
+		mmap_seg_complete(seg);
+}
+
+// Replace a full segment, unless another caller already has. Returns false if a new segment could not be created.
+static bool mmap_rotate(struct prnf_mmap_struct* mm, struct prnf_mmap_seg_struct* full)
+{
+	struct prnf_mmap_seg_struct* seg;
+	bool ok = true;
+
+	pthread_mutex_lock(&mm->lock);
+	if(__atomic_load_n(&mm->seg, __ATOMIC_ACQUIRE) == full)
+	{
+		seg = mmap_seg_create(mm);
+		ok = !!seg;
+		if(ok)
+		{
+			__atomic_store_n(&mm->seg, seg, __ATOMIC_SEQ_CST);
+			if(__atomic_fetch_or(&full->writers, MMAP_RETIRED, __ATOMIC_SEQ_CST) == 0)
+				mmap_seg_complete(full);
+		};
+	};
+	pthread_mutex_unlock(&mm->lock);
+
+	return ok;
+}
+
+static bool mmap_append(struct prnf_mmap_struct* mm, const char* src, size_t len)
+{
+	struct prnf_mmap_seg_struct* seg;
+	uint64_t offset;
+
+	for(;;)
+	{
+		// the segment can only be unmapped while writers is 0
+		seg = __atomic_load_n(&mm->seg, __ATOMIC_SEQ_CST);
+		if(__atomic_fetch_add(&seg->writers, 1, __ATOMIC_SEQ_CST) & MMAP_RETIRED)
+		{
+			mmap_seg_leave(seg);
+			continue;
+		};
+
+		offset = __atomic_fetch_add(&seg->cursor, len, __ATOMIC_RELAXED);
+		if(offset + len <= mm->seg_size)
+		{
+			memcpy(&seg->map[offset], src, len);
+			mmap_seg_leave(seg);
+			return true;
+		};
+
+		// the caller which overflowed the segment knows where it's output ends
+		if(offset <= mm->seg_size)
+			seg->used = offset;
+		mmap_seg_leave(seg);
+
+		if(!mmap_rotate(mm, seg))
+			return false;
+	};
+}
+
+#endif // _PRNF_POSIX_IMPLEMENTED_
+#endif // PRNF_POSIX_IMPLEMENTATION
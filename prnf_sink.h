@@ -0,0 +1,1312 @@
+/*
+-------------------------------------------------------------------------------------
+# PRNF SINK
+
+ Output destinations (sinks) for prnf, which need no operating system and so are suitable for bare metal targets as well as hosted ones.
+
+ * Single header (stb style), in one .c file:
+
+	#define PRNF_SINK_IMPLEMENTATION
+	#include "prnf_sink.h"
+
+ * Requires prnf.h
+
+-------------------------------------------------------------------------------------
+# Flight recorder
+
+ A circular log in a fixed region of memory, made of records with headers and sequence numbers, which survives a crash or reset.
+ After a reset the last records can be recovered in order, to see what happened leading up to it.
+
+ The region can be RAM which is not cleared at startup, or (with prnf_posix.h) a memory mapped file which survives a process crash.
+
+	static char flight_mem[4096] __attribute__((section(".noinit")));
+	struct prnf_flight_struct flight;
+
+	prnf_flight_init(&flight, flight_mem, sizeof(flight_mem), true);	// resume after what is already there
+	fptrprnf(prnf_flight_putch, &flight, "Fred is %i years old\n", freds_age);
+
+ Each line becomes one record, a record is committed when it's '\n' is written. prnf_flight_putch() formats straight into the ring
+ with no staging, prnf_flight_blk() does the same for block output.
+ Recording costs a store per character and a 12 byte header per line, with no index to maintain, so it can be left on permanently.
+
+ To recover the last 20 records (oldest first), from the region as found after a reset, or from a copy of it:
+
+	prnf_flight_recover(flight_mem, sizeof(flight_mem), 20, my_blk_handler, NULL);
+
+ Recovery finds the newest intact record, and walks back through the previous records using the length of it's predecessor stored in each header.
+ A record which was being written when the crash happened is not committed and is ignored.
+ A recorder is not thread safe, use one per thread (or a lock) if needed.
+
+-------------------------------------------------------------------------------------
+# Filter chain
+
+ Filters transform output a block at a time (rather than a character at a time), and pass it on to the next filter, or finally to a block handler.
+ The chain is set up once, filters are passed in the order they are applied:
+
+	struct prnf_filter_struct check, crlf;
+
+	prnf_filter_check(&check, PRNF_CHECK_CRC16);
+	prnf_filter_crlf(&crlf);
+	prnf_filter_chain(uart_blk, NULL, &check, &crlf, NULL);
+
+	blkprnf(prnf_filter_blk, &check, "Fred is %i years old\n", freds_age);	// Fred is 42 years old*1A2B\r\n
+
+ Built in filters:
+
+	prnf_filter_crlf()		"\n" becomes "\r\n" (an existing "\r\n" is left alone).
+	prnf_filter_check()		Appends a checksum of each line as hex, before the '\n', ie. "*5A". PRNF_CHECK_XOR8 (NMEA style),
+							PRNF_CHECK_CRC16 (CCITT-FALSE) or PRNF_CHECK_CRC32 (as used by zlib).
+	prnf_filter_cobs()		Each line (without the '\n') becomes one COBS encoded frame, followed by a 0 delimiter.
+
+ Filters hold state between blocks, so a line may arrive in several blocks. Use a separate chain for each thread.
+ The CRCs use 256 entry tables (1.5k), define PRNF_SINK_SMALL_CRC for 16 entry tables, which are around half the speed.
+ A filter of your own sets .fptr to a function taking (filter, blk, len), which passes its output on with prnf_filter_out().
+
+-------------------------------------------------------------------------------------
+# Tee
+
+ Formats once, and passes the output to several sinks (ie. the console, a file and a flight recorder).
+ Each sink has a mask of the levels it receives, levels are bits of your own choosing.
+ If no sink wants a level, nothing is formatted.
+
+	#define LOG_ERR		1
+	#define LOG_DBG		2
+
+	static struct prnf_tee_sink_struct log_sinks[3];
+	struct prnf_tee_struct log;
+
+	prnf_tee_init(&log, log_sinks, 3);
+	prnf_tee_add_char(&log, console_putch, NULL, PRNF_TEE_ALL);
+	prnf_tee_add(&log, my_file_blk, my_file, LOG_ERR);
+	prnf_tee_add(&log, prnf_flight_blk, &flight, PRNF_TEE_ALL);
+
+	prnf_tee(&log, LOG_DBG, "Fred is %i years old\n", freds_age);	// to the console and flight recorder only
+
+ prnf_tee_blk() is a block handler sending to every sink regardless of level, so a tee can also be the sink at the end of a filter chain.
+ Add all sinks before printing, adding is not thread safe (printing is, if the sinks are).
+
+-------------------------------------------------------------------------------------
+# Compression
+
+ A block handler which compresses output on the fly, and passes the compressed stream on to another block handler (ie. a file writer).
+ The codec is a small LZ77 variant (similar to LZ4), log output compresses well as the same text repeats with different numbers.
+ Matches are found within the current block and the previous one, so repeated lines are found across block boundaries.
+
+ All memory is provided by the caller, PRNF_LZ_WORK_SIZE(block) bytes, 4 byte aligned. The block size (power of 2, up to 16k) is the largest which fits.
+
+	static uint32_t lz_work[PRNF_LZ_WORK_SIZE(4096)/4];
+	struct prnf_lz_struct lz;
+
+	prnf_lz_init(&lz, lz_work, sizeof(lz_work), my_file_blk, my_file);
+	blkprnf(prnf_lz_blk, &lz, "Fred is %i years old\n", freds_age);
+	...
+	prnf_lz_flush(&lz);		// compress and pass on what has been buffered so far
+
+ Output is buffered until a block fills, or prnf_lz_flush() is called (frequent flushes reduce compression).
+ The decompressor takes the stream in any sized pieces, and passes on the original text:
+
+	static uint32_t unlz_work[PRNF_UNLZ_WORK_SIZE(4096)/4];
+	prnf_unlz_init(&unlz, unlz_work, sizeof(unlz_work), my_text_blk, NULL);
+	prnf_unlz_blk(&unlz, compressed, compressed_len);
+
+ The decompressor needs at least the block size the stream was compressed with, prnf_unlz_error() reports a corrupt stream or insufficient memory.
+ tools/prnf_unlz decompresses a file to stdout.
+
+ Stream format: "pLZ" + log2(block size), then frames of varint(compressed length) varint(original length) and sequences.
+ A sequence is a token (literal count << 4 | match length - 4), extra literal count bytes if 15, the literals,
+ then (except at the end of a frame) a 16 bit little endian match offset, and extra match length bytes if 15.
+ Extra length bytes are added, and continue while 255.
+
+*/
+
+#ifndef _PRNF_SINK_H_
+#define _PRNF_SINK_H_
+
+	#include <stddef.h>
+	#include <stdbool.h>
+	#include <stdint.h>
+	#include "prnf.h"
+
+	#ifdef __cplusplus
+	extern "C" {
+	#endif
+
+//********************************************************************************************************
+// Public defines
+//********************************************************************************************************
+
+	struct prnf_flight_struct
+	{
+		char* data;				// the ring, after the region header
+		uint32_t size;			// size of the ring, a multiple of 4
+		uint32_t head;			// start of the next record
+		uint32_t seq;			// sequence number of the next record
+		uint16_t prev_len;		// total length of the previous record
+		uint16_t max_len;		// longest record text, longer lines are split
+		uint32_t pos;			// write position in the open record
+		uint16_t len;			// length of the open record's text
+		bool open;
+	};
+
+//	Hash table size for the compressor, 2 bytes per entry
+	#ifndef PRNF_LZ_HASH_BITS
+		#define PRNF_LZ_HASH_BITS	12
+	#endif
+
+//	Largest compressed frame for a block size
+	#define PRNF_LZ_FRAME_BOUND(_block)		((_block) + (_block)/255 + 16)
+
+//	Work memory needed by the compressor and decompressor for a block size
+	#define PRNF_LZ_WORK_SIZE(_block)		((2UL << PRNF_LZ_HASH_BITS) + 2UL*(_block) + 16 + PRNF_LZ_FRAME_BOUND(_block))
+	#define PRNF_UNLZ_WORK_SIZE(_block)		(2UL*(_block) + PRNF_LZ_FRAME_BOUND(_block))
+
+	enum prnf_check_enum {PRNF_CHECK_XOR8, PRNF_CHECK_CRC16, PRNF_CHECK_CRC32};
+
+	struct prnf_filter_struct
+	{
+		void(*fptr)(struct prnf_filter_struct* filter, const char* blk, size_t len);
+		struct prnf_filter_struct* next;	// next filter, or NULL to pass to blk_fptr
+		void(*blk_fptr)(void*, const char*, size_t);
+		void* blk_vars;
+		union
+		{
+			bool cr;						// crlf, last character was '\r'
+			struct
+			{
+				enum prnf_check_enum kind;
+				uint32_t value;
+			} check;
+			struct
+			{
+				uint16_t len;				// data bytes in buf, after the code byte
+				char buf[256];
+			} cobs;
+			void* custom;					// for your own filters
+		} state;
+	};
+
+//	Level mask for a tee sink which receives everything
+	#define PRNF_TEE_ALL		(~0U)
+
+	struct prnf_tee_sink_struct
+	{
+		void(*blk_fptr)(void*, const char*, size_t);
+		void(*char_fptr)(void*, char);		// used if blk_fptr is NULL
+		void* vars;
+		unsigned levels;
+	};
+
+	struct prnf_tee_struct
+	{
+		struct prnf_tee_sink_struct* sinks;
+		int count;
+		int max;
+		unsigned levels;					// all levels wanted by any sink
+	};
+
+	struct prnf_lz_struct
+	{
+		void(*blk_fptr)(void*, const char*, size_t);
+		void* blk_vars;
+		uint16_t* table;		// hash of 4 bytes -> position in hist + 1
+		char* hist;				// previous block, then the current block
+		char* out;				// frame header and compressed frame
+		size_t block;
+		size_t len;				// bytes in the current block
+		size_t done;			// bytes of the current block already compressed
+		bool started;			// stream header sent
+		unsigned long bytes_in;
+		unsigned long bytes_out;
+	};
+
+	struct prnf_unlz_struct
+	{
+		void(*blk_fptr)(void*, const char*, size_t);
+		void* blk_vars;
+		char* work;
+		size_t work_size;
+		char* hist;
+		char* frame;
+		size_t block;			// 0 until the stream header is read
+		size_t len;				// bytes in the current block
+		char hdr[4];
+		int hdr_len;
+		int field;				// frame field being read, 0 compressed length, 1 original length, 2 data
+		int shift;
+		size_t comp_len;
+		size_t raw_len;
+		size_t frame_len;		// bytes of frame data received
+		bool error;
+	};
+
+//********************************************************************************************************
+// Public prototypes
+//********************************************************************************************************
+
+//	Start recording into region. With resume, recording continues after any records already in the region, otherwise it is cleared.
+	void prnf_flight_init(struct prnf_flight_struct* flight, void* region, size_t region_size, bool resume);
+
+//	Character handler for fptrprnf(), pass the struct prnf_flight_struct* as dst_vars.
+	void prnf_flight_putch(void* flight, char c);
+
+//	Block handler for blkprnf(), pass the struct prnf_flight_struct* as blk_vars.
+	void prnf_flight_blk(void* flight, const char* blk, size_t len);
+
+//	Pass the text of the last count records in region to a block handler, oldest first. Returns the number of records recovered.
+	unsigned prnf_flight_recover(const void* region, size_t region_size, unsigned count, void(*blk_fptr)(void*, const char*, size_t), void* blk_vars);
+
+//	Link filters (initialized by the functions below) in the order given, ending with a NULL. Output of the last filter goes to blk_fptr.
+	void prnf_filter_chain(void(*blk_fptr)(void*, const char*, size_t), void* blk_vars, struct prnf_filter_struct* filter, ...);
+
+//	Block handler for blkprnf(), pass the first struct prnf_filter_struct* in the chain as blk_vars.
+	void prnf_filter_blk(void* filter, const char* blk, size_t len);
+
+//	Pass output from a filter to the next one.
+	void prnf_filter_out(struct prnf_filter_struct* filter, const char* blk, size_t len);
+
+//	Built in filters
+	void prnf_filter_crlf(struct prnf_filter_struct* filter);
+	void prnf_filter_check(struct prnf_filter_struct* filter, enum prnf_check_enum kind);
+	void prnf_filter_cobs(struct prnf_filter_struct* filter);
+
+//	Start a tee with space for max sinks.
+	void prnf_tee_init(struct prnf_tee_struct* tee, struct prnf_tee_sink_struct* sinks, int max);
+
+//	Add a block handler or character handler as a sink receiving the levels given. Returns false if there is no space.
+	bool prnf_tee_add(struct prnf_tee_struct* tee, void(*blk_fptr)(void*, const char*, size_t), void* blk_vars, unsigned levels);
+	bool prnf_tee_add_char(struct prnf_tee_struct* tee, void(*char_fptr)(void*, char), void* char_vars, unsigned levels);
+
+//	Print once to every sink receiving any of the levels. Returns the length, or 0 if no sink receives the levels.
+	int prnf_tee(struct prnf_tee_struct* tee, unsigned levels, const char* fmtstr, ...) __attribute__((format(printf, 3, 4)));
+	int vprnf_tee(struct prnf_tee_struct* tee, unsigned levels, const char* fmtstr, va_list va);
+
+//	Block handler for blkprnf() sending to all sinks, pass the struct prnf_tee_struct* as blk_vars.
+	void prnf_tee_blk(void* tee, const char* blk, size_t len);
+
+//	Start a compressor using work memory (4 byte aligned), passing the compressed stream to blk_fptr. Returns the block size, 0 if work_size is too small.
+	size_t prnf_lz_init(struct prnf_lz_struct* lz, void* work, size_t work_size, void(*blk_fptr)(void*, const char*, size_t), void* blk_vars);
+
+//	Block handler for blkprnf(), pass the struct prnf_lz_struct* as blk_vars.
+	void prnf_lz_blk(void* lz, const char* blk, size_t len);
+
+//	Compress and pass on all output so far.
+	void prnf_lz_flush(struct prnf_lz_struct* lz);
+
+//	Start a decompressor using work memory, passing the original text to blk_fptr.
+	void prnf_unlz_init(struct prnf_unlz_struct* unlz, void* work, size_t work_size, void(*blk_fptr)(void*, const char*, size_t), void* blk_vars);
+
+//	Block handler taking the compressed stream, pass the struct prnf_unlz_struct* as blk_vars.
+	void prnf_unlz_blk(void* unlz, const char* blk, size_t len);
+
+//	true if the stream was corrupt, or compressed with a larger block size than the work memory allows. Further input is ignored.
+	bool prnf_unlz_error(struct prnf_unlz_struct* unlz);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // _PRNF_SINK_H_
+
+
+
+
+
+//********************************************************************************************************
+//
+// PRNF SINK Implementation
+//
+//********************************************************************************************************
+#ifdef PRNF_SINK_IMPLEMENTATION
+#ifndef _PRNF_SINK_IMPLEMENTED_
+#define _PRNF_SINK_IMPLEMENTED_
+
+	#include <stdbool.h>
+	#include <stdint.h>
+	#include <stdarg.h>
+	#include <string.h>
+
+//********************************************************************************************************
+// Local defines
+//********************************************************************************************************
+
+	#ifndef PRNF_ASSERT
+		#define PRNF_ASSERT(arg)	((void)0)
+	#endif
+
+//	Region header, followed by the ring
+	#define FLIGHT_REGION_MAGIC		0x70466C74UL	// "pFlt"
+	#define FLIGHT_REGION_HDR		8
+
+//	Record header, 12 bytes little endian: magic(2) len(2) seq(4) prev_len(2) check(2), followed by the text and padding to a multiple of 4.
+//	The magic bytes are not ASCII, so are not found in text.
+	#define FLIGHT_REC_MAGIC		0xA5F1
+	#define FLIGHT_REC_HDR			12
+	#define FLIGHT_REC_MAX			0xFFF0
+
+//	Compressor limits, positions in the history must fit the 16 bit hash table entries and match offsets
+	#define LZ_BLOCK_MIN		256
+	#define LZ_BLOCK_MAX		16384
+	#define LZ_MIN_MATCH		4
+	#define LZ_HASH(_v)			((uint32_t)((_v) * 2654435761UL) >> (32 - PRNF_LZ_HASH_BITS))
+
+//	A print to a tee, with the levels it is for
+	struct tee_call_struct
+	{
+		struct prnf_tee_struct* tee;
+		unsigned levels;
+	};
+
+	struct flight_rec_struct
+	{
+		uint16_t len;			// text length
+		uint32_t seq;
+		uint16_t prev_len;		// total length of the previous record, 0 if unknown
+	};
+
+//********************************************************************************************************
+// Private variables
+//********************************************************************************************************
+
+//	CRC tables, a byte at a time, or a nibble at a time if PRNF_SINK_SMALL_CRC
+#ifndef PRNF_SINK_SMALL_CRC
+	static const uint16_t crc16_table[256] =
+	{
+		0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+		0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+		0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+		0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+		0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
+		0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+		0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+		0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+		0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+		0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+		0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
+		0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+		0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
+		0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+		0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+		0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+		0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
+		0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+		0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
+		0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+		0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+		0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+		0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
+		0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+		0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
+		0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+		0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+		0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+		0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
+		0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+		0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
+		0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0
+	};
+
+	static const uint32_t crc32_table[256] =
+	{
+		0x00000000, 0x77073096, 0xEE0E612C, 0x990951BA, 0x076DC419, 0x706AF48F, 0xE963A535, 0x9E6495A3,
+		0x0EDB8832, 0x79DCB8A4, 0xE0D5E91E, 0x97D2D988, 0x09B64C2B, 0x7EB17CBD, 0xE7B82D07, 0x90BF1D91,
+		0x1DB71064, 0x6AB020F2, 0xF3B97148, 0x84BE41DE, 0x1ADAD47D, 0x6DDDE4EB, 0xF4D4B551, 0x83D385C7,
+		0x136C9856, 0x646BA8C0, 0xFD62F97A, 0x8A65C9EC, 0x14015C4F, 0x63066CD9, 0xFA0F3D63, 0x8D080DF5,
+		0x3B6E20C8, 0x4C69105E, 0xD56041E4, 0xA2677172, 0x3C03E4D1, 0x4B04D447, 0xD20D85FD, 0xA50AB56B,
+		0x35B5A8FA, 0x42B2986C, 0xDBBBC9D6, 0xACBCF940, 0x32D86CE3, 0x45DF5C75, 0xDCD60DCF, 0xABD13D59,
+		0x26D930AC, 0x51DE003A, 0xC8D75180, 0xBFD06116, 0x21B4F4B5, 0x56B3C423, 0xCFBA9599, 0xB8BDA50F,
+		0x2802B89E, 0x5F058808, 0xC60CD9B2, 0xB10BE924, 0x2F6F7C87, 0x58684C11, 0xC1611DAB, 0xB6662D3D,
+		0x76DC4190, 0x01DB7106, 0x98D220BC, 0xEFD5102A, 0x71B18589, 0x06B6B51F, 0x9FBFE4A5, 0xE8B8D433,
+		0x7807C9A2, 0x0F00F934, 0x9609A88E, 0xE10E9818, 0x7F6A0DBB, 0x086D3D2D, 0x91646C97, 0xE6635C01,
+		0x6B6B51F4, 0x1C6C6162, 0x856530D8, 0xF262004E, 0x6C0695ED, 0x1B01A57B, 0x8208F4C1, 0xF50FC457,
+		0x65B0D9C6, 0x12B7E950, 0x8BBEB8EA, 0xFCB9887C, 0x62DD1DDF, 0x15DA2D49, 0x8CD37CF3, 0xFBD44C65,
+		0x4DB26158, 0x3AB551CE, 0xA3BC0074, 0xD4BB30E2, 0x4ADFA541, 0x3DD895D7, 0xA4D1C46D, 0xD3D6F4FB,
+		0x4369E96A, 0x346ED9FC, 0xAD678846, 0xDA60B8D0, 0x44042D73, 0x33031DE5, 0xAA0A4C5F, 0xDD0D7CC9,
+		0x5005713C, 0x270241AA, 0xBE0B1010, 0xC90C2086, 0x5768B525, 0x206F85B3, 0xB966D409, 0xCE61E49F,
+		0x5EDEF90E, 0x29D9C998, 0xB0D09822, 0xC7D7A8B4, 0x59B33D17, 0x2EB40D81, 0xB7BD5C3B, 0xC0BA6CAD,
+		0xEDB88320, 0x9ABFB3B6, 0x03B6E20C, 0x74B1D29A, 0xEAD54739, 0x9DD277AF, 0x04DB2615, 0x73DC1683,
+		0xE3630B12, 0x94643B84, 0x0D6D6A3E, 0x7A6A5AA8, 0xE40ECF0B, 0x9309FF9D, 0x0A00AE27, 0x7D079EB1,
+		0xF00F9344, 0x8708A3D2, 0x1E01F268, 0x6906C2FE, 0xF762575D, 0x806567CB, 0x196C3671, 0x6E6B06E7,
+		0xFED41B76, 0x89D32BE0, 0x10DA7A5A, 0x67DD4ACC, 0xF9B9DF6F, 0x8EBEEFF9, 0x17B7BE43, 0x60B08ED5,
+		0xD6D6A3E8, 0xA1D1937E, 0x38D8C2C4, 0x4FDFF252, 0xD1BB67F1, 0xA6BC5767, 0x3FB506DD, 0x48B2364B,
+		0xD80D2BDA, 0xAF0A1B4C, 0x36034AF6, 0x41047A60, 0xDF60EFC3, 0xA867DF55, 0x316E8EEF, 0x4669BE79,
+		0xCB61B38C, 0xBC66831A, 0x256FD2A0, 0x5268E236, 0xCC0C7795, 0xBB0B4703, 0x220216B9, 0x5505262F,
+		0xC5BA3BBE, 0xB2BD0B28, 0x2BB45A92, 0x5CB36A04, 0xC2D7FFA7, 0xB5D0CF31, 0x2CD99E8B, 0x5BDEAE1D,
+		0x9B64C2B0, 0xEC63F226, 0x756AA39C, 0x026D930A, 0x9C0906A9, 0xEB0E363F, 0x72076785, 0x05005713,
+		0x95BF4A82, 0xE2B87A14, 0x7BB12BAE, 0x0CB61B38, 0x92D28E9B, 0xE5D5BE0D, 0x7CDCEFB7, 0x0BDBDF21,
+		0x86D3D2D4, 0xF1D4E242, 0x68DDB3F8, 0x1FDA836E, 0x81BE16CD, 0xF6B9265B, 0x6FB077E1, 0x18B74777,
+		0x88085AE6, 0xFF0F6A70, 0x66063BCA, 0x11010B5C, 0x8F659EFF, 0xF862AE69, 0x616BFFD3, 0x166CCF45,
+		0xA00AE278, 0xD70DD2EE, 0x4E048354, 0x3903B3C2, 0xA7672661, 0xD06016F7, 0x4969474D, 0x3E6E77DB,
+		0xAED16A4A, 0xD9D65ADC, 0x40DF0B66, 0x37D83BF0, 0xA9BCAE53, 0xDEBB9EC5, 0x47B2CF7F, 0x30B5FFE9,
+		0xBDBDF21C, 0xCABAC28A, 0x53B39330, 0x24B4A3A6, 0xBAD03605, 0xCDD70693, 0x54DE5729, 0x23D967BF,
+		0xB3667A2E, 0xC4614AB8, 0x5D681B02, 0x2A6F2B94, 0xB40BBE37, 0xC30C8EA1, 0x5A05DF1B, 0x2D02EF8D
+	};
+#else
+	static const uint16_t crc16_nibble[16] =
+	{
+		0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+		0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+	};
+
+	static const uint32_t crc32_nibble[16] =
+	{
+		0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+		0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+	};
+#endif
+
+//********************************************************************************************************
+// Private prototypes
+//********************************************************************************************************
+
+	static uint32_t flight_rec_size(uint16_t len);
+	static uint16_t flight_check(const struct flight_rec_struct* rec);
+	static uint32_t flight_rd(const char* data, uint32_t size, uint32_t pos, int bytes);
+	static void flight_wr(char* data, uint32_t size, uint32_t pos, uint32_t value, int bytes);
+	static bool flight_rd_rec(const char* data, uint32_t size, uint32_t pos, struct flight_rec_struct* rec);
+	static bool flight_find_newest(const char* data, uint32_t size, uint32_t* newest_pos, struct flight_rec_struct* newest);
+	static void flight_open(struct prnf_flight_struct* flight);
+	static void flight_commit(struct prnf_flight_struct* flight);
+
+	static void filter_crlf(struct prnf_filter_struct* filter, const char* blk, size_t len);
+	static void filter_check(struct prnf_filter_struct* filter, const char* blk, size_t len);
+	static void filter_cobs(struct prnf_filter_struct* filter, const char* blk, size_t len);
+	static uint32_t check_init(enum prnf_check_enum kind);
+	static uint32_t check_update(enum prnf_check_enum kind, uint32_t value, const char* src, size_t len);
+
+	static void tee_send(void* call, const char* blk, size_t len);
+
+	static uint32_t lz_rd32(const char* src);
+	static char* lz_wr_len(char* dst, size_t len);
+	static char* lz_wr_varint(char* dst, size_t value);
+	static void lz_compress(struct prnf_lz_struct* lz);
+	static void lz_shift(struct prnf_lz_struct* lz);
+	static void unlz_byte(struct prnf_unlz_struct* unlz, char c);
+	static bool unlz_decode(struct prnf_unlz_struct* unlz);
+
+//********************************************************************************************************
+// Public functions
+//********************************************************************************************************
+
+void prnf_flight_init(struct prnf_flight_struct* flight, void* region, size_t region_size, bool resume)
+{
+	struct flight_rec_struct newest = {0};
+	uint32_t size = (region_size - FLIGHT_REGION_HDR) & ~(uint32_t)3;
+	char* hdr = region;
+
+	PRNF_ASSERT(region_size >= FLIGHT_REGION_HDR + 2*FLIGHT_REC_HDR);
+
+	memset(flight, 0, sizeof(struct prnf_flight_struct));
+	flight->data = hdr + FLIGHT_REGION_HDR;
+	flight->size = size;
+	flight->max_len = (size/2 - FLIGHT_REC_HDR < FLIGHT_REC_MAX)? size/2 - FLIGHT_REC_HDR : FLIGHT_REC_MAX;
+
+	if(resume && flight_rd(hdr, 8, 0, 4) == FLIGHT_REGION_MAGIC && flight_rd(hdr, 8, 4, 4) == size
+	&& flight_find_newest(flight->data, size, &flight->head, &newest))
+	{
+		flight->prev_len = flight_rec_size(newest.len);
+		flight->head = (flight->head + flight->prev_len) % size;
+		flight->seq = newest.seq + 1;
+	}
+	else
+	{
+		memset(flight->data, 0, size);
+		flight_wr(hdr, 8, 0, FLIGHT_REGION_MAGIC, 4);
+		flight_wr(hdr, 8, 4, size, 4);
+		flight->head = 0;
+		flight->seq = 0;
+	};
+}
+
+void prnf_flight_putch(void* flight_vp, char c)
+{
+	struct prnf_flight_struct* flight = flight_vp;
+
+	if(!flight->open)
+		flight_open(flight);
+
+	flight->data[flight->pos] = c;
+	if(++flight->pos == flight->size)
+		flight->pos = 0;
+
+	if(++flight->len == flight->max_len || c == '\n')
+		flight_commit(flight);
+}
+
+void prnf_flight_blk(void* flight_vp, const char* blk, size_t len)
+{
+	struct prnf_flight_struct* flight = flight_vp;
+	size_t part;
+	size_t limit;
+
+	while(len)
+	{
+		if(!flight->open)
+			flight_open(flight);
+
+		// copy up to the end of the line, the record size limit, or the end of the ring
+		limit = flight->max_len - flight->len;
+		if(limit > flight->size - flight->pos)
+			limit = flight->size - flight->pos;
+		for(part = 0; part < len && part < limit && blk[part] != '\n'; part++);
+		if(part < len && part < limit)
+			part++;		// include the '\n'
+
+		memcpy(&flight->data[flight->pos], blk, part);
+		flight->pos = (flight->pos + part) % flight->size;
+		flight->len += part;
+		blk += part;
+		len -= part;
+
+		if(flight->len == flight->max_len || blk[-1] == '\n')
+			flight_commit(flight);
+	};
+}
+
+unsigned prnf_flight_recover(const void* region, size_t region_size, unsigned count, void(*blk_fptr)(void*, const char*, size_t), void* blk_vars)
+{
+	const char* hdr = region;
+	const char* data = hdr + FLIGHT_REGION_HDR;
+	uint32_t size = (region_size - FLIGHT_REGION_HDR) & ~(uint32_t)3;
+	struct flight_rec_struct rec = {0};
+	struct flight_rec_struct prev;
+	uint32_t pos = 0;
+	uint32_t prev_pos;
+	uint32_t total;
+	uint32_t text;
+	unsigned found = 0;
+	unsigned i;
+
+	if(region_size < FLIGHT_REGION_HDR + 2*FLIGHT_REC_HDR || flight_rd(hdr, 8, 0, 4) != FLIGHT_REGION_MAGIC || flight_rd(hdr, 8, 4, 4) != size)
+		return 0;
+
+	if(!count || !flight_find_newest(data, size, &pos, &rec))
+		return 0;
+
+	// walk back from the newest record, while each predecessor is intact and directly precedes it
+	found = 1;
+	total = flight_rec_size(rec.len);
+	while(found < count && rec.prev_len)
+	{
+		prev_pos = (pos + size - rec.prev_len) % size;
+		if(total + rec.prev_len > size
+		|| !flight_rd_rec(data, size, prev_pos, &prev)
+		|| prev.seq != rec.seq - 1
+		|| flight_rec_size(prev.len) != rec.prev_len)
+			break;
+		total += rec.prev_len;
+		pos = prev_pos;
+		rec = prev;
+		found++;
+	};
+
+	// output them oldest first
+	for(i=0; i<found; i++)
+	{
+		flight_rd_rec(data, size, pos, &rec);
+		text = (pos + FLIGHT_REC_HDR) % size;
+		if(text + rec.len > size)
+		{
+			blk_fptr(blk_vars, &data[text], size - text);
+			blk_fptr(blk_vars, data, rec.len - (size - text));
+		}
+		else
+			blk_fptr(blk_vars, &data[text], rec.len);
+		pos = (pos + flight_rec_size(rec.len)) % size;
+	};
+
+	return found;
+}
+
+void prnf_filter_chain(void(*blk_fptr)(void*, const char*, size_t), void* blk_vars, struct prnf_filter_struct* filter, ...)
+{
+	va_list va;
+
+	va_start(va, filter);
+	while(filter)
+	{
+		filter->next = va_arg(va, struct prnf_filter_struct*);
+		filter->blk_fptr = blk_fptr;
+		filter->blk_vars = blk_vars;
+		filter = filter->next;
+	};
+	va_end(va);
+}
+
+void prnf_filter_blk(void* filter_vp, const char* blk, size_t len)
+{
+	struct prnf_filter_struct* filter = filter_vp;
+	filter->fptr(filter, blk, len);
+}
+
+void prnf_filter_out(struct prnf_filter_struct* filter, const char* blk, size_t len)
+{
+	if(filter->next)
+		filter->next->fptr(filter->next, blk, len);
+	else
+		filter->blk_fptr(filter->blk_vars, blk, len);
+}
+
+void prnf_filter_crlf(struct prnf_filter_struct* filter)
+{
+	memset(filter, 0, sizeof(struct prnf_filter_struct));
+	filter->fptr = filter_crlf;
+}
+
+void prnf_filter_check(struct prnf_filter_struct* filter, enum prnf_check_enum kind)
+{
+	memset(filter, 0, sizeof(struct prnf_filter_struct));
+	filter->fptr = filter_check;
+	filter->state.check.kind = kind;
+	filter->state.check.value = check_init(kind);
+}
+
+void prnf_filter_cobs(struct prnf_filter_struct* filter)
+{
+	memset(filter, 0, sizeof(struct prnf_filter_struct));
+	filter->fptr = filter_cobs;
+}
+
+void prnf_tee_init(struct prnf_tee_struct* tee, struct prnf_tee_sink_struct* sinks, int max)
+{
+	tee->sinks = sinks;
+	tee->count = 0;
+	tee->max = max;
+	tee->levels = 0;
+}
+
+bool prnf_tee_add(struct prnf_tee_struct* tee, void(*blk_fptr)(void*, const char*, size_t), void* blk_vars, unsigned levels)
+{
+	struct prnf_tee_sink_struct* sink = &tee->sinks[tee->count];
+
+	if(tee->count == tee->max)
+		return false;
+
+	sink->blk_fptr = blk_fptr;
+	sink->char_fptr = NULL;
+	sink->vars = blk_vars;
+	sink->levels = levels;
+	tee->levels |= levels;
+	tee->count++;
+	return true;
+}
+
+bool prnf_tee_add_char(struct prnf_tee_struct* tee, void(*char_fptr)(void*, char), void* char_vars, unsigned levels)
+{
+	if(!prnf_tee_add(tee, NULL, char_vars, levels))
+		return false;
+
+	tee->sinks[tee->count-1].char_fptr = char_fptr;
+	return true;
+}
+
+int prnf_tee(struct prnf_tee_struct* tee, unsigned levels, const char* fmtstr, ...)
+{
+	va_list va;
+	int ret;
+
+	va_start(va, fmtstr);
+	ret = vprnf_tee(tee, levels, fmtstr, va);
+	va_end(va);
+	return ret;
+}
+
+int vprnf_tee(struct prnf_tee_struct* tee, unsigned levels, const char* fmtstr, va_list va)
+{
+	struct tee_call_struct call = {.tee = tee, .levels = levels};
+
+	if(!(tee->levels & levels))
+		return 0;
+
+	return vblkprnf(tee_send, &call, fmtstr, va);
+}
+
+void prnf_tee_blk(void* tee, const char* blk, size_t len)
+{
+	struct tee_call_struct call = {.tee = tee, .levels = PRNF_TEE_ALL};
+	tee_send(&call, blk, len);
+}
+
+size_t prnf_lz_init(struct prnf_lz_struct* lz, void* work, size_t work_size, void(*blk_fptr)(void*, const char*, size_t), void* blk_vars)
+{
+	size_t block = LZ_BLOCK_MAX;
+
+	while(block >= LZ_BLOCK_MIN && PRNF_LZ_WORK_SIZE(block) > work_size)
+		block /= 2;
+
+	memset(lz, 0, sizeof(struct prnf_lz_struct));
+	lz->blk_fptr = blk_fptr;
+	lz->blk_vars = blk_vars;
+	if(block < LZ_BLOCK_MIN)
+		return 0;
+
+	lz->block = block;
+	lz->table = work;
+	lz->hist = (char*)work + (2UL << PRNF_LZ_HASH_BITS);
+	lz->out = lz->hist + 2*block;
+	memset(lz->table, 0, 2UL << PRNF_LZ_HASH_BITS);
+
+	return block;
+}
+
+void prnf_lz_blk(void* lz_vp, const char* blk, size_t len)
+{
+	struct prnf_lz_struct* lz = lz_vp;
+	size_t part;
+
+	lz->bytes_in += len;
+	while(len && lz->block)
+	{
+		part = lz->block - lz->len;
+		if(part > len)
+			part = len;
+		memcpy(&lz->hist[lz->block + lz->len], blk, part);
+		lz->len += part;
+		blk += part;
+		len -= part;
+
+		if(lz->len == lz->block)
+		{
+			lz_compress(lz);
+			lz_shift(lz);
+		};
+	};
+}
+
+void prnf_lz_flush(struct prnf_lz_struct* lz)
+{
+	if(lz->len > lz->done)
+		lz_compress(lz);
+}
+
+void prnf_unlz_init(struct prnf_unlz_struct* unlz, void* work, size_t work_size, void(*blk_fptr)(void*, const char*, size_t), void* blk_vars)
+{
+	memset(unlz, 0, sizeof(struct prnf_unlz_struct));
+	unlz->blk_fptr = blk_fptr;
+	unlz->blk_vars = blk_vars;
+	unlz->work = work;
+	unlz->work_size = work_size;
+}
+
+void prnf_unlz_blk(void* unlz_vp, const char* blk, size_t len)
+{
+	struct prnf_unlz_struct* unlz = unlz_vp;
+	size_t part;
+
+	while(len && !unlz->error)
+	{
+		// frame data is copied in bulk, headers a byte at a time
+		if(unlz->field == 2)
+		{
+			part = unlz->comp_len - unlz->frame_len;
+			if(part > len)
+				part = len;
+			memcpy(&unlz->frame[unlz->frame_len], blk, part);
+			unlz->frame_len += part;
+			blk += part;
+			len -= part;
+			if(unlz->frame_len == unlz->comp_len)
+			{
+				unlz->error = !unlz_decode(unlz);
+				unlz->field = 0;
+			};
+		}
+		else
+		{
+			unlz_byte(unlz, *blk++);
+			len--;
+		};
+	};
+}
+
+bool prnf_unlz_error(struct prnf_unlz_struct* unlz)
+{
+	return unlz->error;
+}
+
+//********************************************************************************************************
+// Private functions
+//********************************************************************************************************
+
+// Total size of a record, with header and padding
+static uint32_t flight_rec_size(uint16_t len)
+{
+	return (FLIGHT_REC_HDR + (uint32_t)len + 3) & ~(uint32_t)3;
+}
+
+static uint16_t flight_check(const struct flight_rec_struct* rec)
+{
+	return ~(uint16_t)(rec->len ^ rec->seq ^ (rec->seq >> 16) ^ rec->prev_len ^ 0x5A5A);
+}
+
+// Read a little endian value from the ring, wrapping at the end
+static uint32_t flight_rd(const char* data, uint32_t size, uint32_t pos, int bytes)
+{
+	uint32_t value = 0;
+	int i;
+
+	for(i=0; i<bytes; i++)
+		value |= (uint32_t)(uint8_t)data[(pos + i) % size] << (i*8);
+	return value;
+}
+
+static void flight_wr(char* data, uint32_t size, uint32_t pos, uint32_t value, int bytes)
+{
+	int i;
+
+	for(i=0; i<bytes; i++)
+		data[(pos + i) % size] = (char)(value >> (i*8));
+}
+
+// Read and validate a record header
+static bool flight_rd_rec(const char* data, uint32_t size, uint32_t pos, struct flight_rec_struct* rec)
+{
+	if(flight_rd(data, size, pos, 2) != FLIGHT_REC_MAGIC)
+		return false;
+
+	rec->len = flight_rd(data, size, pos+2, 2);
+	rec->seq = flight_rd(data, size, pos+4, 4);
+	rec->prev_len = flight_rd(data, size, pos+8, 2);
+
+	return flight_rd(data, size, pos+10, 2) == flight_check(rec) && flight_rec_size(rec->len) <= size/2;
+}
+
+// Scan the ring for the valid record with the highest sequence number
+static bool flight_find_newest(const char* data, uint32_t size, uint32_t* newest_pos, struct flight_rec_struct* newest)
+{
+	struct flight_rec_struct rec;
+	bool found = false;
+	uint32_t pos;
+
+	for(pos=0; pos<size; pos+=4)
+	{
+		if(flight_rd_rec(data, size, pos, &rec) && (!found || (int32_t)(rec.seq - newest->seq) > 0))
+		{
+			*newest = rec;
+			*newest_pos = pos;
+			found = true;
+		};
+	};
+
+	return found;
+}
+
+// Start a record at head. The header there (if any) belongs to the oldest record, which is about to be overwritten.
+static void flight_open(struct prnf_flight_struct* flight)
+{
+	flight_wr(flight->data, flight->size, flight->head, 0, 2);
+	flight->open = true;
+	flight->len = 0;
+	flight->pos = (flight->head + FLIGHT_REC_HDR) % flight->size;
+}
+
+// Write the header of the open record, which makes it valid, and move on
+static void flight_commit(struct prnf_flight_struct* flight)
+{
+	struct flight_rec_struct rec = {.len = flight->len, .seq = flight->seq, .prev_len = flight->prev_len};
+	uint32_t head = flight->head;
+
+	flight_wr(flight->data, flight->size, head+2, rec.len, 2);
+	flight_wr(flight->data, flight->size, head+4, rec.seq, 4);
+	flight_wr(flight->data, flight->size, head+8, rec.prev_len, 2);
+	flight_wr(flight->data, flight->size, head+10, flight_check(&rec), 2);
+	flight_wr(flight->data, flight->size, head, FLIGHT_REC_MAGIC, 2);
+
+	flight->prev_len = flight_rec_size(rec.len);
+	flight->head = (head + flight->prev_len) % flight->size;
+	flight->seq++;
+	flight->open = false;
+}
+
+static void filter_crlf(struct prnf_filter_struct* filter, const char* blk, size_t len)
+{
+	const char* nl;
+	size_t part;
+
+	while(len)
+	{
+		nl = memchr(blk, '\n', len);
+		part = nl? (size_t)(nl - blk) : len;
+		if(part)
+		{
+			prnf_filter_out(filter, blk, part);
+			filter->state.cr = (blk[part-1] == '\r');
+		};
+		if(nl)
+		{
+			if(filter->state.cr)
+				prnf_filter_out(filter, "\n", 1);
+			else
+				prnf_filter_out(filter, "\r\n", 2);
+			filter->state.cr = false;
+			part++;
+		};
+		blk += part;
+		len -= part;
+	};
+}
+
+static void filter_check(struct prnf_filter_struct* filter, const char* blk, size_t len)
+{
+	enum prnf_check_enum kind = filter->state.check.kind;
+	char tail[11];
+	const char* nl;
+	size_t part;
+	uint32_t value;
+	int digits;
+	int i;
+
+	while(len)
+	{
+		nl = memchr(blk, '\n', len);
+		part = nl? (size_t)(nl - blk) : len;
+		if(part)
+		{
+			filter->state.check.value = check_update(kind, filter->state.check.value, blk, part);
+			prnf_filter_out(filter, blk, part);
+		};
+		if(nl)
+		{
+			value = filter->state.check.value;
+			digits = 2;
+			if(kind == PRNF_CHECK_CRC16)
+				digits = 4;
+			else if(kind == PRNF_CHECK_CRC32)
+			{
+				value ^= 0xFFFFFFFFUL;
+				digits = 8;
+			};
+			tail[0] = '*';
+			for(i=digits; i; i--, value >>= 4)
+				tail[i] = "0123456789ABCDEF"[value & 15];
+			tail[digits+1] = '\n';
+			prnf_filter_out(filter, tail, digits+2);
+			filter->state.check.value = check_init(kind);
+			part++;
+		};
+		blk += part;
+		len -= part;
+	};
+}
+
+// The code byte is placed before the data in buf, so each group is passed on in one piece
+static void filter_cobs(struct prnf_filter_struct* filter, const char* blk, size_t len)
+{
+	uint16_t* group = &filter->state.cobs.len;
+	char* buf = filter->state.cobs.buf;
+	char c;
+
+	while(len--)
+	{
+		c = *blk++;
+		if(c == '\n' || !c)
+		{
+			buf[0] = (char)(*group + 1);
+			if(c == '\n')
+				buf[++*group] = 0;		// frame delimiter
+			prnf_filter_out(filter, buf, *group + 1);
+			*group = 0;
+		}
+		else
+		{
+			buf[++*group] = c;
+			if(*group == 254)
+			{
+				buf[0] = (char)255;
+				prnf_filter_out(filter, buf, 255);
+				*group = 0;
+			};
+		};
+	};
+}
+
+static uint32_t check_init(enum prnf_check_enum kind)
+{
+	return (kind == PRNF_CHECK_XOR8)? 0 : (kind == PRNF_CHECK_CRC16)? 0xFFFF : 0xFFFFFFFFUL;
+}
+
+static uint32_t check_update(enum prnf_check_enum kind, uint32_t value, const char* src, size_t len)
+{
+	const uint8_t* ptr = (const uint8_t*)src;
+
+	if(kind == PRNF_CHECK_XOR8)
+	{
+		while(len--)
+			value ^= *ptr++;
+	}
+	else if(kind == PRNF_CHECK_CRC16)
+	{
+		while(len--)
+		{
+		#ifndef PRNF_SINK_SMALL_CRC
+			value = ((value << 8) ^ crc16_table[((value >> 8) ^ *ptr++) & 255]) & 0xFFFF;
+		#else
+			value = (value << 4) ^ crc16_nibble[((value >> 12) ^ (*ptr >> 4)) & 15];
+			value = (value << 4) ^ crc16_nibble[((value >> 12) ^ *ptr++) & 15];
+			value &= 0xFFFF;
+		#endif
+		};
+	}
+	else
+	{
+		while(len--)
+		{
+		#ifndef PRNF_SINK_SMALL_CRC
+			value = (value >> 8) ^ crc32_table[(value ^ *ptr++) & 255];
+		#else
+			value = (value >> 4) ^ crc32_nibble[(value ^ *ptr) & 15];
+			value = (value >> 4) ^ crc32_nibble[(value ^ (*ptr++ >> 4)) & 15];
+		#endif
+		};
+	};
+
+	return value;
+}
+
+static void tee_send(void* call_vp, const char* blk, size_t len)
+{
+	struct tee_call_struct* call = call_vp;
+	struct prnf_tee_sink_struct* sink = call->tee->sinks;
+	struct prnf_tee_sink_struct* end = sink + call->tee->count;
+	size_t i;
+
+	for(; sink != end; sink++)
+	{
+		if(!(sink->levels & call->levels))
+			continue;
+
+		if(sink->blk_fptr)
+			sink->blk_fptr(sink->vars, blk, len);
+		else
+			for(i=0; i<len; i++)
+				sink->char_fptr(sink->vars, blk[i]);
+	};
+}
+
+static uint32_t lz_rd32(const char* src)
+{
+	uint32_t value;
+	memcpy(&value, src, 4);
+	return value;
+}
+
+// Extra length bytes, for a length which has already had 15 subtracted
+static char* lz_wr_len(char* dst, size_t len)
+{
+	while(len >= 255)
+	{
+		*dst++ = (char)255;
+		len -= 255;
+	};
+	*dst++ = (char)len;
+	return dst;
+}
+
+static char* lz_wr_varint(char* dst, size_t value)
+{
+	while(value >= 0x80)
+	{
+		*dst++ = (char)(value | 0x80);
+		value >>= 7;
+	};
+	*dst++ = (char)value;
+	return dst;
+}
+
+// Compress the unprocessed part of the current block to a frame, and pass it on
+static void lz_compress(struct prnf_lz_struct* lz)
+{
+	const char* base = lz->hist;
+	size_t ip = lz->block + lz->done;
+	size_t end = lz->block + lz->len;
+	size_t anchor = ip;
+	size_t ref, match, lit;
+	size_t step;
+	char* op = lz->out + 16;		// room for the frame header
+	char* token;
+	char* hdr;
+	char head[16];
+	char* hp = head;
+	int log2_block = 0;
+	uint32_t h;
+
+	// greedy parse, skipping faster through data which isn't matching
+	while(ip + LZ_MIN_MATCH <= end)
+	{
+		h = LZ_HASH(lz_rd32(&base[ip]));
+		ref = lz->table[h];
+		lz->table[h] = (uint16_t)(ip+1);
+		if(!ref-- || lz_rd32(&base[ref]) != lz_rd32(&base[ip]))
+		{
+			step = 1 + ((ip - anchor) >> 5);
+			ip += step;
+			continue;
+		};
+
+		for(match = LZ_MIN_MATCH; ip + match < end && base[ref + match] == base[ip + match]; match++);
+
+		lit = ip - anchor;
+		token = op++;
+		*token = (char)(((lit < 15)? lit : 15) << 4);
+		if(lit >= 15)
+			op = lz_wr_len(op, lit - 15);
+		memcpy(op, &base[anchor], lit);
+		op += lit;
+		*op++ = (char)(ip - ref);
+		*op++ = (char)((ip - ref) >> 8);
+		*token |= (char)((match - LZ_MIN_MATCH < 15)? match - LZ_MIN_MATCH : 15);
+		if(match - LZ_MIN_MATCH >= 15)
+			op = lz_wr_len(op, match - LZ_MIN_MATCH - 15);
+
+		ip += match;
+		anchor = ip;
+		if(ip >= 2 + lz->block && ip + LZ_MIN_MATCH <= end)
+			lz->table[LZ_HASH(lz_rd32(&base[ip-2]))] = (uint16_t)(ip-2+1);
+	};
+
+	// final literals
+	lit = end - anchor;
+	token = op++;
+	*token = (char)(((lit < 15)? lit : 15) << 4);
+	if(lit >= 15)
+		op = lz_wr_len(op, lit - 15);
+	memcpy(op, &base[anchor], lit);
+	op += lit;
+
+	// the header is moved to immediately before the frame data
+	if(!lz->started)
+	{
+		while((1UL << log2_block) < lz->block)
+			log2_block++;
+		*hp++ = 'p';
+		*hp++ = 'L';
+		*hp++ = 'Z';
+		*hp++ = (char)log2_block;
+		lz->started = true;
+	};
+	hp = lz_wr_varint(hp, op - (lz->out + 16));
+	hp = lz_wr_varint(hp, lz->len - lz->done);
+	hdr = lz->out + 16 - (hp - head);
+	memcpy(hdr, head, hp - head);
+
+	lz->bytes_out += op - hdr;
+	lz->blk_fptr(lz->blk_vars, hdr, op - hdr);
+	lz->done = lz->len;
+}
+
+// Move the full current block to the previous block
+static void lz_shift(struct prnf_lz_struct* lz)
+{
+	size_t i;
+
+	memcpy(lz->hist, &lz->hist[lz->block], lz->block);
+	for(i=0; i < (1UL << PRNF_LZ_HASH_BITS); i++)
+		lz->table[i] = (lz->table[i] > lz->block)? lz->table[i] - lz->block : 0;
+	lz->len = 0;
+	lz->done = 0;
+}
+
+// Stream and frame headers
+static void unlz_byte(struct prnf_unlz_struct* unlz, char c)
+{
+	size_t* field;
+
+	if(unlz->hdr_len < 4)
+	{
+		unlz->hdr[unlz->hdr_len++] = c;
+		if(unlz->hdr_len == 4)
+		{
+			unlz->error = unlz->hdr[0] != 'p' || unlz->hdr[1] != 'L' || unlz->hdr[2] != 'Z' || (uint8_t)unlz->hdr[3] > 14;
+			unlz->block = 1UL << (unlz->error? 0 : unlz->hdr[3]);
+			unlz->error |= PRNF_UNLZ_WORK_SIZE(unlz->block) > unlz->work_size;
+			unlz->hist = unlz->work;
+			unlz->frame = unlz->work + 2*unlz->block;
+		};
+		return;
+	};
+
+	field = unlz->field? &unlz->raw_len : &unlz->comp_len;
+	if(!unlz->shift)
+		*field = 0;
+	*field |= (size_t)(c & 0x7F) << unlz->shift;
+	unlz->shift += 7;
+	if(!(c & 0x80))
+	{
+		unlz->shift = 0;
+		unlz->field++;
+		unlz->frame_len = 0;
+		if(unlz->field == 2)
+			unlz->error = unlz->comp_len > PRNF_LZ_FRAME_BOUND(unlz->block) || unlz->raw_len > unlz->block - unlz->len;
+	}
+	else if(unlz->shift > 28)
+		unlz->error = true;
+}
+
+// Decode a complete frame into the current block, and pass on the text. Returns false if it is corrupt.
+static bool unlz_decode(struct prnf_unlz_struct* unlz)
+{
+	const uint8_t* ip = (const uint8_t*)unlz->frame;
+	const uint8_t* end = ip + unlz->comp_len;
+	size_t start = unlz->block + unlz->len;
+	size_t limit = start + unlz->raw_len;
+	size_t op = start;
+	size_t lit, match, offset;
+	uint8_t token;
+
+	for(;;)
+	{
+		if(ip >= end)
+			return false;
+		token = *ip++;
+
+		lit = token >> 4;
+		if(lit == 15)
+			do
+			{
+				if(ip >= end)
+					return false;
+				lit += *ip;
+			} while(*ip++ == 255);
+		if(lit > (size_t)(end - ip) || lit > limit - op)
+			return false;
+		memcpy(&unlz->hist[op], ip, lit);
+		ip += lit;
+		op += lit;
+
+		if(ip == end)
+			break;
+
+		if(end - ip < 2)
+			return false;
+		offset = ip[0] | (size_t)ip[1] << 8;
+		ip += 2;
+		match = (token & 15) + LZ_MIN_MATCH;
+		if((token & 15) == 15)
+			do
+			{
+				if(ip >= end)
+					return false;
+				match += *ip;
+			} while(*ip++ == 255);
+		if(!offset || offset > op || match > limit - op)
+			return false;
+
+		// may overlap, so copied a byte at a time
+		for(; match; match--, op++)
+			unlz->hist[op] = unlz->hist[op - offset];
+	};
+
+	if(op != limit)
+		return false;
+
+	unlz->blk_fptr(unlz->blk_vars, &unlz->hist[start], op - start);
+	unlz->len += op - start;
+	if(unlz->len == unlz->block)
+	{
+		memcpy(unlz->hist, &unlz->hist[unlz->block], unlz->block);
+		unlz->len = 0;
+	};
+
+	return true;
+}
+
+#endif // _PRNF_SINK_IMPLEMENTED_
+#endif // PRNF_SINK_IMPLEMENTATION
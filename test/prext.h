@@ -23,8 +23,11 @@
 #ifndef _PRNF_EXT_H_
 #define _PRNF_EXT_H_
 
+	#include <stddef.h>
 	#include <stdint.h>
+	#include <time.h>
 	#include <complex.h>
+	#include "prnf.h"
 
 //********************************************************************************************************
 // Public prototypes
@@ -42,4 +45,38 @@
 //	Complex number in polar form (radians)
 	int* prext_cplex_pol(complex float c);
 
+//	Zero heap versions of the above, for %p placeholders. These write directly to the output of the print in progress.
+//	Example:
+//		prnf("Age of Fred is %p\n", PREXT_PERIOD(age_of_fred));
+	struct prext_tstamp_struct
+	{
+		const char* fmt;
+		time_t t;
+	};
+
+	#define PREXT_TSTAMP(_fmt, _t)	PRNF_EXT(prext_tstamp_out, (&(const struct prext_tstamp_struct){(_fmt), (_t)}))
+	#define PREXT_PERIOD(_seconds)	PRNF_EXT(prext_period_out, &(const uint32_t){(_seconds)})
+	#define PREXT_CPLEX_REC(_c)		PRNF_EXT(prext_cplex_rec_out, &(const complex float){(_c)})
+	#define PREXT_CPLEX_POL(_c)		PRNF_EXT(prext_cplex_pol_out, &(const complex float){(_c)})
+
+	void prext_tstamp_out(struct prnf_out_struct* out, const void* ctx);
+	void prext_period_out(struct prnf_out_struct* out, const void* ctx);
+	void prext_cplex_rec_out(struct prnf_out_struct* out, const void* ctx);
+	void prext_cplex_pol_out(struct prnf_out_struct* out, const void* ctx);
+
+//	The current local time in ISO8601 form, with frac_digits (0-9) digits of fractional seconds, ie. 2024-01-31T13:45:12.345+1000
+//	The date and time are cached per thread and rendered only when the second changes, the fraction is written directly.
+//	dst must have room for PREXT_NOW_SIZE, returns the length written (not including the terminator).
+	#define PREXT_NOW_SIZE	sizeof("YYYY-MM-DDTHH:MM:SS.nnnnnnnnn+hhmm")
+	size_t prext_now(char* dst, int frac_digits);
+
+//	As above for %p placeholders, ie. prnf("%p %s\n", PREXT_NOW(3), msg);
+	#define PREXT_NOW(_frac_digits)	PRNF_EXT(prext_now_out, &(const int){(_frac_digits)})
+	void prext_now_out(struct prnf_out_struct* out, const void* ctx);
+
+//	Register conversions for %p{ip} (uint8_t[4]), %p{mac} (uint8_t[6]) and %p{uuid} (uint8_t[16])
+//	Example:
+//		prnf("Connected to %p{ip}\n", addr);
+	void prext_register(void);
+
 #endif // _PRNF_H_
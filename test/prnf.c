@@ -24,6 +24,12 @@ See the below example.
 	#define prnf_free(arg) 		free(arg)
 
 
+/*	Optionally, %n strings may be allocated from a per-thread arena of PRNF_ARENA_SIZE bytes (see prnf_arena_alloc()),
+ *  the extensions in prext.c use it when it has room.
+ *****************************************************************************************/
+	#define PRNF_ARENA_SIZE 1024
+
+
 /*	If you have a runtime warning handler, include it here and define PRNF_WARN to be your handler.
  *  A 'true' argument is expected to generate a warning.
  *****************************************************************************************/
@@ -42,3 +48,22 @@ See the below example.
  *****************************************************************************************/
     #define PRNF_IMPLEMENTATION
     #include "prnf.h"
+
+
+/*	Sinks which need no operating system (flight recorder etc..)
+ *****************************************************************************************/
+	#define PRNF_SINK_IMPLEMENTATION
+	#include "prnf_sink.h"
+
+
+/*	Logging with registered call sites, PRNF_LOG_PREFIX adds prnf_log_prefix() (and needs time())
+ *****************************************************************************************/
+	#define PRNF_LOG_PREFIX
+	#define PRNF_LOG_IMPLEMENTATION
+	#include "prnf_log.h"
+
+
+/*	Additions for POSIX targets (threads, files etc..), requires linking with -pthread
+ *****************************************************************************************/
+	#define PRNF_POSIX_IMPLEMENTATION
+	#include "prnf_posix.h"
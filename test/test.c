@@ -8,11 +8,28 @@
 	#include <limits.h>
 	#include <stdint.h>
 	#include <math.h>
+	#include <time.h>
+	#include <pthread.h>
+	#include <unistd.h>
+	#include <fcntl.h>
+	#include <signal.h>
+	#include <errno.h>
+	#include <sys/mman.h>
+	#include <sys/wait.h>
+	#include <sys/stat.h>
+	#include <sys/socket.h>
+	#include <sys/un.h>
 
 	#include "greatest.h"
 	#include "strview.h"
 	#include "strnum.h"
 	#include "prnf.h"
+	#include "prnf_posix.h"
+	#include "prnf_sink.h"
+
+//	TRACE sites are removed from this file
+	#define PRNF_LOG_MIN_LEVEL	1
+	#include "prnf_log.h"
 	#include "prext.h"
 
 //********************************************************************************************************
@@ -86,6 +103,9 @@ do{																											\
 //	used by the default character handler to write characters
 	static char* default_prnf_out_ptr;
 
+//	end of the tokenized format strings, provided by the linker
+	extern const char __stop_prnf_fmt[];
+
 //********************************************************************************************************
 // Private prototypes
 //********************************************************************************************************
@@ -112,6 +132,7 @@ do{																											\
 	TEST test_fptr_out(void);
 	TEST test_snprnf_limit(void);
 	TEST test_snappf(void);
+	TEST test_blk_out(void);
 
 	SUITE(dynamic_width_prec);
 	TEST test_str_dyn(void);
@@ -120,6 +141,39 @@ do{																											\
 	SUITE(special);
 	TEST test_col_align(void);
 	TEST test_ext(void);
+	TEST test_ext_cb(void);
+	TEST test_conv(void);
+	TEST test_arena(void);
+	TEST test_now(void);
+	TEST test_json(void);
+	TEST test_esc(void);
+	TEST test_hex(void);
+	TEST test_base64(void);
+	TEST test_array(void);
+	TEST test_table(void);
+
+	SUITE(tokenized);
+	TEST test_tok(void);
+
+	SUITE(logging);
+	TEST test_log_sites(void);
+	TEST test_log_limits(void);
+	TEST test_log_prefix(void);
+
+	SUITE(sinks);
+	TEST test_flight(void);
+	TEST test_lz(void);
+	TEST test_filter(void);
+	TEST test_tee(void);
+
+	SUITE(posix);
+	TEST test_batch(void);
+	TEST test_async(void);
+	TEST test_uring(void);
+	TEST test_shm(void);
+	TEST test_dgram(void);
+	TEST test_mmap(void);
+	TEST test_flight_file(void);
 
 	static void gen_rand_fmt(char* dst, int width_max, int prec_max);
 	static void gen_rand_fmt_dyn(char* dst);
@@ -127,6 +181,41 @@ do{																											\
 	static double rand_dbl(double min, double max);
 
 	static void prnf_custom_putch(void* dst, char c);
+	static void prnf_custom_putblk(void* dst, const char* blk, size_t len);
+	static void prnf_custom_putblk_str(void* dst, const char* blk, size_t len);
+	static int blkprnf_tok(void(*blk_fptr)(void*, const char*, size_t), void* blk_vars, uint32_t token, uint64_t types, ...);
+	static void log_sites(int* evaluated);
+	static void log_dedup(int value, const char* str);
+	static void log_dedup_ext(const uint8_t* ip, int secs);
+	static void log_rate(int* evaluated);
+	static void log_sample(int value);
+	static void ext_aligned(struct prnf_out_struct* out, const void* ctx);
+	static int log_prefixed(int value);
+	static int batch_rec(char* dst, size_t dst_size, const char* fmtstr, size_t idx, void* vars);
+	static void* async_print_thread(void* async);
+	static void shm_producer(const char* name, int idx);
+	static void shm_crashing_producer(const char* name);
+	static void shm_crash_handler(int sig);
+	static int dgram_listen(const char* path);
+	static void* dgram_daemon(void* rx_vp);
+	static ssize_t dgram_recv(int fd, char* dst, size_t size);
+	static void* mmap_print_thread(void* mm);
+
+//	Records the blocks passed to prnf_custom_putblk()
+	struct blk_record_struct
+	{
+		int count;
+		size_t len[8];
+		char* ptr;
+	};
+
+//	Datagrams received by dgram_daemon(), until "quit"
+	struct dgram_rx_struct
+	{
+		int fd;
+		int count;
+		char msg[128][40];
+	};
 
 //********************************************************************************************************
 // Public functions
@@ -141,6 +230,10 @@ int main(int argc, const char* argv[])
 	RUN_SUITE(output_types);
 	RUN_SUITE(dynamic_width_prec);
 	RUN_SUITE(special);
+	RUN_SUITE(tokenized);
+	RUN_SUITE(logging);
+	RUN_SUITE(sinks);
+	RUN_SUITE(posix);
 	GREATEST_MAIN_END();
 
 	return 0;
@@ -185,6 +278,7 @@ SUITE(output_types)
 	RUN_TEST(test_fptr_out);
 	RUN_TEST(test_snprnf_limit);
 	RUN_TEST(test_snappf);
+	RUN_TEST(test_blk_out);
 }
 
 SUITE(dynamic_width_prec)
@@ -197,6 +291,47 @@ SUITE(special)
 {
 	RUN_TEST(test_col_align);
 	RUN_TEST(test_ext);
+	RUN_TEST(test_ext_cb);
+	RUN_TEST(test_conv);
+	RUN_TEST(test_arena);
+	RUN_TEST(test_now);
+	RUN_TEST(test_json);
+	RUN_TEST(test_esc);
+	RUN_TEST(test_hex);
+	RUN_TEST(test_base64);
+	RUN_TEST(test_array);
+	RUN_TEST(test_table);
+}
+
+SUITE(tokenized)
+{
+	RUN_TEST(test_tok);
+}
+
+SUITE(logging)
+{
+	RUN_TEST(test_log_sites);
+	RUN_TEST(test_log_limits);
+	RUN_TEST(test_log_prefix);
+}
+
+SUITE(sinks)
+{
+	RUN_TEST(test_flight);
+	RUN_TEST(test_lz);
+	RUN_TEST(test_filter);
+	RUN_TEST(test_tee);
+}
+
+SUITE(posix)
+{
+	RUN_TEST(test_batch);
+	RUN_TEST(test_async);
+	RUN_TEST(test_uring);
+	RUN_TEST(test_shm);
+	RUN_TEST(test_dgram);
+	RUN_TEST(test_mmap);
+	RUN_TEST(test_flight_file);
 }
 
 TEST test_str(void)
@@ -458,6 +593,29 @@ TEST test_snappf(void)
 	PASS();
 }
 
+TEST test_blk_out(void)
+{
+	struct blk_record_struct rec = {.ptr = buf_str};
+	int i;
+
+	memset(buf_str, 0x7F, BUF_SIZE);
+	i = blkprnf(prnf_custom_putblk, &rec, "%s %i\n%s", "one", 2, "three");
+	ASSERT_EQ(11, i);
+	ASSERT_EQ(1, rec.count);
+	ASSERT(!memcmp(buf_str, "one 2\nthree", 11));
+	ASSERT(buf_str[11] == 0x7F);	// check 0 terminator was NOT written
+
+	// output larger than PRNF_BLK_SIZE is split after the last complete line
+	memset(&rec, 0, sizeof(rec));
+	rec.ptr = buf_str;
+	i = blkprnf(prnf_custom_putblk, &rec, "%*s\n%*s\n", 100, "a", 50, "b");
+	ASSERT_EQ(152, i);
+	ASSERT_EQ(2, rec.count);
+	ASSERT_EQ(101, rec.len[0]);
+	ASSERT_EQ(51, rec.len[1]);
+	PASS();
+}
+
 TEST test_str_dyn(void)
 {
 	int count = ITERATIONS;
@@ -511,6 +669,1213 @@ TEST test_ext(void)
 	PASS();
 }
 
+TEST test_ext_cb(void)
+{
+	char* ptr = buf_str;
+	int i;
+
+	snprnf(buf_prnf, BUF_SIZE, "%p", PREXT_PERIOD(385476351));
+	ASSERT_STR_EQ("12y 81d 12h 45m 51s", buf_prnf);
+	snprnf(buf_prnf, BUF_SIZE, "%p", PREXT_PERIOD(0));
+	ASSERT_STR_EQ("0s", buf_prnf);
+
+	// width and left alignment, truncation, and a NULL descriptor
+	snprnf(buf_prnf, BUF_SIZE, "[%8p][%-8p][%p]", PREXT_PERIOD(65), PREXT_PERIOD(65), NULL);
+	ASSERT_STR_EQ("[   1m 5s][1m 5s   ][]", buf_prnf);
+	ASSERT_EQ(19, snprnf(buf_prnf, 5, "%p", PREXT_PERIOD(385476351)));
+	ASSERT_STR_EQ("12y ", buf_prnf);
+
+	// the extension continues the column of the output
+	snprnf(buf_prnf, BUF_SIZE, "x%py", PRNF_EXT(ext_aligned, &(const int){7}));
+	ASSERT_STR_EQ("x7---y", buf_prnf);
+
+	// a pointer which is not a descriptor is not dereferenced or called
+	snprnf(buf_prnf, BUF_SIZE, "[%p][%4p][%p][%p]", (void*)&(const uintptr_t[2]){(uintptr_t)ext_aligned, 2}, (void*)buf_prnf, (void*)&(char){'x'}, (void*)16);
+	ASSERT_STR_EQ("[][][][]", buf_prnf);
+
+	// tokenized as a string
+	i = fptrprnf_TOK(prnf_custom_putch, &ptr, "%p", PREXT_PERIOD(65));
+	ASSERT_EQ(7, i);
+	ASSERT(!memcmp(&buf_str[1], "\x05" "1m 5s", 6));
+	PASS();
+}
+
+TEST test_conv(void)
+{
+	static const uint8_t ip[4] = {192, 168, 1, 20};
+	static const uint8_t mac[6] = {0x00, 0x1A, 0x2B, 0x3C, 0x4D, 0x5E};
+	static const uint8_t uuid[16] = {0x12, 0x3e, 0x45, 0x67, 0xe8, 0x9b, 0x12, 0xd3, 0xa4, 0x56, 0x42, 0x66, 0x14, 0x17, 0x40, 0x00};
+	struct blk_record_struct rec = {.ptr = buf_str};
+	int idx;
+
+	prext_register();
+	snprnf(buf_prnf, BUF_SIZE, "%p{ip} %p{mac} %p{uuid}", ip, mac, uuid);
+	ASSERT_STR_EQ("192.168.1.20 00:1A:2B:3C:4D:5E 123E4567-E89B-12D3-A456-426614174000", buf_prnf);
+
+	// width, left alignment, NULL, and other sinks
+	snprnf(buf_prnf, BUF_SIZE, "[%14p{ip}][%-14p{ip}][%p{ip}]", ip, ip, NULL);
+	ASSERT_STR_EQ("[  192.168.1.20][192.168.1.20  ][]", buf_prnf);
+	ASSERT_EQ(13, blkprnf(prnf_custom_putblk, &rec, "%p{ip}\n", ip));
+	ASSERT(!memcmp("192.168.1.20\n", buf_str, 13));
+
+	// registering a name again replaces it's handler
+	idx = prnf_conv_register("ip", ext_aligned);
+	ASSERT_EQ(idx, prnf_conv_register("ip", ext_aligned));
+	snprnf(buf_prnf, BUF_SIZE, "x%p{ip}y", &(const int){7});
+	ASSERT_STR_EQ("x7---y", buf_prnf);
+	prext_register();
+	ASSERT_EQ(idx, prnf_conv_register("ip", ext_aligned));
+	prext_register();
+	PASS();
+}
+
+TEST test_arena(void)
+{
+	struct prnf_arena_stats_struct stats = prnf_arena_stats();
+	uint32_t overflows = stats.overflows;
+	uint32_t held = stats.held;
+	char* first;
+	char* other;
+	char* ptr;
+
+	ASSERT_EQ(1024, stats.size);
+
+	// prext_period() prints into it's string with snprnf() while the string of the first argument is outstanding
+	first = prnf_arena_alloc(1);
+	prnf_ext_free(first);
+	snprnf(buf_prnf, BUF_SIZE, "%n, %n", prext_period(385476351), prext_period(65));
+	ASSERT_STR_EQ("12y 81d 12h 45m 51s, 1m 5s", buf_prnf);
+	stats = prnf_arena_stats();
+	ASSERT(stats.high_water >= 2*sizeof("XXy XXXd XXh XXm XXs"));
+	ASSERT_EQ(held, stats.held);
+
+	// reset when the print finished
+	ptr = prnf_arena_alloc(1);
+	ASSERT_EQ(first, ptr);
+
+	// not reset while a string is outstanding, then reset when the last is freed
+	snprnf(buf_prnf, BUF_SIZE, "%i", 1);
+	other = prnf_arena_alloc(1);
+	ASSERT(other != first);
+	prnf_ext_free(other);
+	prnf_ext_free(ptr);
+	ptr = prnf_arena_alloc(1);
+	ASSERT_EQ(first, ptr);
+	prnf_ext_free(ptr);
+
+	// a string which is never printed or freed holds the arena, until it is reset
+	stats = prnf_arena_stats();
+	ptr = prnf_arena_alloc(1);
+	snprnf(buf_prnf, BUF_SIZE, "%i", 1);
+	snprnf(buf_prnf, BUF_SIZE, "%n", prext_period(65));
+	snprnf(buf_prnf, BUF_SIZE, "%n", prext_period(66));
+	ASSERT_EQ(stats.held+2, prnf_arena_stats().held);
+	ASSERT(prnf_arena_alloc(1) != first);
+	prnf_arena_reset();
+	ASSERT_EQ(first, prnf_arena_alloc(1));
+	prnf_arena_reset();
+
+	// full, the heap is used instead
+	ASSERT_EQ(NULL, prnf_arena_alloc(stats.size+1));
+	ASSERT_EQ(overflows+1, prnf_arena_stats().overflows);
+	PASS();
+}
+
+TEST test_now(void)
+{
+	char now[PREXT_NOW_SIZE];
+	char before[32];
+	char after[32];
+	char zone[8];
+	struct tm tm;
+	time_t t;
+	size_t len;
+	int i;
+
+	t = time(NULL);
+	strftime(before, sizeof(before), "%Y-%m-%dT%H:%M:%S", localtime_r(&t, &tm));
+	strftime(zone, sizeof(zone), "%z", &tm);
+	len = prext_now(now, 6);
+	t = time(NULL);
+	strftime(after, sizeof(after), "%Y-%m-%dT%H:%M:%S", localtime_r(&t, &tm));
+
+	ASSERT_EQ(19+1+6+strlen(zone), len);
+	ASSERT_EQ(len, strlen(now));
+	ASSERT(!memcmp(now, before, 19) || !memcmp(now, after, 19));
+	ASSERT_EQ('.', now[19]);
+	for(i=20; i<26; i++)
+		ASSERT(now[i] >= '0' && now[i] <= '9');
+	ASSERT_STR_EQ(zone, &now[26]);
+
+	// no fraction, and more than 9 digits is limited to nanoseconds
+	ASSERT_EQ(19+strlen(zone), prext_now(now, 0));
+	ASSERT_STR_EQ(zone, &now[19]);
+	ASSERT_EQ(19+1+9+strlen(zone), prext_now(now, 12));
+
+	snprnf(buf_prnf, BUF_SIZE, "[%p]", PREXT_NOW(3));
+	ASSERT_EQ(1+19+1+3+strlen(zone)+1, strlen(buf_prnf));
+	ASSERT_EQ('.', buf_prnf[20]);
+	PASS();
+}
+
+TEST test_json(void)
+{
+	struct blk_record_struct rec = {.ptr = buf_str};
+	const char* none = NULL;
+	int len;
+
+	snprnf_json(buf_prnf, BUF_SIZE, "{\"t\":%u,\"v\":%.2f,\"n\":%i,\"s\":%s}", 12u, 1.5, -3, "say \"hi\"\\\n\t\x01");
+	ASSERT_STR_EQ("{\"t\":12,\"v\":1.50,\"n\":-3,\"s\":\"say \\\"hi\\\"\\\\\\n\\t\\u0001\"}", buf_prnf);
+
+	// NULL and non-finite values are null, other types are strings
+	snprnf_json(buf_prnf, BUF_SIZE, "[%s,%f,%f,%p,%X,%c,%.1e]", none, NAN, 1E30, NULL, 0xABu, '"', 1500.0);
+	ASSERT_STR_EQ("[null,null,null,null,\"AB\",\"\\\"\",\"1.5k\"]", buf_prnf);
+
+	// width applies inside the quotes, extensions are quoted and escaped (and continue the column)
+	snprnf_json(buf_prnf, BUF_SIZE, "[%-4s,%8p]", "a", PREXT_PERIOD(65));
+	ASSERT_STR_EQ("[\"a   \",\"   1m 5s\"]", buf_prnf);
+	snprnf_json(buf_prnf, BUF_SIZE, "%p", PRNF_EXT(ext_aligned, &(const int){7}));
+	ASSERT_STR_EQ("\"7---\"", buf_prnf);
+
+	// one block per line
+	len = blkprnf_json(prnf_custom_putblk, &rec, "{\"msg\":%s}\n", "a\nb");
+	ASSERT_EQ(15, len);
+	ASSERT_EQ(1, rec.count);
+	ASSERT(!memcmp("{\"msg\":\"a\\nb\"}\n", buf_str, 15));
+	PASS();
+}
+
+TEST test_esc(void)
+{
+	char long_str[150];
+	char expected[200];
+	char* ptr = buf_str;
+	int i;
+
+	snprnf(buf_prnf, BUF_SIZE, "%s{json}", "a\"b\\c\n\x01");
+	ASSERT_STR_EQ("a\\\"b\\\\c\\n\\u0001", buf_prnf);
+	snprnf(buf_prnf, BUF_SIZE, "%s{csv},%s{csv},%s{csv}", "plain", "a,b", "say \"hi\"");
+	ASSERT_STR_EQ("plain,\"a,b\",\"say \"\"hi\"\"\"", buf_prnf);
+
+	// a padded CSV field is padded inside it's quotes, by the length of the value (not the escaped text)
+	snprnf(buf_prnf, BUF_SIZE, "%-8s{csv},%6s{csv},%-4s{csv}", "a,b", "\"q\"", "ab");
+	ASSERT_STR_EQ("\"a,b     \",\"   \"\"q\"\"\",ab  ", buf_prnf);
+	snprnf(buf_prnf, BUF_SIZE, "%s{c}", "tab\there\x7F\\");
+	ASSERT_STR_EQ("tab\\011here\\177\\\\", buf_prnf);
+	snprnf(buf_prnf, BUF_SIZE, "%s{c}", "\x01" "a\"q\"");	// octal can't run on into a following hex digit
+	ASSERT_STR_EQ("\\001a\\\"q\\\"", buf_prnf);
+
+	// other names are not part of the placeholder, width and precision apply before escaping
+	snprnf(buf_prnf, BUF_SIZE, "%s{x}[%-5s{c}][%.2s{json}]", "a", "a\tb", "\"\"\"");
+	ASSERT_STR_EQ("a{x}[a\\011b  ][\\\"\\\"]", buf_prnf);
+
+	// long runs, across the block size and truncated
+	for(i=0; i<(int)sizeof(long_str)-1; i++)
+		long_str[i] = (i%50 == 49)? '"':'a'+i%26;
+	long_str[i] = 0;
+	for(i=0, ptr=expected; long_str[i]; i++)
+	{
+		if(long_str[i] == '"')
+			*ptr++ = '\\';
+		*ptr++ = long_str[i];
+	};
+	*ptr = 0;
+	ptr = buf_str;
+	ASSERT_EQ(151, blkprnf(prnf_custom_putblk_str, &ptr, "%s{json}", long_str));
+	*ptr = 0;
+	ASSERT_STR_EQ(expected, buf_str);
+	ASSERT_EQ(151, snprnf(buf_prnf, 60, "%s{json}", long_str));
+	ASSERT_EQ(59, strlen(buf_prnf));
+	ASSERT(!memcmp(expected, buf_prnf, 59));
+	PASS();
+}
+
+TEST test_hex(void)
+{
+	static const uint8_t mac[6] = {0x00, 0x1A, 0x2B, 0x3C, 0x4D, 0x5E};
+	static const char txt[] = "Hello, world!\n\x01\xFF" "abc";
+	uint8_t bytes[40];
+	char expected[81];
+	int i;
+
+	// vector and tail conversion
+	for(i=0; i<(int)sizeof(bytes); i++)
+	{
+		bytes[i] = i*37;
+		snprintf(&expected[i*2], 3, "%02X", bytes[i]);
+	};
+	ASSERT_EQ(80, snprnf(buf_prnf, BUF_SIZE, "%p", PRNF_HEX(bytes, sizeof(bytes))));
+	ASSERT_STR_EQ(expected, buf_prnf);
+
+	snprnf(buf_prnf, BUF_SIZE, "[%p][%p][%-8p]", PRNF_HEX_SEP(mac, 6, ':'), PRNF_HEX(mac, 0), PRNF_HEX(mac, 2));
+	ASSERT_STR_EQ("[00:1A:2B:3C:4D:5E][][001A    ]", buf_prnf);
+
+	snprnf(buf_prnf, BUF_SIZE, "%p", PRNF_XXD(txt, sizeof(txt)-1));
+	ASSERT_STR_EQ(
+		"00000000: 4865 6C6C 6F2C 2077 6F72 6C64 210A 01FF  Hello, world!...\n"
+		"00000010: 6162 63                                  abc\n", buf_prnf);
+	PASS();
+}
+
+TEST test_base64(void)
+{
+	static const char* const base64[] = {"", "Zg==", "Zm8=", "Zm9v", "Zm9vYg==", "Zm9vYmE=", "Zm9vYmFy"};
+	static const char* const base32[] = {"", "MY======", "MZXQ====", "MZXW6===", "MZXW6YQ=", "MZXW6YTB", "MZXW6YTBOI======"};
+	static const uint8_t slashes[3] = {0xFB, 0xFF, 0xBF};
+	uint8_t bytes[100];
+	int i;
+
+	// RFC 4648 test vectors
+	for(i=0; i<7; i++)
+	{
+		snprnf(buf_prnf, BUF_SIZE, "%p", PRNF_BASE64("foobar", i));
+		ASSERT_STR_EQ(base64[i], buf_prnf);
+		snprnf(buf_prnf, BUF_SIZE, "%p", PRNF_BASE32("foobar", i));
+		ASSERT_STR_EQ(base32[i], buf_prnf);
+	};
+
+	snprnf(buf_prnf, BUF_SIZE, "%p %p %p", PRNF_BASE64(slashes, 3), PRNF_BASE64URL(slashes, 3), PRNF_BASE64URL("f", 1));
+	ASSERT_STR_EQ("+/+/ -_-_ Zg", buf_prnf);
+
+	// several chunks
+	for(i=0; i<(int)sizeof(bytes); i++)
+		bytes[i] = i*37;
+	ASSERT_EQ(136, snprnf(buf_prnf, BUF_SIZE, "%p", PRNF_BASE64(bytes, sizeof(bytes))));
+	ASSERT_STR_EQ("ACVKb5S53gMoTXKXvOEGK1B1mr/kCS5TeJ3C5wwxVnugxeoPNFl+o8jtEjdcgabL8BU6X4SpzvMYPWKHrNH2G0Bliq/U+R5DaI2y1/whRmuQtdr/JEluk7jdAidMcZa74AUqTw==", buf_prnf);
+	snprnf(buf_prnf, BUF_SIZE, "%p", PRNF_BASE64URL(bytes, sizeof(bytes)));
+	ASSERT_STR_EQ("ACVKb5S53gMoTXKXvOEGK1B1mr_kCS5TeJ3C5wwxVnugxeoPNFl-o8jtEjdcgabL8BU6X4SpzvMYPWKHrNH2G0Bliq_U-R5DaI2y1_whRmuQtdr_JEluk7jdAidMcZa74AUqTw", buf_prnf);
+	snprnf(buf_prnf, BUF_SIZE, "%p", PRNF_BASE32(bytes, 23));
+	ASSERT_STR_EQ("AASUU34UXHPAGKCNOKL3ZYIGFNIHLGV74QES4===", buf_prnf);
+	PASS();
+}
+
+TEST test_array(void)
+{
+	static const int16_t i16[4] = {512, -13, 0, INT16_MAX};
+	static const int32_t i32[3] = {-100000, 7, INT32_MIN};
+	static const float flt[3] = {21.5f, -0.25f, 1500.0f};
+
+	snprnf(buf_prnf, BUF_SIZE, "[%p]", PRNF_ARRAY_INT16(i16, 4, "%5i", ","));
+	ASSERT_STR_EQ("[  512,  -13,    0,32767]", buf_prnf);
+	snprnf(buf_prnf, BUF_SIZE, "[%p]", PRNF_ARRAY_INT16(i16, 4, "%-+4i", NULL));
+	ASSERT_STR_EQ("[+512-13 +0  +32767]", buf_prnf);
+	snprnf(buf_prnf, BUF_SIZE, "[%p]", PRNF_ARRAY_INT16(i16, 2, "%04hX", " "));
+	ASSERT_STR_EQ("[0200 FFF3]", buf_prnf);
+
+	snprnf(buf_prnf, BUF_SIZE, "%p", PRNF_ARRAY_INT32(i32, 3, "%i", ", "));
+	ASSERT_STR_EQ("-100000, 7, -2147483648", buf_prnf);
+	snprnf(buf_prnf, BUF_SIZE, "%p", PRNF_ARRAY_INT32(i32, 2, "%u", ", "));
+	ASSERT_STR_EQ("4294867296, 7", buf_prnf);
+
+	snprnf(buf_prnf, BUF_SIZE, "%p|%p", PRNF_ARRAY_FLOAT(flt, 3, "%6.2f", " "), PRNF_ARRAY_FLOAT(flt, 3, "%.1e", " "));
+	ASSERT_STR_EQ(" 21.50  -0.25 1500.00|21.5 -250.0m 1.5k", buf_prnf);
+
+	// empty, and the array as a whole can be aligned
+	snprnf(buf_prnf, BUF_SIZE, "[%p][%-8p]", PRNF_ARRAY_INT16(i16, 0, "%i", ","), PRNF_ARRAY_INT16(i16, 2, "%i", ","));
+	ASSERT_STR_EQ("[][512,-13 ]", buf_prnf);
+	PASS();
+}
+
+TEST test_table(void)
+{
+	struct row_struct {uint32_t id; int16_t level; float volts; const char* site; char tag[6]; int64_t big;};
+	static const struct row_struct rows[3] =
+	{
+		{1, -5, 3.3f, "north", "a", -1},
+		{20, 300, 12.25f, "say \"hi\", ok", "bb", 5000000000LL},
+		{300, 0, -0.5f, NULL, "", 0},
+	};
+	static const struct prnf_field_struct fields[] =
+	{
+		PRNF_FIELD(struct row_struct, id, PRNF_FIELD_U32, NULL),
+		PRNF_FIELD(struct row_struct, level, PRNF_FIELD_I16, "%+i"),
+		PRNF_FIELD(struct row_struct, volts, PRNF_FIELD_FLOAT, "%.2f"),
+		PRNF_FIELD(struct row_struct, site, PRNF_FIELD_STR, NULL),
+		PRNF_FIELD(struct row_struct, tag, PRNF_FIELD_TEXT, "%-3s"),
+		PRNF_FIELD(struct row_struct, big, PRNF_FIELD_I64, NULL),
+	};
+	static const struct prnf_field_struct bad_fields[] =
+	{
+		PRNF_FIELD(struct row_struct, id, PRNF_FIELD_U32, "%s"),
+		PRNF_FIELD(struct row_struct, volts, PRNF_FIELD_FLOAT, "%i"),
+		PRNF_FIELD(struct row_struct, level, PRNF_FIELD_I16, "%*i"),
+		PRNF_FIELD(struct row_struct, site, PRNF_FIELD_STR, "%u"),
+		PRNF_FIELD(struct row_struct, tag, PRNF_FIELD_TEXT, "x"),
+	};
+	static const struct row_struct comma_row = {7, 2, 1.0f, "x,y", "t", 0};
+	static const struct prnf_field_struct pad_field = PRNF_FIELD(struct row_struct, site, PRNF_FIELD_STR, "%-6s");
+	struct prnf_table_struct table = {fields, 6, PRNF_TABLE_CSV, 1};
+	char* ptr = buf_str;
+
+	ASSERT_EQ(117, blkprnf_table(prnf_custom_putblk_str, &ptr, &table, rows, sizeof(rows[0]), 3));
+	*ptr = 0;
+	ASSERT_STR_EQ(
+		"id,level,volts,site,tag,big\n"
+		"1,-5,3.30,north,a  ,-1\n"
+		"20,+300,12.25,\"say \"\"hi\"\", ok\",bb ,5000000000\n"
+		"300,+0,-0.50,,   ,0\n", buf_str);
+
+	// aligned text, columns are at least as wide as their heading
+	table = (struct prnf_table_struct){fields, 3, PRNF_TABLE_TEXT, 1};
+	ptr = buf_str;
+	blkprnf_table(prnf_custom_putblk_str, &ptr, &table, rows, sizeof(rows[0]), 2);
+	*ptr = 0;
+	ASSERT_STR_EQ(
+		"id level volts\n"
+		" 1    -5  3.30\n"
+		"20  +300 12.25\n", buf_str);
+
+	// no header, no rows
+	table.header = 0;
+	ptr = buf_str;
+	ASSERT_EQ(0, blkprnf_table(prnf_custom_putblk_str, &ptr, &table, rows, sizeof(rows[0]), 0));
+	ASSERT_EQ(buf_str, ptr);
+
+	// specs which do not suit the field type use the type's default, a padded CSV string is quoted with it's padding
+	table = (struct prnf_table_struct){bad_fields, 5, PRNF_TABLE_CSV, 0};
+	ptr = buf_str;
+	blkprnf_table(prnf_custom_putblk_str, &ptr, &table, rows, sizeof(rows[0]), 1);
+	*ptr = 0;
+	ASSERT_STR_EQ("1,3.300000,-5,north,a\n", buf_str);
+
+	table.fields = &fields[3];
+	table.field_cnt = 1;
+	ptr = buf_str;
+	blkprnf_table(prnf_custom_putblk_str, &ptr, &table, &comma_row, sizeof(comma_row), 1);
+	*ptr = 0;
+	ASSERT_STR_EQ("\"x,y\"\n", buf_str);
+	table.fields = &pad_field;
+	ptr = buf_str;
+	blkprnf_table(prnf_custom_putblk_str, &ptr, &table, &comma_row, sizeof(comma_row), 1);
+	*ptr = 0;
+	ASSERT_STR_EQ("\"x,y   \"\n", buf_str);
+	PASS();
+}
+
+TEST test_tok(void)
+{
+	const char* fmt = __start_prnf_fmt;
+	char* ptr = buf_str;
+	int i;
+	double f;
+	i = fptrprnf_TOK(prnf_custom_putch, &ptr, "%i %u %lli %s %f", -3, 300, -1LL, "ab", 1.5);
+	ASSERT_EQ(1+1+2+1+3+(int)sizeof(double), i);
+
+	// the token is the offset of the format string in the prnf_fmt section, as a single byte varint
+	while(fmt < __stop_prnf_fmt && strcmp(fmt, "%i %u %lli %s %f"))
+		fmt += strlen(fmt)+1;
+	ASSERT(fmt < __stop_prnf_fmt);
+	ASSERT(fmt - __start_prnf_fmt < 0x80);
+	ASSERT_EQ(fmt - __start_prnf_fmt, (uint8_t)buf_str[0]);
+	ASSERT(!memcmp(&buf_str[1], "\x05\xD8\x04\x01\x02" "ab", 7));
+	memcpy(&f, &buf_str[8], sizeof(f));
+	ASSERT_EQ(1.5, f);
+
+	// the block path (used by prnf_tok() with PRNF_PUTBLK) outputs the same bytes
+	ptr = buf_prnf;
+	i = blkprnf_tok(prnf_custom_putblk_str, &ptr, fmt - __start_prnf_fmt, PRNF_TOK_TYPES(-3, 300, -1LL, "ab", 1.5), -3, 300, -1LL, "ab", 1.5);
+	ASSERT_EQ(1+1+2+1+3+(int)sizeof(double), i);
+	ASSERT_EQ(i, ptr - buf_prnf);
+	ASSERT(!memcmp(buf_str, buf_prnf, i));
+
+	// %S from PRNF_ARG_SL() is a string, not a %n string to be freed
+	ptr = buf_str;
+	i = fptrprnf_TOK(prnf_custom_putch, &ptr, "%-4S|", PRNF_ARG_SL("sl"));
+	ASSERT_EQ(1+1+2, i);
+	ASSERT(!memcmp(&buf_str[1], "\x02" "sl", 3));
+	PASS();
+}
+
+TEST test_batch(void)
+{
+	#define BATCH_RECS	20000
+	char* expected = malloc(BATCH_RECS*40);
+	char* ptr = expected;
+	char* txt;
+	size_t len;
+	size_t idx;
+
+	for(idx=0; idx<BATCH_RECS; idx++)
+		ptr += sprnf(ptr, "%u,%*s,%.2f\n", (unsigned)idx, (int)(idx%13), "x", idx*0.25);
+
+	txt = prnf_batch("%u,%*s,%.2f\n", BATCH_RECS, batch_rec, NULL, 7, &len);
+	ASSERT(txt);
+	ASSERT_EQ((size_t)(ptr-expected), len);
+	ASSERT_STR_EQ(expected, txt);
+	free(txt);
+
+	txt = prnf_batch("%u,%*s,%.2f\n", 0, batch_rec, NULL, 0, &len);
+	ASSERT(txt);
+	ASSERT_EQ(0, len);
+	ASSERT_STR_EQ("", txt);
+	free(txt);
+
+	free(expected);
+	#undef BATCH_RECS
+	PASS();
+}
+
+TEST test_async(void)
+{
+	struct prnf_async_struct async;
+	struct prnf_async_stats_struct stats;
+	pthread_t threads[2];
+	int fds[2];
+	char* txt = malloc(16384);
+	ssize_t len;
+	int lines[2] = {0};
+	int thread_idx, line;
+	char* ptr;
+
+	ASSERT_EQ(0, pipe(fds));
+	ASSERT_EQ(0, prnf_async_open(&async, fds[1], 64, 32, 5));
+	pthread_create(&threads[0], NULL, async_print_thread, &async);
+	pthread_create(&threads[1], NULL, async_print_thread, &async);
+	pthread_join(threads[0], NULL);
+	pthread_join(threads[1], NULL);
+	prnf_async_flush(&async);
+	stats = prnf_async_stats(&async);
+	prnf_async_close(&async);
+	close(fds[1]);
+
+	len = read(fds[0], txt, 16383);
+	close(fds[0]);
+	ASSERT(len > 0);
+	txt[len] = 0;
+	ASSERT_EQ((uint64_t)len, stats.bytes);
+	ASSERT_EQ(0, stats.errors);
+	ASSERT(stats.peak <= 64);
+
+	// every line must be intact, and in order for each thread
+	ptr = txt;
+	while(*ptr)
+	{
+		ASSERT_EQ(2, sscanf(ptr, "thread %i line %i\n", &thread_idx, &line));
+		ASSERT_EQ(lines[thread_idx]++, line);
+		ptr = strchr(ptr, '\n') + 1;
+	};
+	ASSERT_EQ(200, lines[0]);
+	ASSERT_EQ(200, lines[1]);
+	free(txt);
+	PASS();
+}
+
+TEST test_uring(void)
+{
+	struct prnf_uring_struct uring;
+	char expected[4096];
+	char* ptr = expected;
+	char txt[4096];
+	char path[] = "/tmp/prnf_test_XXXXXX";
+	int fds[2];
+	int fd;
+	int i;
+
+	for(i=0; i<100; i++)
+		ptr += sprnf(ptr, "line %i of 100\n", i);
+
+	// regular file, writes placed by offset
+	fd = mkstemp(path);
+	ASSERT(fd >= 0);
+	unlink(path);
+	ASSERT_EQ(0, prnf_uring_open(&uring, fd, 4, 64));
+	for(i=0; i<100; i++)
+		blkprnf(prnf_uring_blk, &uring, "line %i of 100\n", i);
+	prnf_uring_close(&uring);
+	ASSERT_EQ(0, uring.errors);
+	ASSERT_EQ(ptr-expected, lseek(fd, 0, SEEK_CUR));	// as if written by write()
+	ASSERT_EQ(ptr-expected, pread(fd, txt, sizeof(txt), 0));
+	ASSERT(!memcmp(expected, txt, ptr-expected));
+	close(fd);
+
+	// pipe, writes in order
+	ASSERT_EQ(0, pipe(fds));
+	ASSERT_EQ(0, prnf_uring_open(&uring, fds[1], 4, 64));
+	for(i=0; i<100; i++)
+		blkprnf(prnf_uring_blk, &uring, "line %i of 100\n", i);
+	prnf_uring_close(&uring);
+	close(fds[1]);
+	ASSERT_EQ(ptr-expected, read(fds[0], txt, sizeof(txt)));
+	ASSERT(!memcmp(expected, txt, ptr-expected));
+	close(fds[0]);
+	PASS();
+}
+
+TEST test_shm(void)
+{
+	struct prnf_shm_struct collector;
+	struct prnf_shm_struct producer;
+	struct prnf_shm_stats_struct stats;
+	char name[64];
+	char path[] = "/tmp/prnf_test_XXXXXX";
+	char big[1000];
+	char* txt;
+	char* line;
+	int next_line[4] = {0};
+	int lines = 0;
+	int running = 4;
+	int status;
+	int fd;
+	int idx, num;
+	off_t len;
+	pid_t pid;
+
+	snprnf(name, sizeof(name), "/prnf_test_%i", (int)getpid());
+	fd = mkstemp(path);
+	ASSERT(fd >= 0);
+	unlink(path);
+	ASSERT_EQ(0, prnf_shm_create(&collector, name, 64*1024));
+
+	// 4 producer processes, collected while they run. With a small ring some lines may be dropped, but the rest must arrive whole and in order.
+	for(idx=0; idx<4; idx++)
+	{
+		pid = fork();
+		ASSERT(pid >= 0);
+		if(!pid)
+			shm_producer(name, idx);
+	};
+	while(running)
+	{
+		prnf_shm_collect(&collector, fd);
+		if(waitpid(-1, &status, WNOHANG) > 0)
+			running--;
+	};
+	prnf_shm_collect(&collector, fd);
+
+	len = lseek(fd, 0, SEEK_CUR);
+	txt = malloc(len+1);
+	ASSERT(txt);
+	ASSERT_EQ(len, pread(fd, txt, len, 0));
+	txt[len] = 0;
+	for(line = txt; *line; line = strchr(line, '\n')+1)
+	{
+		ASSERT_EQ(2, sscanf(line, "producer %i line %i\n", &idx, &num));
+		ASSERT(idx >= 0 && idx < 4 && num >= next_line[idx]);
+		next_line[idx] = num+1;
+		lines++;
+	};
+	free(txt);
+	stats = prnf_shm_stats(&collector);
+	ASSERT_EQ(4*1000, lines + (int)stats.dropped);
+	ASSERT_EQ((uint64_t)lines, stats.records);
+	ASSERT_EQ((uint64_t)len, stats.bytes);
+	ASSERT_EQ(0, stats.lost);
+
+	// a record spanning several slots
+	ASSERT_EQ(0, ftruncate(fd, 0));
+	ASSERT_EQ(0, lseek(fd, 0, SEEK_SET));
+	for(num=0; num<(int)sizeof(big); num++)
+		big[num] = 'a' + num%26;
+	ASSERT_EQ(0, prnf_shm_open(&producer, name));
+	prnf_shm_blk(&producer, big, sizeof(big));
+	ASSERT_EQ(sizeof(big), prnf_shm_collect(&collector, fd));
+	txt = malloc(sizeof(big));
+	ASSERT(txt);
+	ASSERT_EQ(sizeof(big), pread(fd, txt, sizeof(big), 0));
+	ASSERT(!memcmp(big, txt, sizeof(big)));
+	free(txt);
+
+	// a producer which crashes while writing a record, the record is skipped and output from other producers continues
+	ASSERT_EQ(0, ftruncate(fd, 0));
+	ASSERT_EQ(0, lseek(fd, 0, SEEK_SET));
+	pid = fork();
+	ASSERT(pid >= 0);
+	if(!pid)
+		shm_crashing_producer(name);
+	ASSERT_EQ(pid, waitpid(pid, &status, 0));
+	blkprnf(prnf_shm_blk, &producer, "after crash\n");
+	prnf_shm_collect(&collector, fd);
+	ASSERT_EQ(sizeof("before crash\nafter crash\n")-1, pread(fd, big, sizeof(big), 0));
+	ASSERT(!memcmp("before crash\nafter crash\n", big, sizeof("before crash\nafter crash\n")-1));
+	ASSERT_EQ(1, prnf_shm_stats(&collector).lost);
+
+	prnf_shm_close(&producer);
+	prnf_shm_close(&collector);
+	ASSERT(prnf_shm_open(&producer, name));	// removed by the collector
+	close(fd);
+	PASS();
+}
+
+TEST test_dgram(void)
+{
+	struct prnf_dgram_struct dgram;
+	struct prnf_dgram_stats_struct stats;
+	struct dgram_rx_struct rx = {0};
+	struct timeval timeout = {.tv_sec = 2};
+	pthread_t daemon;
+	char path[64];
+	char expected[40];
+	int i;
+
+	snprnf(path, sizeof(path), "/tmp/prnf_test_%i.sock", (int)getpid());
+	rx.fd = dgram_listen(path);
+	ASSERT(rx.fd >= 0);
+	ASSERT_EQ(0, pthread_create(&daemon, NULL, dgram_daemon, &rx));
+
+	// batches of 8, one message per line, lines over 32 bytes truncated, the final line without '\n' is sent by close
+	// sends wait for the daemon if it's queue (net.unix.max_dgram_qlen, default 10) fills
+	ASSERT_EQ(0, prnf_dgram_open(&dgram, path, 8, 32, 0));
+	for(i=0; i<100; i++)
+		blkprnf(prnf_dgram_blk, &dgram, "message %i\n", i);
+	blkprnf(prnf_dgram_blk, &dgram, "%s\nquit", "a line which is longer than 32 bytes");
+	stats = prnf_dgram_stats(&dgram);
+	prnf_dgram_close(&dgram);
+	pthread_join(daemon, NULL);
+
+	ASSERT_EQ(102, rx.count);
+	for(i=0; i<100; i++)
+	{
+		snprnf(expected, sizeof(expected), "message %i", i);
+		ASSERT_STR_EQ(expected, rx.msg[i]);
+	};
+	ASSERT_STR_EQ("a line which is longer than 32 b", rx.msg[100]);
+	ASSERT_STR_EQ("quit", rx.msg[101]);
+	ASSERT_EQ(96, stats.messages);
+	ASSERT(stats.batches >= 12);	// more if a batch was only partly queued
+	ASSERT_EQ(1, stats.truncated);
+	ASSERT_EQ(0, stats.dropped);
+
+	// a single line is sent once the latency bound expires
+	ASSERT_EQ(0, setsockopt(rx.fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)));
+	ASSERT_EQ(0, prnf_dgram_open(&dgram, path, 64, 32, 10));
+	blkprnf(prnf_dgram_blk, &dgram, "hello\n");
+	ASSERT_EQ(5, dgram_recv(rx.fd, expected, sizeof(expected)));
+	ASSERT(!memcmp("hello", expected, 5));
+	ASSERT_EQ(1, prnf_dgram_stats(&dgram).messages);
+	prnf_dgram_close(&dgram);
+
+	// daemon not reading, once it's queue is full messages are dropped after waiting PRNF_DGRAM_WAIT_MS once
+	ASSERT_EQ(0, prnf_dgram_open(&dgram, path, 8, 32, 0));
+	for(i=0; i<1000; i++)
+		blkprnf(prnf_dgram_blk, &dgram, "message %i\n", i);
+	stats = prnf_dgram_stats(&dgram);
+	prnf_dgram_close(&dgram);
+	ASSERT(stats.dropped > 0);
+	ASSERT_EQ(1000, stats.messages + stats.dropped);
+
+	// no daemon listening
+	close(rx.fd);
+	unlink(path);
+	ASSERT(prnf_dgram_open(&dgram, path, 8, 32, 0));
+	PASS();
+}
+
+TEST test_mmap(void)
+{
+	struct prnf_mmap_struct mm;
+	struct prnf_mmap_reader_struct reader;
+	struct prnf_mmap_stats_struct stats;
+	struct stat info;
+	pthread_t threads[2];
+	char base[64];
+	char name[80];
+	char* txt = malloc(64*1024);
+	char* line;
+	size_t len = 0;
+	size_t got;
+	int next_line[2] = {0};
+	int idx, num;
+	unsigned i;
+
+	ASSERT(txt);
+	snprnf(base, sizeof(base), "/tmp/prnf_test_%i", (int)getpid());
+
+	// two threads append through 1k segments, while the output is read back
+	ASSERT_EQ(0, prnf_mmap_open(&mm, base, 1024));
+	prnf_mmap_reader_open(&reader, base, 0);
+	pthread_create(&threads[0], NULL, mmap_print_thread, &mm);
+	pthread_create(&threads[1], NULL, mmap_print_thread, &mm);
+	while(len < 1000)
+		len += prnf_mmap_read(&reader, &txt[len], 64*1024-1 - len);
+	pthread_join(threads[0], NULL);
+	pthread_join(threads[1], NULL);
+	stats = prnf_mmap_stats(&mm);
+	prnf_mmap_close(&mm);
+	while((got = prnf_mmap_read(&reader, &txt[len], 64*1024-1 - len)))
+		len += got;
+	prnf_mmap_reader_close(&reader);
+	txt[len] = 0;
+
+	ASSERT_EQ(stats.bytes, len);
+	ASSERT_EQ(0, stats.dropped);
+	ASSERT(stats.segments > len/1024);
+	for(line = txt, num = 0; *line; line = strchr(line, '\n')+1)
+	{
+		ASSERT_EQ(2, sscanf(line, "thread %i line %i\n", &idx, &num));
+		ASSERT(idx >= 0 && idx < 2);
+		ASSERT_EQ(next_line[idx], num);
+		next_line[idx]++;
+	};
+	ASSERT_EQ(500, next_line[0]);
+	ASSERT_EQ(500, next_line[1]);
+
+	// completed segments are trimmed and read-only
+	for(i=0; i<stats.segments; i++)
+	{
+		snprnf(name, sizeof(name), "%s.%06u", base, i);
+		ASSERT_EQ(0, stat(name, &info));
+		ASSERT(info.st_size <= 1024);
+		ASSERT(!(info.st_mode & S_IWUSR));
+	};
+
+	// a new writer continues the numbering
+	ASSERT_EQ(0, prnf_mmap_open(&mm, base, 1024));
+	blkprnf(prnf_mmap_blk, &mm, "continued\n");
+	prnf_mmap_close(&mm);
+	prnf_mmap_reader_open(&reader, base, stats.segments);
+	ASSERT_EQ(10, prnf_mmap_read(&reader, txt, 64));
+	ASSERT(!memcmp("continued\n", txt, 10));
+	prnf_mmap_reader_close(&reader);
+
+	for(i=0; i<=stats.segments; i++)
+	{
+		snprnf(name, sizeof(name), "%s.%06u", base, i);
+		unlink(name);
+	};
+	free(txt);
+	PASS();
+}
+
+TEST test_log_sites(void)
+{
+	struct prnf_log_site_struct* sites;
+	struct prnf_log_site_struct* error_site = NULL;
+	size_t count;
+	size_t i;
+	int found = 0;
+	int evaluated = 0;
+	char txt[128];
+	char pattern[32];
+	char* ptr = txt;
+
+	prnf_log_sink(prnf_custom_putblk_str, &ptr);
+
+	// DEBUG is disabled by default, and it's argument not evaluated
+	log_sites(&evaluated);
+	*ptr = 0;
+	ASSERT_STR_EQ("info 1\nerror 2\n", txt);
+	ASSERT_EQ(2, evaluated);
+
+	// the TRACE site was removed at compile time
+	sites = prnf_log_sites(&count);
+	for(i=0; i<count; i++)
+	{
+		if(strcmp(sites[i].func, "log_sites"))
+			continue;
+		found++;
+		ASSERT(sites[i].level >= PRNF_LOG_DEBUG);
+		ASSERT_STR_EQ("test.c", sites[i].file);
+		if(sites[i].level == PRNF_LOG_ERROR)
+			error_site = &sites[i];
+	};
+	ASSERT_EQ(3, found);
+	ASSERT(error_site);
+	ASSERT_STR_EQ("error %i\n", error_site->fmt);
+
+	ptr = txt;
+	ASSERT_EQ((int)count, prnf_log_enable_level(PRNF_LOG_TRACE));
+	log_sites(&evaluated);
+	*ptr = 0;
+	ASSERT_STR_EQ("debug 3\ninfo 4\nerror 5\n", txt);
+
+	// by file, and by file and line
+	ASSERT_EQ((int)count, prnf_log_enable("t?st.*", false));
+	ptr = txt;
+	log_sites(&evaluated);
+	ASSERT_EQ(txt, ptr);
+	ASSERT_EQ(5, evaluated);
+
+	snprnf(pattern, sizeof(pattern), "*test.c:%u", (unsigned)error_site->line);
+	ASSERT_EQ(1, prnf_log_enable(pattern, true));
+	ASSERT_EQ(0, prnf_log_enable("test.h", true));
+	log_sites(&evaluated);
+	*ptr = 0;
+	ASSERT_STR_EQ("error 6\n", txt);
+
+	prnf_log_enable_level(PRNF_LOG_DEFAULT_LEVEL);
+	prnf_log_sink(NULL, NULL);
+	PASS();
+}
+
+TEST test_log_limits(void)
+{
+	char txt[256];
+	char str[2][8] = {"same", "same"};
+	char* ptr = txt;
+	int evaluated = 0;
+	int i;
+
+	prnf_log_sink(prnf_custom_putblk_str, &ptr);
+
+	// repeats are found by the argument values (strings by content), %n arguments of suppressed messages are freed
+	for(i=0; i<5; i++)
+		log_dedup(1, str[i&1]);
+	log_dedup(2, "other");
+	log_dedup(2, "other");
+	log_dedup(1, "same");
+	*ptr = 0;
+	ASSERT_STR_EQ("dedup 1 same 6m 25s\nlast message repeated 4 times\ndedup 2 other 6m 25s\nlast message repeated 1 times\ndedup 1 same 6m 25s\n", txt);
+
+	// %p{name} arguments are compared as rendered by their conversion, and %p by their output
+	prext_register();
+	ptr = txt;
+	log_dedup_ext((const uint8_t[4]){10, 0, 0, 1}, 65);
+	log_dedup_ext((const uint8_t[4]){10, 0, 0, 1}, 65);
+	log_dedup_ext((const uint8_t[4]){10, 0, 0, 2}, 65);
+	log_dedup_ext((const uint8_t[4]){10, 0, 0, 2}, 66);
+	*ptr = 0;
+	ASSERT_STR_EQ("dedup 10.0.0.1 1m 5s\nlast message repeated 1 times\ndedup 10.0.0.2 1m 5s\ndedup 10.0.0.2 1m 6s\n", txt);
+
+	// a burst of 3, then dropped without evaluating the arguments, until the bucket refills
+	ptr = txt;
+	for(i=0; i<10; i++)
+		log_rate(&evaluated);
+	ASSERT_EQ(3, evaluated);
+	usleep(20000);
+	log_rate(&evaluated);
+	*ptr = 0;
+	ASSERT_STR_EQ("rate 1\nrate 2\nrate 3\n7 messages dropped by rate limit\nrate 4\n", txt);
+
+	// 1 in 3
+	ptr = txt;
+	for(i=0; i<9; i++)
+		log_sample(i);
+	*ptr = 0;
+	ASSERT_STR_EQ("sample 0\nsample 3\nsample 6\n", txt);
+
+	prnf_log_sink(NULL, NULL);
+	PASS();
+}
+
+TEST test_log_prefix(void)
+{
+	struct blk_record_struct rec;
+	char txt[512];
+	char expect[128];
+	char year[8];
+	char big[301];
+	time_t now;
+	int line;
+
+	// the prefix and the body are passed to the sink in one call
+	rec = (struct blk_record_struct){.ptr = txt};
+	prnf_log_sink(prnf_custom_putblk, &rec);
+	prnf_log_prefix(NULL, "%s:%i(%s) %s: ");
+	line = log_prefixed(1);
+	log_prefixed(2);
+	*rec.ptr = 0;
+	snprnf(expect, sizeof(expect), "test.c:%i(log_prefixed) INFO: prefix 1\ntest.c:%i(log_prefixed) INFO: prefix 2\n", line, line);
+	ASSERT_STR_EQ(expect, txt);
+	ASSERT_EQ(2, rec.count);
+
+	// changing the prefix invalidates the cache, columns count from the start of the line
+	rec = (struct blk_record_struct){.ptr = txt};
+	now = time(NULL);
+	strftime(year, sizeof(year), "%Y", localtime(&now));
+	prnf_log_prefix("%Y ", "%s\v12 | ");
+	log_prefixed(3);
+	*rec.ptr = 0;
+	snprnf(expect, sizeof(expect), "%s test.c | prefix 3\n", year);
+	ASSERT_STR_EQ(expect, txt);
+
+	// a body too long to send with the prefix
+	memset(big, 'x', 300);
+	big[300] = 0;
+	rec = (struct blk_record_struct){.ptr = txt};
+	prnf_log_prefix(NULL, "> ");
+	prnf_INFO("%s", big);
+	*rec.ptr = 0;
+	ASSERT_EQ(302, strlen(txt));
+	ASSERT(!memcmp("> xxx", txt, 5));
+
+	prnf_log_prefix(NULL, NULL);
+	prnf_log_sink(NULL, NULL);
+	PASS();
+}
+
+TEST test_flight(void)
+{
+	struct prnf_flight_struct flight;
+	char region[512];
+	char copy[512];
+	char txt[1024];
+	char* ptr = txt;
+	int i;
+
+	// many laps of the ring, only the most recent records remain
+	prnf_flight_init(&flight, region, sizeof(region), false);
+	for(i=0; i<100; i++)
+		fptrprnf(prnf_flight_putch, &flight, "record %i\n", i);
+	ASSERT_EQ(3, prnf_flight_recover(region, sizeof(region), 3, prnf_custom_putblk_str, &ptr));
+	*ptr = 0;
+	ASSERT_STR_EQ("record 97\nrecord 98\nrecord 99\n", txt);
+
+	// all that remain are consecutive, and end with the newest
+	ptr = txt;
+	i = prnf_flight_recover(region, sizeof(region), 1000, prnf_custom_putblk_str, &ptr);
+	*ptr = 0;
+	ASSERT(i > 10 && i < 100);
+	ASSERT_EQ(i*10, ptr-txt);
+	ASSERT(!memcmp("record 99\n", ptr-10, 10));
+	ASSERT_EQ(100-i, atoi(txt+7));
+
+	// a crash part way through a line (simulated by copying the region), the incomplete record is ignored
+	blkprnf(prnf_flight_blk, &flight, "incomplete");
+	memcpy(copy, region, sizeof(copy));
+	ptr = txt;
+	ASSERT_EQ(2, prnf_flight_recover(copy, sizeof(copy), 2, prnf_custom_putblk_str, &ptr));
+	*ptr = 0;
+	ASSERT_STR_EQ("record 98\nrecord 99\n", txt);
+
+	// resume after the reset
+	prnf_flight_init(&flight, copy, sizeof(copy), true);
+	blkprnf(prnf_flight_blk, &flight, "after %s\n", "reset");
+	ptr = txt;
+	ASSERT_EQ(2, prnf_flight_recover(copy, sizeof(copy), 2, prnf_custom_putblk_str, &ptr));
+	*ptr = 0;
+	ASSERT_STR_EQ("record 99\nafter reset\n", txt);
+
+	// a damaged record ends the recovery
+	prnf_flight_init(&flight, copy, sizeof(copy), false);
+	for(i=0; i<10; i++)
+		fptrprnf(prnf_flight_putch, &flight, "record %i\n", i);
+	copy[8 + 3*24 + 5] ^= 0x10;		// header of record 3, 24 bytes each
+	ptr = txt;
+	ASSERT_EQ(6, prnf_flight_recover(copy, sizeof(copy), 100, prnf_custom_putblk_str, &ptr));
+
+	// lines longer than the maximum record are split
+	prnf_flight_init(&flight, region, sizeof(region), false);
+	memset(copy, 'x', 300);
+	copy[300] = 0;
+	blkprnf(prnf_flight_blk, &flight, "%s\n", copy);
+	ptr = txt;
+	ASSERT_EQ(2, prnf_flight_recover(region, sizeof(region), 100, prnf_custom_putblk_str, &ptr));
+	ASSERT_EQ(301, ptr-txt);
+	PASS();
+}
+
+TEST test_lz(void)
+{
+	static uint32_t lz_work[PRNF_LZ_WORK_SIZE(1024)/4];
+	static uint32_t unlz_work[PRNF_UNLZ_WORK_SIZE(1024)/4];
+	static char txt[30000];
+	static char packed[30000];
+	static char unpacked[30000];
+	struct prnf_lz_struct lz;
+	struct prnf_unlz_struct unlz;
+	char* txt_ptr = txt;
+	char* packed_ptr = packed;
+	char* unpacked_ptr = unpacked;
+	size_t part;
+	size_t i;
+
+	// log text, with a flush part way through a block
+	ASSERT_EQ(1024, prnf_lz_init(&lz, lz_work, sizeof(lz_work), prnf_custom_putblk_str, &packed_ptr));
+	for(i=0; i<500; i++)
+	{
+		blkprnf(prnf_custom_putblk_str, &txt_ptr, "%lu: sensor %lu reads %.2f degrees\n", (unsigned long)i, (unsigned long)i%7, i*0.37);
+		blkprnf(prnf_lz_blk, &lz, "%lu: sensor %lu reads %.2f degrees\n", (unsigned long)i, (unsigned long)i%7, i*0.37);
+		if(i == 250)
+			prnf_lz_flush(&lz);
+	};
+	prnf_lz_flush(&lz);
+	ASSERT_EQ(txt_ptr-txt, (long)lz.bytes_in);
+	ASSERT_EQ(packed_ptr-packed, (long)lz.bytes_out);
+	ASSERT(packed_ptr-packed < (txt_ptr-txt)/2);
+
+	// decompressed in odd sized pieces
+	prnf_unlz_init(&unlz, unlz_work, sizeof(unlz_work), prnf_custom_putblk_str, &unpacked_ptr);
+	for(i=0; i < (size_t)(packed_ptr-packed); i+=part)
+	{
+		part = (packed_ptr-packed) - i;
+		if(part > 7)
+			part = 7;
+		prnf_unlz_blk(&unlz, packed+i, part);
+	};
+	ASSERT(!prnf_unlz_error(&unlz));
+	ASSERT_EQ(txt_ptr-txt, unpacked_ptr-unpacked);
+	ASSERT(!memcmp(txt, unpacked, txt_ptr-txt));
+
+	// not enough memory for the block size
+	prnf_unlz_init(&unlz, unlz_work, PRNF_UNLZ_WORK_SIZE(512), prnf_custom_putblk_str, &unpacked_ptr);
+	prnf_unlz_blk(&unlz, packed, packed_ptr-packed);
+	ASSERT(prnf_unlz_error(&unlz));
+
+	// not a compressed stream
+	unpacked_ptr = unpacked;
+	prnf_unlz_init(&unlz, unlz_work, sizeof(unlz_work), prnf_custom_putblk_str, &unpacked_ptr);
+	prnf_unlz_blk(&unlz, txt, txt_ptr-txt);
+	ASSERT(prnf_unlz_error(&unlz));
+	ASSERT_EQ(unpacked, unpacked_ptr);
+
+	// incompressible data stays within the frame bound
+	srand(1);
+	for(i=0; i<sizeof(txt); i++)
+		txt[i] = (char)rand();
+	packed_ptr = packed;
+	unpacked_ptr = unpacked;
+	prnf_lz_init(&lz, lz_work, sizeof(lz_work), prnf_custom_putblk_str, &packed_ptr);
+	prnf_lz_blk(&lz, txt, 20000);
+	prnf_lz_flush(&lz);
+	ASSERT(packed_ptr-packed < 20000 + 20*PRNF_LZ_FRAME_BOUND(0));
+	prnf_unlz_init(&unlz, unlz_work, sizeof(unlz_work), prnf_custom_putblk_str, &unpacked_ptr);
+	prnf_unlz_blk(&unlz, packed, packed_ptr-packed);
+	ASSERT(!prnf_unlz_error(&unlz));
+	ASSERT_EQ(20000, unpacked_ptr-unpacked);
+	ASSERT(!memcmp(txt, unpacked, 20000));
+	PASS();
+}
+
+TEST test_filter(void)
+{
+	struct prnf_filter_struct first, second;
+	char txt[1024];
+	char* ptr;
+	char* expect;
+	int i;
+
+	// line endings, split across blocks
+	prnf_filter_crlf(&first);
+	prnf_filter_chain(prnf_custom_putblk_str, &ptr, &first, NULL);
+	ptr = txt;
+	prnf_filter_blk(&first, "one\ntwo\r", 8);
+	prnf_filter_blk(&first, "\nthree\n\n", 8);
+	ASSERT_EQ(19, ptr-txt);
+	ASSERT(!memcmp("one\r\ntwo\r\nthree\r\n\r\n", txt, 19));
+
+	// checksums (of "abc"), then line endings
+	prnf_filter_check(&first, PRNF_CHECK_XOR8);
+	prnf_filter_crlf(&second);
+	prnf_filter_chain(prnf_custom_putblk_str, &ptr, &first, &second, NULL);
+	ptr = txt;
+	blkprnf(prnf_filter_blk, &first, "%s\n%s\n", "abc", "ab");
+	*ptr = 0;
+	ASSERT_STR_EQ("abc*60\r\nab*03\r\n", txt);
+
+	prnf_filter_check(&first, PRNF_CHECK_CRC16);
+	prnf_filter_chain(prnf_custom_putblk_str, &ptr, &first, NULL);
+	ptr = txt;
+	prnf_filter_blk(&first, "a", 1);
+	prnf_filter_blk(&first, "bc\n", 3);
+	*ptr = 0;
+	ASSERT_STR_EQ("abc*514A\n", txt);
+
+	prnf_filter_check(&first, PRNF_CHECK_CRC32);
+	prnf_filter_chain(prnf_custom_putblk_str, &ptr, &first, NULL);
+	ptr = txt;
+	blkprnf(prnf_filter_blk, &first, "abc\n\n");
+	*ptr = 0;
+	ASSERT_STR_EQ("abc*352441C2\n*00000000\n", txt);
+
+	// COBS frames
+	prnf_filter_cobs(&first);
+	prnf_filter_chain(prnf_custom_putblk_str, &ptr, &first, NULL);
+	ptr = txt;
+	prnf_filter_blk(&first, "\x11\0\x22\n\n", 5);
+	ASSERT_EQ(7, ptr-txt);
+	ASSERT(!memcmp("\x02\x11\x02\x22\0\x01\0", txt, 7));
+
+	// a frame longer than a group
+	ptr = txt;
+	blkprnf(prnf_filter_blk, &first, "%300s\n", "x");
+	ASSERT_EQ(1+254+1+46+1, ptr-txt);
+	expect = txt;
+	ASSERT_EQ(255, (uint8_t)*expect);
+	expect += 255;
+	ASSERT_EQ(47, *expect++);
+	for(i=0; i<45; i++)
+		ASSERT_EQ(' ', *expect++);
+	ASSERT_EQ('x', *expect++);
+	ASSERT_EQ(0, *expect);
+	PASS();
+}
+
+TEST test_tee(void)
+{
+	struct prnf_tee_sink_struct sinks[3];
+	struct prnf_tee_struct tee;
+	struct prnf_filter_struct crlf;
+	char err_txt[64];
+	char all_txt[64];
+	char char_txt[64];
+	char* err_ptr = err_txt;
+	char* all_ptr = all_txt;
+	char* char_ptr = char_txt;
+
+	prnf_tee_init(&tee, sinks, 3);
+	ASSERT(prnf_tee_add(&tee, prnf_custom_putblk_str, &err_ptr, 1));
+	ASSERT(prnf_tee_add(&tee, prnf_custom_putblk_str, &all_ptr, PRNF_TEE_ALL));
+	ASSERT(prnf_tee_add_char(&tee, prnf_custom_putch, &char_ptr, 2));
+	ASSERT(!prnf_tee_add(&tee, prnf_custom_putblk_str, &all_ptr, PRNF_TEE_ALL));
+
+	ASSERT_EQ(6, prnf_tee(&tee, 1, "%s %i\n", "one", 1));
+	ASSERT_EQ(6, prnf_tee(&tee, 2, "%s %i\n", "two", 2));
+	ASSERT_EQ(7, prnf_tee(&tee, 4, "%s %i\n", "four", 4));
+	*err_ptr = *all_ptr = *char_ptr = 0;
+	ASSERT_STR_EQ("one 1\n", err_txt);
+	ASSERT_STR_EQ("one 1\ntwo 2\nfour 4\n", all_txt);
+	ASSERT_STR_EQ("two 2\n", char_txt);
+
+	// no sink for the level, nothing is printed
+	prnf_tee_init(&tee, sinks, 3);
+	prnf_tee_add(&tee, prnf_custom_putblk_str, &err_ptr, 1);
+	ASSERT_EQ(0, prnf_tee(&tee, 2, "%s\n", "nothing"));
+	ASSERT_EQ(err_txt+6, err_ptr);
+
+	// at the end of a filter chain
+	prnf_tee_add_char(&tee, prnf_custom_putch, &char_ptr, 2);
+	prnf_filter_crlf(&crlf);
+	prnf_filter_chain(prnf_tee_blk, &tee, &crlf, NULL);
+	err_ptr = err_txt;
+	char_ptr = char_txt;
+	blkprnf(prnf_filter_blk, &crlf, "both\n");
+	*err_ptr = *char_ptr = 0;
+	ASSERT_STR_EQ("both\r\n", err_txt);
+	ASSERT_STR_EQ("both\r\n", char_txt);
+	PASS();
+}
+
+TEST test_flight_file(void)
+{
+	struct prnf_flight_struct flight;
+	char path[64];
+	char txt[256];
+	char* ptr = txt;
+	void* region;
+	pid_t pid;
+	int status;
+	int i;
+
+	snprnf(path, sizeof(path), "/tmp/prnf_test_%i.flight", (int)getpid());
+	unlink(path);
+
+	// the process is killed part way through a line
+	pid = fork();
+	ASSERT(pid >= 0);
+	if(!pid)
+	{
+		region = prnf_flight_map(path, 4096);
+		if(!region)
+			_exit(1);
+		prnf_flight_init(&flight, region, 4096, true);
+		for(i=0; i<50; i++)
+			fptrprnf(prnf_flight_putch, &flight, "line %i\n", i);
+		fptrprnf(prnf_flight_putch, &flight, "and then");
+		raise(SIGKILL);
+	};
+	ASSERT_EQ(pid, waitpid(pid, &status, 0));
+	ASSERT(WIFSIGNALED(status));
+
+	region = prnf_flight_map(path, 4096);
+	ASSERT(region);
+	ASSERT_EQ(3, prnf_flight_recover(region, 4096, 3, prnf_custom_putblk_str, &ptr));
+	*ptr = 0;
+	ASSERT_STR_EQ("line 47\nline 48\nline 49\n", txt);
+	munmap(region, 4096);
+	unlink(path);
+	PASS();
+}
+
 static void gen_rand_fmt(char* dst, int width_max, int prec_max)
 {
 	int width = 1+(rand()%width_max);
@@ -577,3 +1942,173 @@ static void prnf_custom_putch(void* dst, char c)
 	if(dst_ptr && *dst_ptr)
 		*(*dst_ptr)++ = c;
 }
+
+static void prnf_custom_putblk(void* dst, const char* blk, size_t len)
+{
+	struct blk_record_struct* rec = dst;
+	rec->len[rec->count++ & 7] = len;
+	memcpy(rec->ptr, blk, len);
+	rec->ptr += len;
+}
+
+// Callback extension for test_ext_cb()
+static void ext_aligned(struct prnf_out_struct* out, const void* ctx)
+{
+	prnf_out(out, "%i\v5-", *(const int*)ctx);
+}
+
+// Call sites for test_log_sites()
+static void log_sites(int* evaluated)
+{
+	prnf_TRACE("trace %i\n", ++*evaluated);
+	prnf_DEBUG("debug %i\n", ++*evaluated);
+	prnf_INFO("info %i\n", ++*evaluated);
+	prnf_ERROR("error %i\n", ++*evaluated);
+}
+
+// Call sites for test_log_limits()
+static void log_dedup(int value, const char* str)
+{
+	prnf_LOG_DEDUP(PRNF_LOG_ERROR, 60000, "dedup %i %s %n\n", value, str, prext_period(385));
+}
+
+static void log_dedup_ext(const uint8_t* ip, int secs)
+{
+	prnf_LOG_DEDUP(PRNF_LOG_ERROR, 60000, "dedup %-9p{ip}%p\n", ip, PREXT_PERIOD(secs));
+}
+
+static void log_rate(int* evaluated)
+{
+	prnf_LOG_RATE(PRNF_LOG_ERROR, 1000, 3, "rate %i\n", ++*evaluated);
+}
+
+static void log_sample(int value)
+{
+	prnf_LOG_SAMPLE(PRNF_LOG_ERROR, 3, "sample %i\n", value);
+}
+
+// Call site for test_log_prefix(), returns it's line
+static int log_prefixed(int value)
+{
+	prnf_INFO("prefix %i\n", value);
+	return __LINE__-1;
+}
+
+// Append to the char* pointed to by dst
+static void prnf_custom_putblk_str(void* dst, const char* blk, size_t len)
+{
+	char** dst_ptr = dst;
+	memcpy(*dst_ptr, blk, len);
+	*dst_ptr += len;
+}
+
+// Tokenized output in blocks, for test_tok()
+static int blkprnf_tok(void(*blk_fptr)(void*, const char*, size_t), void* blk_vars, uint32_t token, uint64_t types, ...)
+{
+	va_list va;
+	int ret;
+
+	va_start(va, types);
+	ret = vblkprnf_tok(blk_fptr, blk_vars, token, types, va);
+	va_end(va);
+	return ret;
+}
+
+static int batch_rec(char* dst, size_t dst_size, const char* fmtstr, size_t idx, void* vars)
+{
+	(void)vars;
+	return snprnf(dst, dst_size, fmtstr, (unsigned)idx, (int)(idx%13), "x", idx*0.25);
+}
+
+static void* async_print_thread(void* async)
+{
+	static int next_idx = 0;
+	int idx = __atomic_fetch_add(&next_idx, 1, __ATOMIC_RELAXED) & 1;
+	int line;
+	for(line=0; line<200; line++)
+		blkprnf(prnf_async_blk, async, "thread %i line %i\n", idx, line);
+	return NULL;
+}
+
+static void shm_producer(const char* name, int idx)
+{
+	struct prnf_shm_struct shm;
+	int line;
+
+	if(prnf_shm_open(&shm, name))
+		_exit(1);
+	for(line=0; line<1000; line++)
+		blkprnf(prnf_shm_blk, &shm, "producer %i line %i\n", idx, line);
+	prnf_shm_close(&shm);
+	_exit(0);
+}
+
+// Output one line, then crash while copying a record into the ring
+static void shm_crashing_producer(const char* name)
+{
+	struct prnf_shm_struct shm;
+	char* unreadable = mmap(NULL, 4096, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if(prnf_shm_open(&shm, name) || unreadable == MAP_FAILED)
+		_exit(1);
+	blkprnf(prnf_shm_blk, &shm, "before crash\n");
+	signal(SIGSEGV, shm_crash_handler);
+	prnf_shm_blk(&shm, unreadable, 64);
+	_exit(1);
+}
+
+static void shm_crash_handler(int sig)
+{
+	(void)sig;
+	_exit(2);
+}
+
+static int dgram_listen(const char* path)
+{
+	struct sockaddr_un addr = {.sun_family = AF_UNIX};
+	int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+
+	strcpy(addr.sun_path, path);
+	unlink(path);
+	if(fd >= 0 && bind(fd, (struct sockaddr*)&addr, sizeof(addr)))
+	{
+		close(fd);
+		fd = -1;
+	};
+	return fd;
+}
+
+// Stand-in for a log daemon
+static void* dgram_daemon(void* rx_vp)
+{
+	struct dgram_rx_struct* rx = rx_vp;
+	ssize_t len;
+
+	do
+	{
+		len = dgram_recv(rx->fd, rx->msg[rx->count], sizeof(rx->msg[0])-1);
+		if(len >= 0)
+			rx->msg[rx->count][len] = 0;
+	} while(len >= 0 && strcmp(rx->msg[__atomic_fetch_add(&rx->count, 1, __ATOMIC_RELEASE)], "quit") && rx->count < 128);
+	return NULL;
+}
+
+// recv() retrying if interrupted, ie. by task work after an io_uring is torn down
+static ssize_t dgram_recv(int fd, char* dst, size_t size)
+{
+	ssize_t len;
+	do
+		len = recv(fd, dst, size, 0);
+	while(len < 0 && errno == EINTR);
+	return len;
+}
+
+static void* mmap_print_thread(void* mm)
+{
+	static int next_idx = 0;
+	int idx = __atomic_fetch_add(&next_idx, 1, __ATOMIC_RELAXED) & 1;
+	int line;
+	for(line=0; line<500; line++)
+		blkprnf(prnf_mmap_blk, mm, "thread %i line %i\n", idx, line);
+	return NULL;
+}
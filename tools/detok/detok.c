@@ -0,0 +1,504 @@
+/*
+	Tokenized prnf output decoder.
+
+	Expands the binary output of the _TOK macros (or prnf_SL with PRNF_TOKENIZE defined) back to text.
+	The format strings are read from the "prnf_fmt" section of the firmware's ELF file, a token is the offset of it's format string within that section.
+
+	Usage:
+		detok [-d] [-i16] [-L32|-L64] firmware.elf [capture.bin]	Decode capture.bin (or stdin) to stdout
+		detok -l firmware.elf										List the token database
+
+		-d		Floats were sent as 8 byte doubles (firmware built with PRNF_SUPPORT_DOUBLE)
+		-i16	The firmware's int is 16 bits (ie. AVR)
+		-L32	The firmware's long is 32 bits, the default for a 32 bit ELF file
+		-L64	The firmware's long is 64 bits, the default for a 64 bit ELF file
+
+	The text is produced by prnf, so this tool should be built with the same PRNF_ENG_PREC_DEFAULT and PRNF_FLOAT_PREC_DEFAULT as the firmware.
+*/
+
+	#include <stdint.h>
+	#include <stdbool.h>
+	#include <stddef.h>
+	#include <stdio.h>
+	#include <stdlib.h>
+	#include <string.h>
+	#include <stdarg.h>
+
+	#include "prnf.h"
+
+//********************************************************************************************************
+// Local defines
+//********************************************************************************************************
+
+	#define SECTION_NAME	"prnf_fmt"
+
+	#define SPEC_SIZE		40
+	#define PIECE_SIZE		256		// initial size of a formatted argument, grown to fit
+
+//	Growable text buffer for the re-assembled format string
+	struct text_struct
+	{
+		char* buf;
+		size_t len;
+		size_t size;
+	};
+
+//********************************************************************************************************
+// Private variables
+//********************************************************************************************************
+
+	static const char* db;		// contents of the prnf_fmt section
+	static size_t db_size;
+
+	static bool float_is_double = false;
+	static int int_bits = sizeof(int)*8;
+	static int long_bits = 0;	// 0 for the ELF file's class
+
+//********************************************************************************************************
+// Private prototypes
+//********************************************************************************************************
+
+	static bool load_db(const char* filename);
+	static uint64_t rd_le(const unsigned char* src, int size);
+	static void list_db(void);
+	static bool decode(FILE* src);
+	static bool decode_msg(FILE* src, const char* fmt, struct text_struct* out, struct text_struct* piece);
+	static bool rd_varint(FILE* src, uint64_t* dst);
+	static bool rd_zigzag(FILE* src, int64_t* dst);
+	static void text_append(struct text_struct* text, const char* src, bool escape);
+	static void text_reserve(struct text_struct* text, size_t size);
+	static void piece_prnf(struct text_struct* piece, const char* spec, ...);
+	static void out_stdout(void* nothing, char c);
+
+//********************************************************************************************************
+// Public functions
+//********************************************************************************************************
+
+int main(int argc, const char* argv[])
+{
+	bool list = false;
+	bool ok;
+	FILE* src = stdin;
+	int i = 1;
+
+	while(i < argc && argv[i][0] == '-')
+	{
+		if(!strcmp(argv[i], "-l"))
+			list = true;
+		else if(!strcmp(argv[i], "-d"))
+			float_is_double = true;
+		else if(!strcmp(argv[i], "-i16"))
+			int_bits = 16;
+		else if(!strcmp(argv[i], "-L32"))
+			long_bits = 32;
+		else if(!strcmp(argv[i], "-L64"))
+			long_bits = 64;
+		else
+			break;
+		i++;
+	};
+
+	if(i >= argc)
+	{
+		fprintf(stderr, "usage: detok [-d] [-i16] [-L32|-L64] firmware.elf [capture.bin]\n       detok -l firmware.elf\n");
+		return 1;
+	};
+
+	if(!load_db(argv[i++]))
+		return 1;
+
+	if(list)
+	{
+		list_db();
+		return 0;
+	};
+
+	if(i < argc)
+	{
+		src = fopen(argv[i], "rb");
+		if(!src)
+		{
+			fprintf(stderr, "detok: can't open %s\n", argv[i]);
+			return 1;
+		};
+	};
+
+	ok = decode(src);
+
+	if(src != stdin)
+		fclose(src);
+
+	return ok? 0:1;
+}
+
+//********************************************************************************************************
+// Private functions
+//********************************************************************************************************
+
+// Read the ELF file, and locate the prnf_fmt section. Both 32 and 64 bit little endian files are supported.
+static bool load_db(const char* filename)
+{
+	FILE* file;
+	unsigned char* elf;
+	long size;
+	bool is64;
+	uint64_t shoff, sh_offset, sh_size;
+	int shentsize, shnum, shstrndx;
+	const unsigned char* sh;
+	const unsigned char* strtab_sh;
+	uint64_t strtab_offset;
+	int i;
+
+	file = fopen(filename, "rb");
+	if(!file)
+	{
+		fprintf(stderr, "detok: can't open %s\n", filename);
+		return false;
+	};
+	fseek(file, 0, SEEK_END);
+	size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	elf = malloc(size);
+	if(!elf || fread(elf, 1, size, file) != (size_t)size)
+	{
+		fprintf(stderr, "detok: can't read %s\n", filename);
+		fclose(file);
+		return false;
+	};
+	fclose(file);
+
+	if(size < 52 || memcmp(elf, "\x7F" "ELF", 4) || elf[5] != 1)
+	{
+		fprintf(stderr, "detok: %s is not a little endian ELF file\n", filename);
+		return false;
+	};
+
+	is64 = (elf[4] == 2);
+	if(!long_bits)
+		long_bits = is64? 64:32;
+	shoff     = is64? rd_le(&elf[0x28], 8) : rd_le(&elf[0x20], 4);
+	shentsize = is64? rd_le(&elf[0x3A], 2) : rd_le(&elf[0x2E], 2);
+	shnum     = is64? rd_le(&elf[0x3C], 2) : rd_le(&elf[0x30], 2);
+	shstrndx  = is64? rd_le(&elf[0x3E], 2) : rd_le(&elf[0x32], 2);
+
+	if(shoff + (uint64_t)shentsize*shnum > (uint64_t)size || shstrndx >= shnum)
+	{
+		fprintf(stderr, "detok: %s has bad section headers\n", filename);
+		return false;
+	};
+
+	strtab_sh = &elf[shoff + shentsize*shstrndx];
+	strtab_offset = is64? rd_le(&strtab_sh[0x18], 8) : rd_le(&strtab_sh[0x10], 4);
+
+	for(i=0; i<shnum; i++)
+	{
+		sh = &elf[shoff + shentsize*i];
+		if(strtab_offset + rd_le(&sh[0], 4) < (uint64_t)size && !strcmp((const char*)&elf[strtab_offset + rd_le(&sh[0], 4)], SECTION_NAME))
+		{
+			sh_offset = is64? rd_le(&sh[0x18], 8) : rd_le(&sh[0x10], 4);
+			sh_size   = is64? rd_le(&sh[0x20], 8) : rd_le(&sh[0x14], 4);
+			if(sh_offset + sh_size > (uint64_t)size)
+				break;
+			db = (const char*)&elf[sh_offset];
+			db_size = sh_size;
+			return true;
+		};
+	};
+
+	fprintf(stderr, "detok: no " SECTION_NAME " section in %s\n", filename);
+	return false;
+}
+
+static uint64_t rd_le(const unsigned char* src, int size)
+{
+	uint64_t retval = 0;
+	while(size--)
+		retval = (retval << 8) | src[size];
+	return retval;
+}
+
+static void list_db(void)
+{
+	size_t token = 0;
+	const char* fmt;
+
+	while(token < db_size)
+	{
+		fmt = &db[token];
+		printf("%zu\t", token);
+		while(*fmt)
+		{
+			if(*fmt == '\n')
+				printf("\\n");
+			else if(*fmt == '\r')
+				printf("\\r");
+			else if(*fmt == '\v')
+				printf("\\v");
+			else if(*fmt == '\t')
+				printf("\\t");
+			else
+				putchar(*fmt);
+			fmt++;
+		};
+		printf("\n");
+		token = fmt - db + 1;
+		while(token < db_size && !db[token])	// skip alignment padding
+			token++;
+	};
+}
+
+static bool decode(FILE* src)
+{
+	struct text_struct out = {0};
+	struct text_struct piece = {0};
+	uint64_t token;
+	bool ok = true;
+
+	while(ok && rd_varint(src, &token))
+	{
+		if(token >= db_size)
+		{
+			fprintf(stderr, "detok: unknown token %llu\n", (unsigned long long)token);
+			ok = false;
+		}
+		else
+		{
+			out.len = 0;
+			ok = decode_msg(src, &db[token], &out, &piece);
+			if(ok)
+				fptrprnf(out_stdout, NULL, out.buf);
+			else
+				fprintf(stderr, "detok: truncated message for token %llu\n", (unsigned long long)token);
+		};
+	};
+
+	free(out.buf);
+	free(piece.buf);
+	return ok;
+}
+
+// Re-assemble the format string with each placeholder replaced by it's formatted argument.
+// The result is then printed by prnf, so that column alignment \v applies to the whole line.
+static bool decode_msg(FILE* src, const char* fmt, struct text_struct* out, struct text_struct* piece)
+{
+	char spec[SPEC_SIZE];
+	char* str;
+	int spec_len;
+	int64_t i64;
+	uint64_t u64;
+	int length;		// 0=int 1=long 2=long long
+	float f32;
+	double f64;
+	unsigned char bytes[8];
+	bool ok = true;
+
+	text_append(out, "", false);
+
+	while(ok && *fmt)
+	{
+		if(*fmt == '%' && fmt[1] == '%')
+		{
+			text_append(out, "%%", false);
+			fmt += 2;
+			continue;
+		}
+		else if(*fmt != '%')
+		{
+			spec[0] = *fmt++;
+			spec[1] = 0;
+			text_append(out, spec, false);
+			continue;
+		};
+
+		// copy the placeholder, substituting dynamic width and precision
+		spec_len = 0;
+		spec[spec_len++] = *fmt++;
+		while(*fmt && strchr("-+ 0#'", *fmt) && spec_len < SPEC_SIZE-24)
+			spec[spec_len++] = *fmt++;
+		while(*fmt && (('0' <= *fmt && *fmt <= '9') || *fmt == '.' || *fmt == '*') && spec_len < SPEC_SIZE-24)
+		{
+			if(*fmt == '*')
+			{
+				ok = rd_zigzag(src, &i64);
+				if(spec[spec_len-1] == '.' && i64 < 0)
+					spec_len--;		// negative precision is taken as omitted
+				else
+					spec_len += sprintf(&spec[spec_len], "%lli", (long long)i64);
+				fmt++;
+			}
+			else
+				spec[spec_len++] = *fmt++;
+		};
+
+		length = 0;
+		while(*fmt && strchr("hlztLj", *fmt) && spec_len < SPEC_SIZE-2)
+		{
+			if(*fmt == 'l' || *fmt == 'z' || *fmt == 't')
+				length++;
+			spec[spec_len++] = *fmt++;
+		};
+		spec[spec_len++] = *fmt;
+		spec[spec_len] = 0;
+
+		switch(*fmt)
+		{
+			case 'd': case 'i': case 'c':
+				ok = ok && rd_zigzag(src, &i64);
+				if(length == 0)
+					piece_prnf(piece, spec, (int)i64);
+				else if(length == 1)
+					piece_prnf(piece, spec, (long)i64);
+				else
+					piece_prnf(piece, spec, (long long)i64);
+				break;
+
+			case 'u': case 'x': case 'X': case 'o':
+				ok = ok && rd_zigzag(src, &i64);
+				u64 = i64;
+				if(length == 0 && int_bits == 16)
+					u64 &= 0xFFFF;
+				else if(length == 1 && long_bits == 32)
+					u64 &= 0xFFFFFFFF;
+				if(length == 0)
+					piece_prnf(piece, spec, (unsigned int)u64);
+				else if(length == 1)
+					piece_prnf(piece, spec, (unsigned long)u64);
+				else
+					piece_prnf(piece, spec, (unsigned long long)u64);
+				break;
+
+			case 'f': case 'F': case 'e': case 'E':
+				ok = ok && fread(bytes, 1, float_is_double? 8:4, src) == (size_t)(float_is_double? 8:4);
+				if(float_is_double)
+					memcpy(&f64, bytes, 8);
+				else
+				{
+					memcpy(&f32, bytes, 4);
+					f64 = f32;
+				};
+				piece_prnf(piece, spec, f64);
+				break;
+
+			case 's': case 'S': case 'n': case 'p':
+				spec[spec_len-1] = 's';
+
+				// escape ie. %s{json}, unknown names are printed as text by snprnf() as they are by the firmware
+				if(*fmt != 'p' && fmt[1] == '{' && strchr(fmt, '}') && strchr(fmt, '}')-fmt < SPEC_SIZE-spec_len-1)
+				{
+					while(*fmt != '}')
+						spec[spec_len++] = *++fmt;
+					spec[spec_len] = 0;
+				};
+				ok = ok && rd_varint(src, &u64);
+				str = ok? malloc(u64+1) : NULL;
+				ok = ok && str && fread(str, 1, u64, src) == u64;
+				if(ok)
+				{
+					str[u64] = 0;
+					piece_prnf(piece, spec, str);
+				};
+				free(str);
+				break;
+
+			default:
+				fprintf(stderr, "detok: unsupported placeholder %s\n", spec);
+				ok = false;
+				break;
+		};
+
+		if(*fmt)
+			fmt++;
+
+		if(ok)
+			text_append(out, piece->buf, true);
+	};
+
+	return ok;
+}
+
+static bool rd_varint(FILE* src, uint64_t* dst)
+{
+	uint64_t value = 0;
+	int shift = 0;
+	int c;
+
+	do
+	{
+		c = getc(src);
+		if(c == EOF || shift > 63)
+			return false;
+		value |= (uint64_t)(c & 0x7F) << shift;
+		shift += 7;
+	}while(c & 0x80);
+
+	*dst = value;
+	return true;
+}
+
+static bool rd_zigzag(FILE* src, int64_t* dst)
+{
+	uint64_t value;
+	bool ok = rd_varint(src, &value);
+
+	*dst = (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+	return ok;
+}
+
+// append to text, optionally escaping % so the text is printed literally
+static void text_append(struct text_struct* text, const char* src, bool escape)
+{
+	size_t needed = text->len + 2*strlen(src) + 1;
+
+	if(needed > text->size)
+		text_reserve(text, needed*2);
+
+	while(*src)
+	{
+		if(escape && *src == '%')
+			text->buf[text->len++] = '%';
+		text->buf[text->len++] = *src++;
+	};
+	text->buf[text->len] = 0;
+}
+
+// grow text to hold at least size characters
+static void text_reserve(struct text_struct* text, size_t size)
+{
+	if(size > text->size)
+	{
+		text->size = size;
+		text->buf = realloc(text->buf, text->size);
+		if(!text->buf)
+		{
+			fprintf(stderr, "detok: out of memory\n");
+			exit(1);
+		};
+	};
+}
+
+// format a single argument to piece, which is grown to fit
+static void piece_prnf(struct text_struct* piece, const char* spec, ...)
+{
+	va_list va;
+	int len;
+
+	text_reserve(piece, PIECE_SIZE);
+	va_start(va, spec);
+	len = vsnprnf(piece->buf, piece->size, spec, va);
+	va_end(va);
+
+	if((size_t)len >= piece->size)
+	{
+		text_reserve(piece, len+1);
+		va_start(va, spec);
+		vsnprnf(piece->buf, piece->size, spec, va);
+		va_end(va);
+	};
+	piece->len = len;
+}
+
+static void out_stdout(void* nothing, char c)
+{
+	(void)nothing;
+	putchar(c);
+}
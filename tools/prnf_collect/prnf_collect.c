@@ -0,0 +1,153 @@
+/*
+	Shared memory log collector.
+
+	Creates the shared memory ring used by prnf_shm_blk() (see prnf_posix.h), and drains it to a file until interrupted.
+	Records abandoned by producers which crashed part way through writing them are skipped.
+
+	Usage:
+		prnf_collect [-s size] [-p poll_ms] name [output_file]
+
+		-s size		Size of the ring in kB (default 1024)
+		-p poll_ms	Time to sleep when the ring is empty (default 10)
+
+	name is the shared memory object name (ie. /myapp_log) given to prnf_shm_open() by the producers.
+	Output is appended to output_file, or written to stdout.
+	Dropped and lost record counts are reported on stderr as they change, and on exit (SIGINT or SIGTERM).
+*/
+
+	#include <stdint.h>
+	#include <stdbool.h>
+	#include <stddef.h>
+	#include <stdio.h>
+	#include <stdlib.h>
+	#include <string.h>
+	#include <signal.h>
+	#include <unistd.h>
+	#include <fcntl.h>
+	#include <time.h>
+
+	#include "prnf_posix.h"
+
+//********************************************************************************************************
+// Local defines
+//********************************************************************************************************
+
+	#define DEFAULT_SIZE_KB		1024
+	#define DEFAULT_POLL_MS		10
+
+//********************************************************************************************************
+// Private variables
+//********************************************************************************************************
+
+	static volatile sig_atomic_t stop = false;
+
+//********************************************************************************************************
+// Private prototypes
+//********************************************************************************************************
+
+	static void on_signal(int sig);
+	static void report(struct prnf_shm_struct* shm, bool always);
+
+//********************************************************************************************************
+// Public functions
+//********************************************************************************************************
+
+int main(int argc, const char* argv[])
+{
+	struct prnf_shm_struct shm;
+	struct timespec poll = {0};
+	unsigned long size_kb = DEFAULT_SIZE_KB;
+	unsigned long poll_ms = DEFAULT_POLL_MS;
+	const char* name;
+	int fd = STDOUT_FILENO;
+	int err;
+	int i = 1;
+
+	while(i+1 < argc && argv[i][0] == '-')
+	{
+		if(!strcmp(argv[i], "-s"))
+			size_kb = strtoul(argv[i+1], NULL, 10);
+		else if(!strcmp(argv[i], "-p"))
+			poll_ms = strtoul(argv[i+1], NULL, 10);
+		else
+			break;
+		i += 2;
+	};
+
+	if(i >= argc || argv[i][0] == '-' || argc > i+2 || !size_kb)
+	{
+		fprintf(stderr, "Usage: prnf_collect [-s size] [-p poll_ms] name [output_file]\n");
+		return 1;
+	};
+
+	name = argv[i];
+	if(i+1 < argc)
+	{
+		fd = open(argv[i+1], O_WRONLY | O_CREAT | O_APPEND, 0644);
+		if(fd < 0)
+		{
+			fprintf(stderr, "prnf_collect: could not open %s\n", argv[i+1]);
+			return 1;
+		};
+	};
+
+	err = prnf_shm_create(&shm, name, size_kb*1024);
+	if(err)
+	{
+		fprintf(stderr, "prnf_collect: could not create %s (%s)\n", name, strerror(err));
+		return 1;
+	};
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	poll.tv_sec = poll_ms / 1000;
+	poll.tv_nsec = (long)(poll_ms % 1000) * 1000000L;
+
+	while(!stop)
+	{
+		if(!prnf_shm_collect(&shm, fd))
+		{
+			report(&shm, false);
+			nanosleep(&poll, NULL);
+		};
+	};
+
+	prnf_shm_collect(&shm, fd);
+	report(&shm, true);
+	prnf_shm_close(&shm);
+
+	if(fd != STDOUT_FILENO)
+		close(fd);
+
+	return 0;
+}
+
+//********************************************************************************************************
+// Private functions
+//********************************************************************************************************
+
+static void on_signal(int sig)
+{
+	(void)sig;
+	stop = true;
+}
+
+// Report dropped and lost records if they have changed, or always
+static void report(struct prnf_shm_struct* shm, bool always)
+{
+	static uint64_t dropped = 0;
+	static uint64_t lost = 0;
+	struct prnf_shm_stats_struct stats = prnf_shm_stats(shm);
+
+	if(always)
+		fprintf(stderr, "prnf_collect: %llu records (%llu bytes) collected\n", (unsigned long long)stats.records, (unsigned long long)stats.bytes);
+
+	if(always || stats.dropped != dropped || stats.lost != lost)
+		fprintf(stderr, "prnf_collect: %llu records dropped (ring full), %llu lost (producer crashed)\n", (unsigned long long)stats.dropped, (unsigned long long)stats.lost);
+
+	if(stats.errors && always)
+		fprintf(stderr, "prnf_collect: %llu write errors\n", (unsigned long long)stats.errors);
+
+	dropped = stats.dropped;
+	lost = stats.lost;
+}
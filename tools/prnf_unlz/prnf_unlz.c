@@ -0,0 +1,93 @@
+/*
+	Decompressor for logs written through prnf_lz_blk() (see prnf_sink.h).
+
+	Usage:
+		prnf_unlz [input_file]
+
+	Reads the compressed stream from input_file, or stdin, and writes the text to stdout.
+	Exits with 1 if the stream is corrupt, or truncated part way through a frame.
+*/
+
+	#include <stdint.h>
+	#include <stdbool.h>
+	#include <stddef.h>
+	#include <stdio.h>
+	#include <string.h>
+	#include <unistd.h>
+	#include <fcntl.h>
+
+	#include "prnf_sink.h"
+
+//********************************************************************************************************
+// Local defines
+//********************************************************************************************************
+
+	#define READ_SIZE	(64*1024)
+
+//********************************************************************************************************
+// Private variables
+//********************************************************************************************************
+
+//	Enough for the largest block size
+	static uint32_t work[PRNF_UNLZ_WORK_SIZE(16384)/4];
+
+	static char buf[READ_SIZE];
+
+//********************************************************************************************************
+// Private prototypes
+//********************************************************************************************************
+
+	static void write_blk(void* fd, const char* blk, size_t len);
+
+//********************************************************************************************************
+// Public functions
+//********************************************************************************************************
+
+int main(int argc, const char* argv[])
+{
+	struct prnf_unlz_struct unlz;
+	int fd = STDIN_FILENO;
+	int out = STDOUT_FILENO;
+	ssize_t len;
+
+	if(argc > 2 || (argc == 2 && argv[1][0] == '-'))
+	{
+		fprintf(stderr, "Usage: prnf_unlz [input_file]\n");
+		return 1;
+	};
+
+	if(argc == 2)
+	{
+		fd = open(argv[1], O_RDONLY);
+		if(fd < 0)
+		{
+			fprintf(stderr, "prnf_unlz: could not open %s\n", argv[1]);
+			return 1;
+		};
+	};
+
+	prnf_unlz_init(&unlz, work, sizeof(work), write_blk, &out);
+	while((len = read(fd, buf, sizeof(buf))) > 0 && !prnf_unlz_error(&unlz))
+		prnf_unlz_blk(&unlz, buf, len);
+
+	if(len < 0 || prnf_unlz_error(&unlz) || unlz.field || unlz.shift)
+	{
+		fprintf(stderr, "prnf_unlz: %s\n", (len < 0)? "read error" : (unlz.field || unlz.shift)? "truncated stream" : "corrupt stream");
+		return 1;
+	};
+
+	if(fd != STDIN_FILENO)
+		close(fd);
+
+	return 0;
+}
+
+//********************************************************************************************************
+// Private functions
+//********************************************************************************************************
+
+static void write_blk(void* fd, const char* blk, size_t len)
+{
+	if(write(*(int*)fd, blk, len) != (ssize_t)len)
+		fprintf(stderr, "prnf_unlz: write error\n");
+}